@@ -0,0 +1,708 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include "libsfs.h"
+#include "sfs_client.h"
+
+// Замеры основных операций на свежем образе при нескольких уровнях
+// заполнения таблицы inode. Результат — CSV на стандартный вывод:
+// op,fill,param,ops,ops_per_sec,p50_us,p99_us,p999_us
+// Библиотека ничего не печатает; ошибки операций считаются и выводятся в конце.
+// С -t N после них идёт стресс-замер одного образа из 1, 2, 4 ... N потоков,
+// с -C N — замер сервера (sfs_serve) с 1, 2, 4 ... N клиентами.
+
+static FILE *out;
+static sfs_t *fs = NULL;
+static unsigned long errors = 0;
+static const char *image = "bench.img";
+static int total_inodes = 20000;
+static int total_blocks = 65536;
+static int image_format = DEFAULT_FORMAT;
+static int group_commit = 0;  // 0 — одна группа на весь замер
+static int max_threads = 0;   // 0 — без стресс-замера
+static int max_clients = 0;   // 0 — без замера сервера
+static MountOptions options = {IO_STDIO, DEFAULT_CACHE_BLOCKS, DEFAULT_QUEUE_DEPTH, DEFAULT_META_CACHE_KB};
+
+static double *samples = NULL;
+static int sample_count = 0;
+static int sample_capacity = 0;
+
+static double now_us() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static void sample(double us) {
+    if (sample_count == sample_capacity) {
+        sample_capacity = sample_capacity ? sample_capacity * 2 : 1024;
+        samples = realloc(samples, sizeof(double) * sample_capacity);
+    }
+    samples[sample_count++] = us;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(double p) {
+    int i = (int)(p * (sample_count - 1) + 0.5);
+    return samples[i];
+}
+
+// Печатает строку результата по накопленным замерам и сбрасывает их.
+// Пропускная способность считается за elapsed_us; 0 — за сумму замеров.
+static void report_rate(const char *op, int fill, const char *param, double elapsed_us) {
+    if (sample_count == 0) return;
+    double total = elapsed_us;
+    if (total == 0) {
+        for (int i = 0; i < sample_count; i++) total += samples[i];
+    }
+    qsort(samples, sample_count, sizeof(double), cmp_double);
+    fprintf(out, "%s,%d,%s,%d,%.0f,%.2f,%.2f,%.2f\n", op, fill, param, sample_count,
+            total > 0 ? sample_count / (total / 1e6) : 0.0,
+            percentile(0.50), percentile(0.99), percentile(0.999));
+    fflush(out);
+    sample_count = 0;
+}
+
+static void report(const char *op, int fill, const char *param) {
+    report_rate(op, fill, param, 0);
+}
+
+// Учитывает результат операции библиотеки
+static long check(long r) {
+    if (r < 0) errors++;
+    return r;
+}
+
+static void mount_image() {
+    int err;
+    fs = sfs_mount(image, &options, &err);
+    if (!fs) {
+        fprintf(stderr, "Не удалось смонтировать '%s': %s.\n", image, sfs_strerror(err));
+        exit(1);
+    }
+    sfs_set_group_commit(fs, group_commit > 0 ? group_commit : INT_MAX);
+}
+
+static void fresh_image() {
+    remove(image);
+    sfs_mkfs_format(image, DEFAULT_BLOCK_SIZE, total_blocks, total_inodes, image_format);
+    mount_image();
+}
+
+static int free_inodes() {
+    SfsStats st;
+    sfs_get_stats(fs, &st);
+    return st.free_inodes;
+}
+
+// Заполняет таблицу inode до заданной доли файлами по 100 в директории
+static void prefill(int percent) {
+    int target = (long)total_inodes * percent / 100;
+    char path[64];
+    check(sfs_create_dir(fs, "/fill"));
+    for (int i = 0, dir = -1; total_inodes - free_inodes() < target; i++) {
+        if (i % 100 == 0) {
+            snprintf(path, sizeof(path), "/fill/d%d", ++dir);
+            check(sfs_create_dir(fs, path));
+        }
+        snprintf(path, sizeof(path), "/fill/d%d/f%d", dir, i);
+        check(sfs_create(fs, path));
+    }
+    sfs_flush(fs);
+}
+
+// Монтирование заполненного образа: в форматах 1 и 2 — чтение таблиц и
+// построение полного индекса имён, в формате 3 — только суперблок и корень.
+// В param — размер таблиц в образе и объём кэша метаданных после монтирования.
+static void bench_mount(int fill, int count) {
+    SfsStats st;
+    sfs_get_stats(fs, &st);
+    char param[64];
+    for (int i = 0; i < count; i++) {
+        sfs_umount(fs);
+        double t = now_us();
+        mount_image();
+        sample(now_us() - t);
+    }
+    sfs_get_stats(fs, &st);
+    snprintf(param, sizeof(param), "tables=%ldKiB meta=%ldKiB",
+             st.table_bytes / 1024, st.meta_cache_bytes / 1024);
+    report("mount", fill, param);
+}
+
+static void bench_create(int fill, int count) {
+    char path[64];
+    check(sfs_create_dir(fs, "/bench/c"));
+    for (int i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "/bench/c/f%d", i);
+        double t = now_us();
+        check(sfs_create(fs, path));
+        sample(now_us() - t);
+    }
+    report("create", fill, "-");
+}
+
+static void bench_resolve(int fill, int iterations) {
+    static const int depths[] = {1, 4, 8, 16};
+    char path[256] = "/bench/p";
+    check(sfs_create_dir(fs, path));
+    int depth = 0;
+    for (int d = 0; d < 4; d++) {
+        while (depth < depths[d]) {
+            strcat(path, "/dir");
+            check(sfs_create_dir(fs, path));
+            depth++;
+        }
+        char param[16];
+        snprintf(param, sizeof(param), "depth=%d", depths[d]);
+        for (int i = 0; i < iterations; i++) {
+            double t = now_us();
+            check(sfs_lookup(fs, path));
+            sample(now_us() - t);
+        }
+        report("resolve", fill, param);
+
+        // Промах в конце пути и переход с построением пути текущей директории
+        char missing[272];
+        snprintf(missing, sizeof(missing), "%s/none", path);
+        for (int i = 0; i < iterations; i++) {
+            double t = now_us();
+            int r = sfs_lookup(fs, missing);
+            sample(now_us() - t);
+            if (r != SFS_ERR_NOENT) errors++;
+        }
+        report("resolve_missing", fill, param);
+        for (int i = 0; i < iterations; i++) {
+            double t = now_us();
+            check(sfs_cd(fs, path));
+            sample(now_us() - t);
+        }
+        report("cd", fill, param);
+    }
+    check(sfs_cd(fs, "/"));
+}
+
+static void bench_rw(int fill) {
+    static const int sizes[] = {1024, 65536, 1048576};
+    static const int counts[] = {1000, 200, 20};
+    char *buf = malloc(sizes[2]);
+    memset(buf, 'x', sizes[2]);
+    check(sfs_create_dir(fs, "/bench/rw"));
+
+    for (int s = 0; s < 3; s++) {
+        char param[16];
+        char path[64];
+        int inodes[1000];
+        snprintf(param, sizeof(param), "size=%d", sizes[s]);
+        for (int i = 0; i < counts[s]; i++) {
+            snprintf(path, sizeof(path), "/bench/rw/s%d_%d", s, i);
+            inodes[i] = check(sfs_create(fs, path));
+        }
+        for (int i = 0; i < counts[s]; i++) {
+            double t = now_us();
+            check(sfs_pwrite(fs, inodes[i], buf, sizes[s], 0));
+            sample(now_us() - t);
+        }
+        report("write", fill, param);
+        sfs_flush(fs);
+        for (int i = 0; i < counts[s]; i++) {
+            double t = now_us();
+            check(sfs_pread(fs, inodes[i], buf, sizes[s], 0));
+            sample(now_us() - t);
+        }
+        report("read", fill, param);
+    }
+    free(buf);
+}
+
+// Чтение большого файла подряд и вразброс порциями по 16 КиБ после
+// перемонтирования, то есть с холодным кэшем: последовательное чтение
+// показывает упреждение, случайное — что окно на нём сворачивается
+static void bench_stream(int fill) {
+    enum { STREAM_SIZE = 8 << 20, STREAM_CHUNK = 16384 };
+    SfsStats st;
+    sfs_get_stats(fs, &st);
+    if ((long)st.free_blocks * st.block_size < 2L * STREAM_SIZE) return;
+
+    char *buf = malloc(STREAM_CHUNK);
+    memset(buf, 's', STREAM_CHUNK);
+    int inode = check(sfs_create(fs, "/bench/stream"));
+    for (long pos = 0; pos < STREAM_SIZE; pos += STREAM_CHUNK) {
+        check(sfs_pwrite(fs, inode, buf, STREAM_CHUNK, pos));
+    }
+    sfs_umount(fs);
+    mount_image();
+
+    char param[32];
+    snprintf(param, sizeof(param), "chunk=%d", STREAM_CHUNK);
+    double start = now_us();
+    for (long pos = 0; pos < STREAM_SIZE; pos += STREAM_CHUNK) {
+        double t = now_us();
+        check(sfs_pread(fs, inode, buf, STREAM_CHUNK, pos));
+        sample(now_us() - t);
+    }
+    report_rate("stream_read", fill, param, now_us() - start);
+
+    srand(1);
+    start = now_us();
+    for (int i = 0; i < STREAM_SIZE / STREAM_CHUNK; i++) {
+        long pos = (long)(rand() % (STREAM_SIZE / STREAM_CHUNK)) * STREAM_CHUNK;
+        double t = now_us();
+        check(sfs_pread(fs, inode, buf, STREAM_CHUNK, pos));
+        sample(now_us() - t);
+    }
+    report_rate("random_read", fill, param, now_us() - start);
+    check(sfs_delete(fs, "/bench/stream"));
+    free(buf);
+}
+
+// Обход без печати: стоимость ls без вывода на терминал
+static int count_entry(void *ctx, const char *name, const SfsStat *st) {
+    (void)name;
+    *(long *)ctx += st->size;
+    return 0;
+}
+
+static void bench_ls(int fill, int iterations) {
+    long total = 0;
+    for (int i = 0; i < iterations; i++) {
+        double t = now_us();
+        check(sfs_list_dir(fs, "/bench/c", count_entry, &total));
+        sample(now_us() - t);
+    }
+    report("ls", fill, "-");
+}
+
+static void bench_delete(int fill, int count) {
+    char path[64];
+    for (int i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "/bench/c/f%d", i);
+        double t = now_us();
+        check(sfs_delete(fs, path));
+        sample(now_us() - t);
+    }
+    report("delete", fill, "-");
+}
+
+// Удаление деревьев: 10 поддиректорий, в каждой по 5 вложенных директорий и 5 файлов
+static void bench_rm(int fill, int trees) {
+    char path[64];
+    check(sfs_create_dir(fs, "/bench/t"));
+    for (int t = 0; t < trees; t++) {
+        snprintf(path, sizeof(path), "/bench/t/%d", t);
+        check(sfs_create_dir(fs, path));
+        for (int d = 0; d < 10; d++) {
+            snprintf(path, sizeof(path), "/bench/t/%d/%d", t, d);
+            check(sfs_create_dir(fs, path));
+            for (int f = 0; f < 10; f++) {
+                snprintf(path, sizeof(path), "/bench/t/%d/%d/%d", t, d, f);
+                check(f % 2 ? sfs_create(fs, path) : sfs_create_dir(fs, path));
+            }
+        }
+    }
+    for (int t = 0; t < trees; t++) {
+        snprintf(path, sizeof(path), "/bench/t/%d", t);
+        double start = now_us();
+        check(sfs_delete_dir_recursive(fs, path));
+        sample(now_us() - start);
+    }
+    report("rm_tree", fill, "entries=111");
+}
+
+// Стресс-замер: у каждого потока свой файл, содержимое которого
+// однозначно задаётся смещением, поэтому любое смешение данных потоков
+// видно при проверке прочитанного и считается ошибкой.
+
+#define STRESS_FILE_SIZE (4 * 1024 * 1024)
+#define STRESS_CHUNK 16384
+#define STRESS_OPS 2000
+#define STRESS_CREATES 200
+
+enum { STRESS_READ, STRESS_WRITE, STRESS_CREATE };
+
+typedef struct {
+    int index;
+    int inode;
+    int mode;
+    int threads;
+    unsigned int seed;
+    double *samples;
+    int count;
+    unsigned long errors;
+} StressWorker;
+
+static unsigned char pattern_byte(int file, long pos) {
+    return (unsigned char)(file * 131 + pos * 7 + pos / 4093);
+}
+
+static void fill_pattern(unsigned char *buf, int file, long offset, int len) {
+    for (int i = 0; i < len; i++) buf[i] = pattern_byte(file, offset + i);
+}
+
+static int check_pattern(const unsigned char *buf, int file, long offset, int len) {
+    for (int i = 0; i < len; i++) {
+        if (buf[i] != pattern_byte(file, offset + i)) return -1;
+    }
+    return 0;
+}
+
+static void *stress_worker(void *arg) {
+    StressWorker *w = arg;
+    unsigned char buf[STRESS_CHUNK];
+    unsigned char back[STRESS_CHUNK];
+    char path[64];
+
+    for (int i = 0; i < (w->mode == STRESS_CREATE ? STRESS_CREATES : STRESS_OPS); i++) {
+        long offset = (long)(rand_r(&w->seed) % (STRESS_FILE_SIZE / STRESS_CHUNK)) * STRESS_CHUNK;
+        double t = now_us();
+        if (w->mode == STRESS_READ) {
+            if (sfs_pread(fs, w->inode, buf, STRESS_CHUNK, offset) != STRESS_CHUNK ||
+                check_pattern(buf, w->index, offset, STRESS_CHUNK) != 0) {
+                w->errors++;
+            }
+        } else if (w->mode == STRESS_WRITE) {
+            // Пишем то же содержимое, что и было: проверка не зависит от порядка
+            fill_pattern(buf, w->index, offset, STRESS_CHUNK);
+            if (sfs_pwrite(fs, w->inode, buf, STRESS_CHUNK, offset) != STRESS_CHUNK ||
+                sfs_pread(fs, w->inode, back, STRESS_CHUNK, offset) != STRESS_CHUNK ||
+                memcmp(buf, back, STRESS_CHUNK) != 0) {
+                w->errors++;
+            }
+        } else {
+            snprintf(path, sizeof(path), "/stress/c%d_%d/f%d", w->threads, w->index, i);
+            if (sfs_create(fs, path) < 0) w->errors++;
+        }
+        w->samples[w->count++] = now_us() - t;
+    }
+    return NULL;
+}
+
+static int count_only(void *ctx, const char *name, const SfsStat *st) {
+    (void)name;
+    (void)st;
+    (*(int *)ctx)++;
+    return 0;
+}
+
+static void stress_round(int mode, int threads, int *inodes) {
+    static const char *names[] = {"stress_read", "stress_write", "stress_create"};
+    StressWorker *workers = calloc(threads, sizeof(StressWorker));
+    pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+    char path[64];
+
+    for (int i = 0; i < threads; i++) {
+        workers[i].index = i;
+        workers[i].inode = inodes[i];
+        workers[i].mode = mode;
+        workers[i].threads = threads;
+        workers[i].seed = 12345 + i;
+        workers[i].samples = malloc(sizeof(double) * STRESS_OPS);
+        if (mode == STRESS_CREATE) {
+            snprintf(path, sizeof(path), "/stress/c%d_%d", threads, i);
+            check(sfs_create_dir(fs, path));
+        }
+    }
+
+    double start = now_us();
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&ids[i], NULL, stress_worker, &workers[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    double elapsed = now_us() - start;
+
+    for (int i = 0; i < threads; i++) {
+        for (int j = 0; j < workers[i].count; j++) sample(workers[i].samples[j]);
+        errors += workers[i].errors;
+        if (mode == STRESS_CREATE) {
+            // Каждый поток должен увидеть в своей директории ровно свои файлы
+            int entries = 0;
+            snprintf(path, sizeof(path), "/stress/c%d_%d", threads, i);
+            check(sfs_list_dir(fs, path, count_only, &entries));
+            if (entries != STRESS_CREATES) errors++;
+        }
+        free(workers[i].samples);
+    }
+    char param[32];
+    snprintf(param, sizeof(param), "threads=%d", threads);
+    report_rate(names[mode], 0, param, elapsed);
+    free(workers);
+    free(ids);
+}
+
+static void bench_stress(void) {
+    int *inodes = malloc(sizeof(int) * max_threads);
+    unsigned char *buf = malloc(STRESS_FILE_SIZE);
+    char path[64];
+
+    fresh_image();
+    check(sfs_create_dir(fs, "/stress"));
+    for (int i = 0; i < max_threads; i++) {
+        snprintf(path, sizeof(path), "/stress/f%d", i);
+        inodes[i] = check(sfs_create(fs, path));
+        fill_pattern(buf, i, 0, STRESS_FILE_SIZE);
+        if (check(sfs_pwrite(fs, inodes[i], buf, STRESS_FILE_SIZE, 0)) != STRESS_FILE_SIZE) {
+            fprintf(stderr, "Не хватает места для файлов стресс-замера.\n");
+            exit(1);
+        }
+    }
+    sfs_flush(fs);
+
+    for (int mode = STRESS_READ; mode <= STRESS_CREATE; mode++) {
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            stress_round(mode, threads, inodes);
+        }
+        sfs_flush(fs);
+    }
+
+    // Итоговая проверка после всех раундов записи
+    for (int i = 0; i < max_threads; i++) {
+        if (check(sfs_pread(fs, inodes[i], buf, STRESS_FILE_SIZE, 0)) != STRESS_FILE_SIZE ||
+            check_pattern(buf, i, 0, STRESS_FILE_SIZE) != 0) {
+            errors++;
+        }
+    }
+    sfs_umount(fs);
+    free(buf);
+    free(inodes);
+}
+
+// Замер сервера: каждый клиент — поток со своим соединением. Сравниваются
+// синхронные запросы, конвейер из SERVER_DEPTH запросов и создание файлов.
+
+#define SERVER_FILE_SIZE (1024 * 1024)
+#define SERVER_CHUNK 4096
+#define SERVER_DEPTH 32
+#define SERVER_SOCKET "bench.sock"
+
+enum { SERVER_READ, SERVER_READ_PIPELINED, SERVER_CREATE };
+
+static volatile sig_atomic_t server_stop = 0;
+
+static void *server_thread(void *arg) {
+    (void)arg;
+    if (sfs_serve(fs, SERVER_SOCKET, &server_stop) != SFS_OK) {
+        fprintf(stderr, "Не удалось запустить сервер на '%s'.\n", SERVER_SOCKET);
+        exit(1);
+    }
+    return NULL;
+}
+
+static void *client_worker(void *arg) {
+    StressWorker *w = arg;
+    unsigned char buf[SERVER_CHUNK];
+    char path[64];
+    int err;
+    sfsc_t *c = sfsc_connect(SERVER_SOCKET, &err);
+    if (!c) {
+        w->errors++;
+        return NULL;
+    }
+
+    if (w->mode == SERVER_READ_PIPELINED) {
+        // Отправляем SERVER_DEPTH запросов вперёд и досылаем по одному на каждый ответ
+        double sent_at[SERVER_DEPTH];
+        long offsets[SERVER_DEPTH];
+        for (int i = 0; i < STRESS_OPS + SERVER_DEPTH; i++) {
+            int slot = i % SERVER_DEPTH;
+            if (i >= SERVER_DEPTH) {
+                if (sfsc_receive(c, buf, sizeof(buf)) != SERVER_CHUNK ||
+                    check_pattern(buf, w->index, offsets[slot], SERVER_CHUNK) != 0) {
+                    w->errors++;
+                }
+                w->samples[w->count++] = now_us() - sent_at[slot];
+            }
+            if (i < STRESS_OPS) {
+                offsets[slot] = (long)(rand_r(&w->seed) % (SERVER_FILE_SIZE / SERVER_CHUNK)) * SERVER_CHUNK;
+                sent_at[slot] = now_us();
+                if (sfsc_send_pread(c, w->inode, SERVER_CHUNK, offsets[slot]) != SFS_OK) w->errors++;
+            }
+        }
+    } else {
+        int ops = w->mode == SERVER_CREATE ? STRESS_CREATES : STRESS_OPS;
+        for (int i = 0; i < ops; i++) {
+            double t = now_us();
+            if (w->mode == SERVER_READ) {
+                long offset = (long)(rand_r(&w->seed) % (SERVER_FILE_SIZE / SERVER_CHUNK)) * SERVER_CHUNK;
+                if (sfsc_pread(c, w->inode, buf, SERVER_CHUNK, offset) != SERVER_CHUNK ||
+                    check_pattern(buf, w->index, offset, SERVER_CHUNK) != 0) {
+                    w->errors++;
+                }
+            } else {
+                snprintf(path, sizeof(path), "/server/c%d_%d/f%d", w->threads, w->index, i);
+                if (sfsc_create(c, path) < 0) w->errors++;
+            }
+            w->samples[w->count++] = now_us() - t;
+        }
+    }
+    sfsc_close(c);
+    return NULL;
+}
+
+static void server_round(int mode, int clients, int *inodes) {
+    static const char *names[] = {"server_read", "server_read_pipelined", "server_create"};
+    StressWorker *workers = calloc(clients, sizeof(StressWorker));
+    pthread_t *ids = malloc(sizeof(pthread_t) * clients);
+    char path[64];
+
+    for (int i = 0; i < clients; i++) {
+        workers[i].index = i;
+        workers[i].inode = inodes[i];
+        workers[i].mode = mode;
+        workers[i].threads = clients;
+        workers[i].seed = 777 + i;
+        workers[i].samples = malloc(sizeof(double) * STRESS_OPS);
+        if (mode == SERVER_CREATE) {
+            snprintf(path, sizeof(path), "/server/c%d_%d", clients, i);
+            check(sfs_create_dir(fs, path));
+        }
+    }
+
+    double start = now_us();
+    for (int i = 0; i < clients; i++) {
+        pthread_create(&ids[i], NULL, client_worker, &workers[i]);
+    }
+    for (int i = 0; i < clients; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    double elapsed = now_us() - start;
+
+    for (int i = 0; i < clients; i++) {
+        for (int j = 0; j < workers[i].count; j++) sample(workers[i].samples[j]);
+        errors += workers[i].errors;
+        free(workers[i].samples);
+    }
+    char param[32];
+    snprintf(param, sizeof(param), "clients=%d", clients);
+    report_rate(names[mode], 0, param, elapsed);
+    free(workers);
+    free(ids);
+}
+
+static void bench_server(void) {
+    int *inodes = malloc(sizeof(int) * max_clients);
+    unsigned char *buf = malloc(SERVER_FILE_SIZE);
+    char path[64];
+
+    fresh_image();
+    sfs_set_group_commit(fs, group_commit > 0 ? group_commit : 64);
+    check(sfs_create_dir(fs, "/server"));
+    for (int i = 0; i < max_clients; i++) {
+        snprintf(path, sizeof(path), "/server/f%d", i);
+        inodes[i] = check(sfs_create(fs, path));
+        fill_pattern(buf, i, 0, SERVER_FILE_SIZE);
+        if (check(sfs_pwrite(fs, inodes[i], buf, SERVER_FILE_SIZE, 0)) != SERVER_FILE_SIZE) {
+            fprintf(stderr, "Не хватает места для файлов замера сервера.\n");
+            exit(1);
+        }
+    }
+    sfs_flush(fs);
+
+    pthread_t server;
+    server_stop = 0;
+    pthread_create(&server, NULL, server_thread, NULL);
+    for (int tries = 0; ; tries++) {
+        int err;
+        sfsc_t *c = sfsc_connect(SERVER_SOCKET, &err);
+        if (c) {
+            sfsc_close(c);
+            break;
+        }
+        if (tries == 100) {
+            fprintf(stderr, "Сервер на '%s' не отвечает.\n", SERVER_SOCKET);
+            exit(1);
+        }
+        usleep(10000);
+    }
+
+    for (int mode = SERVER_READ; mode <= SERVER_CREATE; mode++) {
+        for (int clients = 1; clients <= max_clients; clients *= 2) {
+            server_round(mode, clients, inodes);
+        }
+    }
+
+    __atomic_store_n(&server_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(server, NULL);
+    sfs_umount(fs);
+    free(buf);
+    free(inodes);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Использование: %s [-i число_inode] [-n число_блоков] [-F формат] [-g группа] [-b stdio|mmap|uring] "
+                    "[-q глубина] [-c блоков_кэша] [-m КиБ_метаданных] [-f заполнение%%,...] [-t потоков] [-C клиентов] [образ]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    char fills_arg[128] = "10,50,90";
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:F:g:b:q:c:m:f:t:C:h")) != -1) {
+        switch (opt) {
+            case 'i': total_inodes = atoi(optarg); break;
+            case 'n': total_blocks = atoi(optarg); break;
+            case 'F': image_format = atoi(optarg); break;
+            case 'g': group_commit = atoi(optarg); break;
+            case 'b':
+                options.io_backend = strcmp(optarg, "mmap") == 0    ? IO_MMAP
+                                     : strcmp(optarg, "uring") == 0 ? IO_URING
+                                                                    : IO_STDIO;
+                break;
+            case 'q': options.queue_depth = atoi(optarg); break;
+            case 'c': options.cache_blocks = atoi(optarg); break;
+            case 'm': options.meta_cache_kb = atoi(optarg); break;
+            case 't': max_threads = atoi(optarg); break;
+            case 'C': max_clients = atoi(optarg); break;
+            case 'f':
+                strncpy(fills_arg, optarg, sizeof(fills_arg) - 1);
+                break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind < argc) {
+        image = argv[optind];
+    }
+
+    out = stdout;
+
+    fprintf(out, "op,fill,param,ops,ops_per_sec,p50_us,p99_us,p999_us\n");
+    for (char *fill = strtok(fills_arg, ","); fill; fill = strtok(NULL, ",")) {
+        int percent = atoi(fill);
+        fresh_image();
+        prefill(percent);
+        bench_mount(percent, 20);
+        check(sfs_create_dir(fs, "/bench"));
+
+        int room = free_inodes() - 1500;
+        int creates = room < 1000 ? (room > 0 ? room : 0) : 1000;
+        bench_create(percent, creates);
+        bench_resolve(percent, 10000);
+        bench_rw(percent);
+        bench_stream(percent);
+        bench_ls(percent, 1000);
+        bench_delete(percent, creates);
+        bench_rm(percent, free_inodes() > 111 * 10 ? 10 : free_inodes() / 111);
+
+        sfs_umount(fs);
+    }
+    if (max_threads > 0) {
+        bench_stress();
+    }
+    if (max_clients > 0) {
+        bench_server();
+    }
+    remove(image);
+
+    if (errors) {
+        fprintf(stderr, "Ошибок при замерах: %lu\n", errors);
+    }
+    return 0;
+}
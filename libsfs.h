@@ -0,0 +1,147 @@
+#ifndef LIBSFS_H
+#define LIBSFS_H
+
+#include <signal.h>
+#include <stddef.h>
+
+// Встраиваемый интерфейс файловой системы (libsfs.a). Все функции работают
+// с дескриптором смонтированного образа sfs_t, ничего не печатают и
+// сообщают результат кодом: >= 0 — успех (номер inode, число байт),
+// < 0 — одна из ошибок SFS_ERR_*. Разные дескрипторы независимы.
+// Один дескриптор можно использовать из нескольких потоков: чтение и запись
+// разных файлов идут параллельно, изменения пространства имён — по одному.
+// Монтирование, sfs_umount и sfs_cwd не потокобезопасны.
+
+typedef struct sfs sfs_t;
+
+#define MAX_FILENAME_LENGTH 256
+
+// Геометрия по умолчанию и допустимые размеры блока
+#define DEFAULT_BLOCK_SIZE 4096
+#define DEFAULT_TOTAL_BLOCKS 2048
+#define DEFAULT_TOTAL_INODES 128
+#define MIN_BLOCK_SIZE 4096
+#define MAX_BLOCK_SIZE 65536
+
+// Формат образа: монтируются все три, новые образы по умолчанию — формата 3
+#define SFS_FORMAT_V1 1                 // inode по 348 байт с именем, записи директорий по 260 байт
+#define SFS_FORMAT_V2 2                 // inode по 64 байта, имена переменной длины в слотах по 32 байта
+#define SFS_FORMAT_V3 3                 // как 2, но записи лежат в блоках своих директорий
+#define DEFAULT_FORMAT SFS_FORMAT_V3
+
+// Коды ошибок
+#define SFS_OK 0
+#define SFS_ERR_NOENT -1                // нет такого файла или директории
+#define SFS_ERR_EXIST -2                // имя уже занято
+#define SFS_ERR_NOTDIR -3               // не директория
+#define SFS_ERR_ISDIR -4                // директория там, где нужен файл
+#define SFS_ERR_NOTEMPTY -5             // директория не пуста
+#define SFS_ERR_NOSPC -6                // нет свободных блоков
+#define SFS_ERR_NOINODE -7              // нет свободных inode или записей директории
+#define SFS_ERR_NAMETOOLONG -8
+#define SFS_ERR_INVAL -9                // недопустимый аргумент
+#define SFS_ERR_BUSY -10                // корневая или текущая директория
+#define SFS_ERR_IO -11                  // ошибка чтения или записи образа
+#define SFS_ERR_NOMEM -12
+#define SFS_ERR_NOTFS -13               // файл не содержит файловой системы
+#define SFS_ERR_LOCKED -14              // образ или сокет заняты другим процессом
+
+// Механизм доступа к образу, выбирается при монтировании
+#define IO_STDIO 0                      // pread/pwrite
+#define IO_MMAP 1                       // образ отображён в память
+#define IO_URING 2                      // пакеты запросов через io_uring
+
+#define DEFAULT_CACHE_BLOCKS 256        // кадров кэша блоков данных
+#define DEFAULT_QUEUE_DEPTH 64          // запросов в полёте для IO_URING
+#define DEFAULT_META_CACHE_KB 8192      // кэш inode и блоков директорий, КиБ
+
+typedef struct {
+    int io_backend;                     // IO_STDIO, IO_MMAP или IO_URING
+    int cache_blocks;                   // ёмкость кэша блоков, 0 — без кэша
+    int queue_depth;                    // глубина очереди IO_URING, 0 — по умолчанию
+    int meta_cache_kb;                  // предел кэша метаданных, КиБ; 0 — по умолчанию
+} MountOptions;
+
+typedef struct {
+    int inode;
+    int is_directory;
+    int parent;                         // inode родительской директории
+    long size;                          // байт
+    int blocks;                         // выделено блоков данных (дыры не занимают места)
+    int is_inline;                      // данные файла хранятся в самом inode, без блоков
+} SfsStat;
+
+typedef struct {
+    unsigned long bytes_written;        // байт метаданных записано в образ
+    unsigned long writes;               // число операций записи метаданных
+    unsigned long journal_bytes;        // байт записано в журнал
+    unsigned long journal_commits;
+    unsigned long syncs;
+    unsigned long discarded_blocks;     // освобождённых блоков, место которых отдано хосту
+    unsigned long discards;             // вызовов fallocate(PUNCH_HOLE)
+} MetaStats;
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long writebacks;           // изменённых блоков записано в образ
+    unsigned long readahead;            // блоков прочитано с упреждением
+    unsigned long readahead_hits;       // из них понадобились чтению
+    unsigned long readahead_wasted;     // вытеснены, не понадобившись
+} CacheStats;
+
+typedef struct {
+    int block_size;
+    int total_blocks;
+    int free_blocks;
+    int total_inodes;
+    int free_inodes;
+    int io_backend;
+    int format;                         // SFS_FORMAT_*
+    long table_bytes;                   // байт таблиц inode и directory в образе
+    long meta_cache_bytes;              // памяти занято кэшем метаданных
+    MetaStats meta;
+    CacheStats cache;
+} SfsStats;
+
+// Вызывается для каждого элемента директории; ненулевой результат прекращает обход.
+// Вызывается под блокировкой дескриптора и не должен обращаться к библиотеке.
+typedef int (*sfs_dir_fn)(void *ctx, const char *name, const SfsStat *st);
+
+const char *sfs_strerror(int err);
+
+// Образ и монтирование
+int sfs_mkfs(const char *diskname, int block_size, int total_blocks, int total_inodes);
+int sfs_mkfs_format(const char *diskname, int block_size, int total_blocks, int total_inodes, int format);
+sfs_t *sfs_mount(const char *diskname, const MountOptions *options, int *err);
+int sfs_umount(sfs_t *fs);
+void sfs_flush(sfs_t *fs);
+void sfs_set_group_commit(sfs_t *fs, int ops);
+void sfs_get_stats(sfs_t *fs, SfsStats *stats);
+
+// Пространство имён; пути абсолютные или относительно текущей директории
+int sfs_lookup(sfs_t *fs, const char *path);
+int sfs_stat(sfs_t *fs, int inode, SfsStat *st);
+int sfs_path_of(sfs_t *fs, int inode, char *path, size_t path_size);
+int sfs_cd(sfs_t *fs, const char *path);
+const char *sfs_cwd(sfs_t *fs);
+int sfs_create(sfs_t *fs, const char *path);
+int sfs_create_dir(sfs_t *fs, const char *path);
+int sfs_list_dir(sfs_t *fs, const char *path, sfs_dir_fn fn, void *ctx);
+int sfs_delete(sfs_t *fs, const char *path);
+int sfs_delete_dir(sfs_t *fs, const char *path);
+int sfs_delete_dir_recursive(sfs_t *fs, const char *path);
+int sfs_move_to_dir(sfs_t *fs, const char *path, const char *dir_path);
+
+// Данные файла по номеру inode
+long sfs_pread(sfs_t *fs, int inode, void *buf, size_t len, long offset);
+long sfs_pwrite(sfs_t *fs, int inode, const void *buf, size_t len, long offset);
+long sfs_append(sfs_t *fs, int inode, const void *buf, size_t len);
+int sfs_truncate(sfs_t *fs, int inode, long size);
+
+// Сервер для других процессов (протокол — sfs_proto.h, клиент — sfs_client.h):
+// обслуживает соединения на Unix-сокете, пока *stop не станет ненулевым
+int sfs_serve(sfs_t *fs, const char *socket_path, volatile sig_atomic_t *stop);
+
+#endif
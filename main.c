@@ -1,70 +1,539 @@
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
-#include "sfs.h"
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "libsfs.h"
 
-int main() {
-    const char *diskname = "virtual_disk.img";
-    char command[256];
+// Командная оболочка над libsfs: разбор команд, диалог и все сообщения.
 
-    sfs_mkfs(diskname);
-    sfs_mount(diskname);
+static sfs_t *fs = NULL;
+static int image_format = DEFAULT_FORMAT;  // формат создаваемых образов
 
-    while (1) {
-        printf("\n");
-        sfs_pwdm();
-        fgets(command, sizeof(command), stdin);
-        command[strcspn(command, "\n")] = 0; // Убираем символ новой строки
+// Сообщения о ходе операций подавляются в пакетном режиме, ошибки выводятся всегда
+static int quiet = 0;
+static unsigned long error_count = 0;
 
-        char *cmd = strtok(command, " ");
-        char *arg = strtok(NULL, " ");
+__attribute__((format(printf, 1, 2)))
+static void shell_info(const char *format, ...) {
+    if (quiet) return;
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
 
-        if (cmd == NULL) {
-            printf("Неверный формат команды.(Для справки - help)\n");
-            continue;
+__attribute__((format(printf, 1, 2)))
+static void shell_error(const char *format, ...) {
+    error_count++;
+    va_list args;
+    va_start(args, format);
+    if (quiet) {
+        vfprintf(stderr, format, args);
+    } else {
+        vprintf(format, args);
+    }
+    va_end(args);
+}
+
+// Сообщает об ошибке операции над path; возвращает 1, если ошибка была
+static int failed(int err, const char *path) {
+    if (err >= 0) return 0;
+    shell_error("Ошибка: '%s': %s.\n", path, sfs_strerror(err));
+    return 1;
+}
+
+static void usage(const char *prog) {
+    printf("Использование: %s [-s размер_блока] [-n число_блоков] [-i число_inode] [-F 1|2|3] [-b stdio|mmap|uring] [-q глубина] [-c блоков_кэша] [-m КиБ_метаданных] [-x сценарий | -S сокет] [образ]\n", prog);
+    printf("Параметры геометрии применяются только при создании нового образа.\n");
+    printf("-F задаёт формат нового образа: 3 — записи директорий в блоках самих директорий\n");
+    printf("   (по умолчанию), 2 — компактные inode, 1 — прежний; монтируются образы всех форматов.\n");
+    printf("-b задаёт механизм доступа к образу (по умолчанию stdio),\n");
+    printf("-q — глубину очереди io_uring (по умолчанию %d).\n", DEFAULT_QUEUE_DEPTH);
+    printf("-c задаёт ёмкость кэша блоков (по умолчанию %d, 0 — без кэша).\n", DEFAULT_CACHE_BLOCKS);
+    printf("-m — предел кэша метаданных в КиБ (по умолчанию %d).\n", DEFAULT_META_CACHE_KB);
+    printf("-x выполняет команды из файла сценария (- — со стандартного ввода) без диалога;\n");
+    printf("   выводятся только ошибки, результаты команд чтения и итоговая сводка.\n");
+    printf("-S обслуживает образ для других процессов через Unix-сокет (клиент — sfsc)\n");
+    printf("   до Ctrl+C или SIGTERM.\n");
+}
+
+static void help() {
+    printf("\n\n\nc <filename>            - создание файла с именем filename\n");
+    printf("d <filename>            - удаление файла с именем filename\n");
+    printf("w <filename> [offset]   - запись строки в файл filename (с позиции offset — без усечения)\n");
+    printf("a <filename>            - дописывание строки в конец файла filename\n");
+    printf("r <filename> [off [len]]- чтение файла filename (len байт с позиции off)\n");
+    printf("mkdir <dirname>         - создание директории с именем dirname\n");
+    printf("rmdir <dirname>         - удаление директории с именем dirname\n");
+    printf("rm <dirname>            - рекурсивное удаление директории с именем dirname\n");
+    printf("cd <dirname>            - переход в директорию dirname (переход в предыдущую - ..)\n");
+    printf("ls [dirname]            - просмотр текущей директории(* - опционально) или директории с именем dirname\n");
+    printf("mv <filename> <dirname> - перемещение файла filename в директорию dirname\n");
+    printf("pwd                     - получение пути к текущей директории\n");
+    printf("stat <filename>         - размер файла и число занятых им блоков\n");
+    printf("stats                   - статистика кэша блоков и записи метаданных\n");
+    printf("е                       - выход из файловой системы\n\n");
+    printf("Для <filename> и <dirname> возможно указание как полного, так и относительного пути в формате:\n dirname\n ./dirname\n ../dirname\n ./dirname1/dirname2\n /home/.../dirname\n\n\n");
+}
+
+static void print_stats() {
+    SfsStats st;
+    sfs_get_stats(fs, &st);
+    unsigned long lookups = st.cache.hits + st.cache.misses;
+    printf("Формат образа %d: таблицы inode и директорий %ld байт, в кэше метаданных %ld байт\n",
+           st.format, st.table_bytes, st.meta_cache_bytes);
+    printf("Кэш блоков: попаданий %lu, промахов %lu (%.1f%%), вытеснено %lu, записано %lu\n",
+           st.cache.hits, st.cache.misses,
+           lookups ? 100.0 * st.cache.hits / lookups : 0.0,
+           st.cache.evictions, st.cache.writebacks);
+    printf("Упреждающее чтение: блоков %lu, пригодилось %lu (%.1f%%), вытеснено без обращений %lu\n",
+           st.cache.readahead, st.cache.readahead_hits,
+           st.cache.readahead ? 100.0 * st.cache.readahead_hits / st.cache.readahead : 0.0,
+           st.cache.readahead_wasted);
+    printf("Метаданные: записано %lu байт за %lu операций, журнал %lu байт в %lu коммитах, fsync %lu\n",
+           st.meta.bytes_written, st.meta.writes,
+           st.meta.journal_bytes, st.meta.journal_commits, st.meta.syncs);
+    printf("Освобождено на хосте: блоков %lu за %lu вызовов\n",
+           st.meta.discarded_blocks, st.meta.discards);
+}
+
+// Номер inode обычного файла по пути или -1 с сообщением об ошибке
+static int open_regular_file(const char *filename, SfsStat *st) {
+    int file_inode = sfs_lookup(fs, filename);
+    if (file_inode < 0 || sfs_stat(fs, file_inode, st) != SFS_OK || st->is_directory) {
+        shell_error("Файл '%s' не найден или является директорией.\n", filename);
+        return -1;
+    }
+    return file_inode;
+}
+
+// Записывает строку со стандартного ввода в файл. offset < 0 — заменить
+// содержимое файла, append — дописать в конец, иначе — с позиции offset.
+static void write_at(const char *filename, long offset, int append) {
+    SfsStat st;
+    int file_inode = open_regular_file(filename, &st);
+    if (file_inode == -1) {
+        return;
+    }
+
+    shell_info("Введите данные для записи в файл '%s': ", filename);
+
+    // Строка читается и пишется кусками по блоку, без ограничения длины
+    char chunk[MIN_BLOCK_SIZE];
+    long pos = append ? st.size : (offset < 0 ? 0 : offset);
+    long data_written = 0;
+    int incomplete = 0;
+    while (fgets(chunk, sizeof(chunk), stdin) != NULL) {
+        size_t n = strlen(chunk);
+        long w = sfs_pwrite(fs, file_inode, chunk, n, pos);
+        if (w > 0) {
+            pos += w;
+            data_written += w;
+        }
+        if (w != (long)n) {
+            incomplete = 1;
+            break;
+        }
+        if (n > 0 && chunk[n - 1] == '\n') break;
+    }
+
+    if (incomplete) {
+        shell_error("Недостаточно свободного места. Запись неполная.\n");
+        // Остаток строки не должен попасть в интерпретатор команд
+        if (strchr(chunk, '\n') == NULL) {
+            for (int c = getchar(); c != '\n' && c != EOF; c = getchar());
+        }
+    }
+    if (offset < 0 && !append && sfs_stat(fs, file_inode, &st) == SFS_OK && pos < st.size) {
+        sfs_truncate(fs, file_inode, pos);
+    }
+
+    shell_info("Записано %ld байт в файл '%s'.\n", data_written, filename);
+}
+
+// Выводит length байт файла начиная с offset (length < 0 — до конца файла),
+// читая кусками по блоку
+static void read_at(const char *filename, long offset, long length) {
+    SfsStat st;
+    int file_inode = open_regular_file(filename, &st);
+    if (file_inode == -1) {
+        return;
+    }
+
+    SfsStats geometry;
+    sfs_get_stats(fs, &geometry);
+    char *buffer = malloc(geometry.block_size);
+    if (!buffer) {
+        shell_error("Недостаточно памяти.\n");
+        return;
+    }
+
+    shell_info("Данные из файла '%s':\n", filename);
+    long end = length < 0 ? st.size : offset + length;
+    for (long pos = offset; pos < end; ) {
+        size_t want = end - pos < geometry.block_size ? end - pos : geometry.block_size;
+        long got = sfs_pread(fs, file_inode, buffer, want, pos);
+        if (got < 0) {
+            shell_error("\nОшибка чтения файла '%s'.\n", filename);
+            break;
+        }
+        if (got == 0) break;
+        fwrite(buffer, 1, got, stdout);
+        pos += got;
+    }
+    printf("\n");
+    free(buffer);
+}
+
+// Логический размер файла или директории против места, занятого в томе
+static void stat_path(const char *path) {
+    int inode = sfs_lookup(fs, path);
+    SfsStat st;
+    if (failed(inode, path) || failed(sfs_stat(fs, inode, &st), path)) {
+        return;
+    }
+    SfsStats geometry;
+    sfs_get_stats(fs, &geometry);
+    long allocated = (long)st.blocks * geometry.block_size;
+    printf("'%s': inode %d, %s, размер %ld байт, выделено блоков %d (%ld байт)%s\n", path, st.inode,
+           st.is_directory ? "директория" : "файл", st.size, st.blocks, allocated,
+           st.is_inline ? ", в inode" : !st.is_directory && allocated < st.size ? ", разреженный" : "");
+}
+
+// Заголовок печатается перед первым элементом, чтобы обойти директорию один раз
+static int print_entry(void *ctx, const char *name, const SfsStat *st) {
+    const char **header = ctx;
+    if (*header) {
+        printf("Содержимое директории '%s':\n", *header);
+        *header = NULL;
+    }
+    printf("- %s", name);
+    if (st->is_directory) {
+        printf(" (директория)");
+    } else {
+        printf(" (файл, размер: %ld)", st->size);
+    }
+    printf("\n");
+    return 0;
+}
+
+static void ls_dir(const char *dirname) {
+    // Получаем полное имя директории для вывода
+    char dir_path[MAX_FILENAME_LENGTH];
+    if (dirname == NULL || strlen(dirname) == 0) {
+        strncpy(dir_path, sfs_cwd(fs), sizeof(dir_path) - 1);
+        dir_path[sizeof(dir_path) - 1] = '\0';
+    } else {
+        int inode = sfs_lookup(fs, dirname);
+        if (inode >= 0) sfs_path_of(fs, inode, dir_path, sizeof(dir_path));
+    }
+
+    const char *header = dir_path;
+    int r = sfs_list_dir(fs, dirname, print_entry, &header);
+    if (failed(r, dirname ? dirname : "текущий путь")) {
+        return;
+    }
+    if (r == 0) {
+        printf("Содержимое директории '%s':\nДиректория пуста.\n", dir_path);
+    }
+}
+
+// Выполняет одну команду; возвращает 1, если это команда выхода
+static int execute(char *command) {
+    char *cmd = strtok(command, " ");
+    char *arg = strtok(NULL, " ");
+
+    if (cmd == NULL) {
+        shell_error("Неверный формат команды.(Для справки - help)\n");
+        return 0;
+    }
+
+    if (*cmd != 'l' && *cmd != 'e' && strcmp(cmd, "pwd") && strcmp(cmd, "help") && strcmp(cmd, "stats") && arg == NULL) {
+        shell_error("Неверный формат команды.(Для справки - help)\n");
+        return 0;
+    }
+
+    if (strcmp(cmd, "c") == 0) {
+        if (!failed(sfs_create(fs, arg), arg)) {
+            shell_info("Файл '%s' создан.\n", arg);
+        }
+    } else if (strcmp(cmd, "d") == 0) {
+        if (!failed(sfs_delete(fs, arg), arg)) {
+            shell_info("Файл '%s' успешно удален.\n", arg);
+        }
+    } else if (strcmp(cmd, "w") == 0) {
+        char *offset = strtok(NULL, " ");
+        write_at(arg, offset != NULL ? atol(offset) : -1, 0);
+    } else if (strcmp(cmd, "a") == 0) {
+        write_at(arg, 0, 1);
+    } else if (strcmp(cmd, "r") == 0) {
+        char *offset = strtok(NULL, " ");
+        char *length = strtok(NULL, " ");
+        read_at(arg, offset ? atol(offset) : 0, length ? atol(length) : -1);
+    } else if (strcmp(cmd, "e") == 0) {
+        sfs_umount(fs);
+        fs = NULL;
+        shell_info("Файловая система размонтирована. Все данные сохранены.\n");
+        return 1;
+    } else if (strcmp(cmd, "mkdir") == 0) {
+        if (!failed(sfs_create_dir(fs, arg), arg)) {
+            shell_info("Директория '%s' создана.\n", arg);
         }
+    } else if (strcmp(cmd, "mv") == 0) {
+        char *dirname = strtok(NULL, " ");
+        if (dirname == NULL) {
+            shell_error("Неверный формат команды.(Для справки - help)\n");
+        } else if (!failed(sfs_move_to_dir(fs, arg, dirname), arg)) {
+            shell_info("Файл '%s' перемещён в '%s'.\n", arg, dirname);
+        }
+    } else if (strcmp(cmd, "ls") == 0) {
+        ls_dir(arg);
+    } else if (strcmp(cmd, "rmdir") == 0) {
+        if (!failed(sfs_delete_dir(fs, arg), arg)) {
+            shell_info("Директория '%s' успешно удалена.\n", arg);
+        }
+    } else if (strcmp(cmd, "cd") == 0) {
+        if (!failed(sfs_cd(fs, arg), arg)) {
+            shell_info("Текущая директория: %s\n", sfs_cwd(fs));
+        }
+    } else if (strcmp(cmd, "pwd") == 0) {
+        printf("Текущая директория: %s\n", sfs_cwd(fs));
+    } else if (strcmp(cmd, "rm") == 0) {
+        if (!failed(sfs_delete_dir_recursive(fs, arg), arg)) {
+            shell_info("Директория '%s' и все её содержимое успешно удалены.\n", arg);
+        }
+    } else if (strcmp(cmd, "stat") == 0) {
+        stat_path(arg);
+    } else if (strcmp(cmd, "stats") == 0) {
+        print_stats();
+    }else if (strcmp(cmd, "help") == 0) {
+        help ();
+    } else {
+        shell_error("Неизвестная команда.(Для справки - help)\n");
+    }
+    return 0;
+}
+
+// Вопрос пользователю; без интерактива ответ всегда «нет»
+static int ask_yes_no(const char *problem, const char *question, int interactive) {
+    if (!interactive) {
+        shell_error("%s\n", problem);
+        return 0;
+    }
+    printf("%s %s (y/n): ", problem, question);
+    int answer = getchar();
+    for (int c = answer; c != '\n' && c != EOF; c = getchar());
+    return answer == 'y' || answer == 'Y';
+}
+
+static int format(const char *diskname, int block_size, int total_blocks, int total_inodes) {
+    int r = sfs_mkfs_format(diskname, block_size, total_blocks, total_inodes, image_format);
+    if (r == SFS_ERR_EXIST) {
+        shell_info("Файл '%s' уже существует. Используйте mount для доступа.\n", diskname);
+    } else if (r == SFS_ERR_INVAL) {
+        shell_error("Недопустимая геометрия: блок %d байт (%d-%d, степень двойки), %d блоков, %d inode.\n",
+                    block_size, MIN_BLOCK_SIZE, MAX_BLOCK_SIZE, total_blocks, total_inodes);
+    } else if (r != SFS_OK) {
+        shell_error("Ошибка при создании файловой системы: %s.\n", sfs_strerror(r));
+    } else {
+        shell_info("Файловая система отформатирована (формат %d, блок %d байт, %d блоков, %d inode). "
+                   "Корневая директория создана.\n", image_format, block_size, total_blocks, total_inodes);
+    }
+    return r;
+}
+
+// Монтирует образ; отсутствующий или повреждённый образ с согласия
+// пользователя создаётся заново с геометрией по умолчанию
+static sfs_t *mount_image(const char *diskname, const MountOptions *options, int interactive) {
+    int err;
+    sfs_t *mounted = sfs_mount(diskname, options, &err);
+    if (!mounted && err == SFS_ERR_NOENT) {
+        if (!ask_yes_no("Файл диска не существует.", "Создать новую файловую систему?", interactive)) {
+            return NULL;
+        }
+    } else if (!mounted && err == SFS_ERR_NOTFS) {
+        if (!ask_yes_no("Файл не содержит валидной ФС.", "Инициализировать?", interactive)) {
+            return NULL;
+        }
+        remove(diskname);
+    }
+    if (!mounted && (err == SFS_ERR_NOENT || err == SFS_ERR_NOTFS)) {
+        if (format(diskname, DEFAULT_BLOCK_SIZE, DEFAULT_TOTAL_BLOCKS, DEFAULT_TOTAL_INODES) != SFS_OK) {
+            return NULL;
+        }
+        mounted = sfs_mount(diskname, options, &err);
+    }
+    if (!mounted) {
+        shell_error("Не удалось смонтировать '%s': %s.\n", diskname, sfs_strerror(err));
+        return NULL;
+    }
+
+    SfsStats st;
+    sfs_get_stats(mounted, &st);
+    if (options->io_backend == IO_MMAP && st.io_backend != IO_MMAP) {
+        shell_info("Не удалось отобразить образ в память, используется stdio.\n");
+    }
+    if (options->io_backend == IO_URING && st.io_backend != IO_URING) {
+        shell_info("io_uring недоступен, используется pread/pwrite.\n");
+    }
+    shell_info("Файловая система смонтирована (%s). Текущая директория: %s\n",
+               st.io_backend == IO_MMAP ? "mmap" : st.io_backend == IO_URING ? "uring" : "stdio",
+               sfs_cwd(mounted));
+    return mounted;
+}
 
-        if (*cmd != 'l' && *cmd != 'e' && strcmp(cmd, "pwd") && strcmp(cmd, "help") && arg == NULL) {
-            printf("Неверный формат команды.(Для справки - help)\n");
+// Пакетный режим: команды из сценария, без приглашений и сообщений об успехе,
+// метаданные коммитятся одной группой при размонтировании
+static int run_batch(const char *script) {
+    char command[256];
+    unsigned long commands = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    sfs_set_group_commit(fs, INT_MAX);
+    int exited = 0;
+    while (!exited && fgets(command, sizeof(command), stdin) != NULL) {
+        command[strcspn(command, "\n")] = 0;
+        if (command[0] == '\0' || command[0] == '#') {
             continue;
         }
+        commands++;
+        exited = execute(command);
+    }
+    if (!exited) {
+        sfs_umount(fs);
+        fs = NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "Сценарий %s: команд %lu, ошибок %lu, %.3f с (%.0f команд/с)\n",
+            script, commands, error_count, seconds, seconds > 0 ? commands / seconds : 0.0);
+    return error_count ? 1 : 0;
+}
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// Режим сервера: образ остаётся смонтированным, пока сервер не остановят
+static int run_server(const char *socket_path) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    shell_info("Запуск сервера на '%s' (остановка — Ctrl+C).\n", socket_path);
+    fflush(stdout);
+    int r = sfs_serve(fs, socket_path, &stop_requested);
+    int u = sfs_umount(fs);
+    fs = NULL;
+    if (r != SFS_OK) {
+        shell_error("Не удалось запустить сервер на '%s': %s.\n", socket_path, sfs_strerror(r));
+        return 1;
+    }
+    shell_info("Сервер остановлен. Все данные сохранены.\n");
+    return u == SFS_OK ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *diskname = "virtual_disk.img";
+    char command[256];
+    int block_size = DEFAULT_BLOCK_SIZE;
+    int total_blocks = DEFAULT_TOTAL_BLOCKS;
+    int total_inodes = DEFAULT_TOTAL_INODES;
+    MountOptions options = {IO_STDIO, DEFAULT_CACHE_BLOCKS, DEFAULT_QUEUE_DEPTH, DEFAULT_META_CACHE_KB};
+    int interactive = 1;
+    const char *script = NULL;
+    const char *socket_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:i:F:b:q:c:m:x:S:h")) != -1) {
+        switch (opt) {
+            case 's': block_size = atoi(optarg); break;
+            case 'n': total_blocks = atoi(optarg); break;
+            case 'i': total_inodes = atoi(optarg); break;
+            case 'F':
+                image_format = atoi(optarg);
+                if (image_format < SFS_FORMAT_V1 || image_format > SFS_FORMAT_V3) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'b':
+                if (strcmp(optarg, "mmap") == 0) {
+                    options.io_backend = IO_MMAP;
+                } else if (strcmp(optarg, "uring") == 0) {
+                    options.io_backend = IO_URING;
+                } else if (strcmp(optarg, "stdio") == 0) {
+                    options.io_backend = IO_STDIO;
+                } else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'q': options.queue_depth = atoi(optarg); break;
+            case 'c': options.cache_blocks = atoi(optarg); break;
+            case 'm': options.meta_cache_kb = atoi(optarg); break;
+            case 'x': script = optarg; break;
+            case 'S': socket_path = optarg; break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind < argc) {
+        diskname = argv[optind];
+    }
+    if (script != NULL && socket_path != NULL) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (socket_path != NULL) {
+        interactive = 0;
+    }
+
+    if (script != NULL) {
+        // Данные команд записи тоже читаются из сценария
+        if (strcmp(script, "-") != 0 && freopen(script, "r", stdin) == NULL) {
+            fprintf(stderr, "Не удалось открыть сценарий '%s'.\n", script);
+            return 1;
+        }
+        quiet = 1;
+        interactive = 0;
+    }
+
+    format(diskname, block_size, total_blocks, total_inodes);
+    fs = mount_image(diskname, &options, interactive);
+    if (fs == NULL) {
+        return 1;
+    }
+
+    if (script != NULL) {
+        return run_batch(script);
+    }
+    if (socket_path != NULL) {
+        return run_server(socket_path);
+    }
+
+    while (1) {
+        printf("\n%s: ", sfs_cwd(fs));
+        if (fgets(command, sizeof(command), stdin) == NULL) {
+            sfs_umount(fs);  // конец ввода — как команда выхода
+            break;
+        }
+        command[strcspn(command, "\n")] = 0; // Убираем символ новой строки
 
-        if (strcmp(cmd, "c") == 0) {
-            sfs_create(arg);
-        } else if (strcmp(cmd, "d") == 0) {
-            sfs_delete(arg);
-        } else if (strcmp(cmd, "w") == 0) {
-            sfs_write(arg);
-        } else if (strcmp(cmd, "r") == 0) {
-            sfs_read(arg);
-        } else if (strcmp(cmd, "e") == 0) {
-            sfs_umount();
+        if (execute(command)) {
             break;
-        } else if (strcmp(cmd, "mkdir") == 0) {
-            sfs_create_dir(arg);
-        } else if (strcmp(cmd, "mv") == 0) {
-            char *dirname = strtok(NULL, " ");
-            sfs_move_to_dir(arg, dirname);
-        } else if (strcmp(cmd, "ls") == 0) {
-            sfs_ls_dir(arg);
-        } else if (strcmp(cmd, "rmdir") == 0) {
-            sfs_delete_dir(arg);
-        } else if (strcmp(cmd, "cd") == 0) {
-            if (arg != NULL) {
-                sfs_cd(arg);
-            } else {
-                printf("Необходимо указать директорию для перехода.\n");
-            }
-        } else if (strcmp(cmd, "pwd") == 0) {
-            sfs_pwd();
-        } else if (strcmp(cmd, "rm") == 0) {
-            sfs_delete_dir_recursive(arg);
-        }else if (strcmp(cmd, "help") == 0) {
-            help ();
-        } else {
-            printf("Неизвестная команда.(Для справки - help)\n");
         }
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,298 +1,641 @@
+#define _GNU_SOURCE  // PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP
 #include "sfs.h"
 #include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Формат образа по сигнатуре; 0 — не файловая система
+static int format_of(int magic) {
+    switch (magic) {
+        case SFS_MAGIC_V1: return SFS_FORMAT_V1;
+        case SFS_MAGIC_V2: return SFS_FORMAT_V2;
+        case SFS_MAGIC_V3: return SFS_FORMAT_V3;
+        default: return 0;
+    }
+}
+
+void compute_layout(const Superblock *sb, Layout *l) {
+    l->format = format_of(sb->magic_number);
+    if (l->format == SFS_FORMAT_V1) {
+        l->inode_size = sizeof(InodeV1);
+        l->dirent_size = sizeof(DirentV1);
+        l->dirent_count = sb->total_inodes;
+        l->inode_extents = INODE_EXTENTS;
+        l->inline_max = INODE_INLINE_MAX;
+    } else {
+        l->inode_size = sizeof(InodeV2);
+        l->dirent_size = DIRENT_V2_SLOT;
+        l->dirent_count = l->format == SFS_FORMAT_V3 ? 0 : sb->total_inodes * 2;
+        l->inode_extents = INODE_V2_EXTENTS;
+        l->inline_max = INODE_V2_INLINE_MAX;
+    }
+    l->bitmap_offset = sizeof(Superblock);
+    l->bitmap_size = ((long)sb->total_blocks + 63) / 64 * 8;
+    l->inode_table_offset = l->bitmap_offset + l->bitmap_size;
+    l->directory_offset = l->inode_table_offset + (long)l->inode_size * sb->total_inodes;
+    l->journal_offset = l->directory_offset + (long)l->dirent_size * l->dirent_count;
+    l->journal_size = (long)sb->journal_blocks * sb->block_size;
+    long end = l->journal_offset + l->journal_size;
+    l->data_offset = (end + sb->block_size - 1) / sb->block_size * sb->block_size;
+}
+
+// Таблицы в памяти размером по геометрии текущего суперблока. Inode и
+// блоки директорий в них не входят: их по требованию читает кэш
+// метаданных, так что память растёт с рабочим набором, а не с образом.
+static void free_tables(sfs_t *fs) {
+    free(fs->block_bitmap);
+    free(fs->directory);
+    free(fs->dirent_area);
+    fs->block_bitmap = NULL;
+    fs->directory = NULL;
+    fs->dirent_area = NULL;
+    name_index_free(fs);
+    mcache_free(fs);
+    meta_free(fs);
+    journal_free(fs);
+    cache_free(fs);
+    delay_free(fs);
+}
+
+static int alloc_tables(sfs_t *fs, int meta_cache_kb) {
+    free_tables(fs);
+    compute_layout(&fs->superblock, &fs->layout);
+    fs->block_bitmap = calloc(fs->layout.bitmap_size, 1);
+    if (fs->layout.dirent_count > 0) {
+        fs->directory = calloc(fs->layout.dirent_count, sizeof(DirectoryEntry));
+        fs->dirent_area = calloc(fs->layout.dirent_count, fs->layout.dirent_size);
+    }
+    if (!fs->block_bitmap || (fs->layout.dirent_count > 0 && (!fs->directory || !fs->dirent_area)) ||
+        meta_init(fs) != 0 || journal_init(fs) != 0 || delay_init(fs) != 0 || mcache_init(fs, meta_cache_kb) != 0) {
+        free_tables(fs);
+        return -1;
+    }
+    return 0;
+}
+
+// Дескриптор с инициализированными блокировками; таблиц ещё нет
+static sfs_t *fs_new(void) {
+    sfs_t *fs = calloc(1, sizeof(sfs_t));
+    if (!fs) return NULL;
+
+    // Коммит группы ждёт ns_lock на запись; без приоритета писателя
+    // непрерывный поток чтений откладывал бы его сколь угодно долго
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&fs->ns_lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    for (int i = 0; i < INODE_LOCK_STRIPES; i++) {
+        pthread_rwlock_init(&fs->inode_locks[i], NULL);
+    }
+    pthread_rwlock_init(&fs->index.lock, NULL);
+    pthread_mutex_init(&fs->mcache.lock, NULL);
+    pthread_mutex_init(&fs->alloc_lock, NULL);
+    pthread_mutex_init(&fs->meta_lock, NULL);
+    pthread_mutex_init(&fs->io.dirty_lock, NULL);
+    pthread_mutex_init(&fs->cache.readahead_lock, NULL);
+    pthread_mutex_init(&fs->delay.lock, NULL);
+    return fs;
+}
+
+static void fs_delete(sfs_t *fs) {
+    free_tables(fs);
+    pthread_rwlock_destroy(&fs->ns_lock);
+    for (int i = 0; i < INODE_LOCK_STRIPES; i++) {
+        pthread_rwlock_destroy(&fs->inode_locks[i]);
+    }
+    pthread_rwlock_destroy(&fs->index.lock);
+    pthread_mutex_destroy(&fs->mcache.lock);
+    pthread_mutex_destroy(&fs->alloc_lock);
+    pthread_mutex_destroy(&fs->meta_lock);
+    pthread_mutex_destroy(&fs->io.dirty_lock);
+    pthread_mutex_destroy(&fs->cache.readahead_lock);
+    pthread_mutex_destroy(&fs->delay.lock);
+    free(fs);
+}
+
+static int valid_geometry(int block_size, int total_blocks, int total_inodes) {
+    return block_size >= MIN_BLOCK_SIZE && block_size <= MAX_BLOCK_SIZE &&
+           (block_size & (block_size - 1)) == 0 &&
+           total_blocks > 0 && total_inodes >= 2;
+}
 
-// Глобальные переменные
-FILE *disk = NULL;
-Superblock superblock;
-Inode inode_table[MAX_FILES];
-DirectoryEntry directory[MAX_FILES];
-int current_directory_inode = 0;
-char current_directory[MAX_FILENAME_LENGTH] = "";
+const char *sfs_strerror(int err) {
+    switch (err) {
+        case SFS_OK: return "успешно";
+        case SFS_ERR_NOENT: return "нет такого файла или директории";
+        case SFS_ERR_EXIST: return "имя уже существует";
+        case SFS_ERR_NOTDIR: return "не является директорией";
+        case SFS_ERR_ISDIR: return "является директорией";
+        case SFS_ERR_NOTEMPTY: return "директория не пуста";
+        case SFS_ERR_NOSPC: return "нет свободных блоков";
+        case SFS_ERR_NOINODE: return "нет свободных inode";
+        case SFS_ERR_NAMETOOLONG: return "слишком длинное имя";
+        case SFS_ERR_INVAL: return "недопустимый аргумент";
+        case SFS_ERR_BUSY: return "корневая или текущая директория";
+        case SFS_ERR_IO: return "ошибка ввода-вывода";
+        case SFS_ERR_NOMEM: return "недостаточно памяти";
+        case SFS_ERR_NOTFS: return "файл не содержит валидной ФС";
+        case SFS_ERR_LOCKED: return "используется другим процессом";
+        default: return "неизвестная ошибка";
+    }
+}
 
 // Основные функции файловой системы
 
-void sfs_mkfs(const char *diskname) {
+int sfs_mkfs(const char *diskname, int block_size, int total_blocks, int total_inodes) {
+    return sfs_mkfs_format(diskname, block_size, total_blocks, total_inodes, DEFAULT_FORMAT);
+}
+
+int sfs_mkfs_format(const char *diskname, int block_size, int total_blocks, int total_inodes, int format) {
     FILE *test = fopen(diskname, "rb");
     if (test) {
         fclose(test);
-        printf("Файл '%s' уже существует. Используйте mount для доступа.\n", diskname);
-        return;
+        return SFS_ERR_EXIST;
     }
 
-    disk = fopen(diskname, "wb+");
-    if (!disk) {
-        printf("Не удалось создать файл диска.\n");
-        return;
+    if (!valid_geometry(block_size, total_blocks, total_inodes) ||
+        (format != SFS_FORMAT_V1 && format != SFS_FORMAT_V2 && format != SFS_FORMAT_V3)) {
+        return SFS_ERR_INVAL;
     }
 
+    // Таблицы строятся во временном дескрипторе, который не монтируется
+    sfs_t *fs = fs_new();
+    if (!fs) return SFS_ERR_NOMEM;
+    fs->disk = fopen(diskname, "wb+");
+    if (!fs->disk) {
+        fs_delete(fs);
+        return SFS_ERR_IO;
+    }
+    fs->io.fd = fileno(fs->disk);
+
     // Initialize superblock
-    superblock.total_blocks = MAX_BLOCKS;
-    superblock.free_blocks = MAX_BLOCKS;
-    superblock.total_inodes = MAX_FILES;
-    superblock.free_inodes = MAX_FILES - 1;
-    memset(superblock.block_bitmap, 0x00, sizeof(superblock.block_bitmap));
-    superblock.magic_number = 0x53465331; // "SFS1"
-
-    // Initialize inodes and directory
-    for (int i = 0; i < MAX_FILES; i++) {
-        inode_table[i].is_used = 0;
-        inode_table[i].is_directory = 0;    memset(superblock.block_bitmap, 0x00, sizeof(superblock.block_bitmap));
-        inode_table[i].directory_inode_index = -1;
-        directory[i].inode_index = -1;
-        memset(directory[i].filename, 0, MAX_FILENAME_LENGTH);
+    Superblock *sb = &fs->superblock;
+    sb->magic_number = format == SFS_FORMAT_V1 ? SFS_MAGIC_V1 : format == SFS_FORMAT_V2 ? SFS_MAGIC_V2 : SFS_MAGIC_V3;
+    sb->block_size = block_size;
+    sb->total_blocks = total_blocks;
+    sb->free_blocks = total_blocks;
+    sb->total_inodes = total_inodes;
+    sb->free_inodes = total_inodes - 1;
+    sb->journal_blocks = (JOURNAL_SIZE + block_size - 1) / block_size;
+
+    if (alloc_tables(fs, 0) != 0) {
+        fclose(fs->disk);
+        fs_delete(fs);
+        remove(diskname);
+        return SFS_ERR_NOMEM;
     }
 
-    // Create root directory
-    inode_table[0].is_used = 1;
-    inode_table[0].is_directory = 1;
-    inode_table[0].directory_inode_index = -1;
-    strncpy(inode_table[0].filename, "/", MAX_FILENAME_LENGTH);
-    directory[0].inode_index = 0;
-    strncpy(directory[0].filename, "/", MAX_FILENAME_LENGTH);
-
-    create_home_directory();
-
-    // Write to disk
-    fseek(disk, 0, SEEK_SET);
-    fwrite(&superblock, sizeof(Superblock), 1, disk);
-    fwrite(inode_table, sizeof(Inode), MAX_FILES, disk);
-    fwrite(directory, sizeof(DirectoryEntry), MAX_FILES, disk);
-    fflush(disk);
-
-    printf("Файловая система отформатирована. Корневая директория создана.\n");
-}
-
-void sfs_mount(const char *diskname) {
-    disk = fopen(diskname, "rb+");///////
-    if (!disk) {
-        printf("Файл диска не существует. Создать новую файловую систему? (y/n): ");
-        int answer = getchar();
-        while (getchar() != '\n');
-
-        if (answer == 'y' || answer == 'Y') {
-            sfs_mkfs(diskname);
-            disk = fopen(diskname, "rb+");/////////////////
-            if (!disk) {
-                printf("Ошибка при создании файловой системы.\n");
-                return;
-            }
-        } else {
-            return;
-        }
+    // Образ сразу полного размера, а всё за суперблоком — дыра: нулевая
+    // таблица inode — это свободные inode, а область данных занимает место
+    // на хосте только записанными блоками
+    int err = SFS_OK;
+    long image_size = fs->layout.data_offset + (long)total_blocks * block_size;
+    if (ftruncate(fs->io.fd, image_size) != 0) err = SFS_ERR_IO;
+
+    // Биты за концом тома в последнем слове карты помечаем занятыми
+    for (long i = total_blocks; i < fs->layout.bitmap_size * 8; i++) {
+        fs->block_bitmap[i / 8] |= (1 << (i % 8));
     }
 
-    // проверка валидности ФС
-    if (!is_valid_filesystem(disk)) {
-        printf("Файл не содержит валидной ФС. Инициализировать? (y/n): ");
-        int answer = getchar();
-        while (getchar() != '\n');
-
-        if (answer == 'y' || answer == 'Y') {
-            fclose(disk);
-            remove(diskname);
-            sfs_mkfs(diskname);
-            disk = fopen(diskname, "rb+");////////////////////////////////
-            if (!disk) {
-                printf("Ошибка при создании файловой системы.\n");
-                return;
-            }
-        } else {
-            fclose(disk);
-            disk = NULL;
-            return;
-        }
+    // Свободные записи directory[] форматов 1 и 2 — не нули
+    for (int i = 0; i < fs->layout.dirent_count; i++) {
+        fs->directory[i].slots = 1;
+        dirent_clear(fs, i);
     }
 
-    fseek(disk, 0, SEEK_SET);
-    if (fread(&superblock, sizeof(Superblock), 1, disk) != 1) {
-        printf("Ошибка чтения суперблока.\n");
-        fclose(disk);
-        disk = NULL;
-        return;
+    if (err == SFS_OK &&
+        (disk_write(fs, &fs->superblock, sizeof(Superblock), 0) != 0 ||
+         disk_write(fs, fs->block_bitmap, fs->layout.bitmap_size, fs->layout.bitmap_offset) != 0 ||
+         (fs->layout.dirent_count > 0 &&
+          disk_write(fs, fs->dirent_area, (long)fs->layout.dirent_size * fs->layout.dirent_count,
+                     fs->layout.directory_offset) != 0))) {
+        err = SFS_ERR_IO;
     }
+    meta_reset_dirty(fs);
 
-    fseek(disk, sizeof(Superblock), SEEK_SET);
-    if (fread(inode_table, sizeof(Inode), MAX_FILES, disk) != MAX_FILES) {
-        printf("Ошибка чтения таблицы inode.\n");
-        fclose(disk);
-        disk = NULL;
-        return;
+    // Create root directory
+    Inode *root = inode_get(fs, 0);
+    if (err == SFS_OK && root) {
+        root->is_used = 1;
+        root->is_directory = 1;
+        root->directory_inode_index = -1;
+        mark_inode_dirty(fs, 0);
+        if (fs->layout.dirent_count > 0) dirent_set(fs, 0, 0, "/");
+
+        // Корень и /home уходят в образ обычным коммитом группы
+        if (name_index_build(fs) != 0) err = SFS_ERR_NOMEM;
+        if (err == SFS_OK) create_home_directory(fs);
+        sfs_flush(fs);
+    } else {
+        err = SFS_ERR_IO;
     }
+    journal_clear(fs);
+
+    if (fclose(fs->disk) != 0) err = SFS_ERR_IO;
+    fs_delete(fs);
+    if (err != SFS_OK) remove(diskname);
+    return err;
+}
+
+static sfs_t *mount_failed(sfs_t *fs, int code, int *err) {
+    io_detach(fs);
+    fclose(fs->disk);
+    fs_delete(fs);
+    if (err) *err = code;
+    return NULL;
+}
 
-    fseek(disk, sizeof(Superblock) + sizeof(Inode) * MAX_FILES, SEEK_SET);
-    if (fread(directory, sizeof(DirectoryEntry), MAX_FILES, disk) != MAX_FILES) {
-        printf("Ошибка чтения директории.\n");
-        fclose(disk);
-        disk = NULL;
-        return;
+// Монтирует образ. При ошибке возвращает NULL и код в *err:
+// SFS_ERR_NOENT — файла нет, SFS_ERR_NOTFS — в файле нет файловой системы,
+// SFS_ERR_LOCKED — образ смонтирован другим процессом.
+// Если отобразить образ в память не удалось, используется IO_STDIO.
+sfs_t *sfs_mount(const char *diskname, const MountOptions *options, int *err) {
+    sfs_t *fs = fs_new();
+    if (!fs) {
+        if (err) *err = SFS_ERR_NOMEM;
+        return NULL;
     }
 
-    // установка текущей директории
-    current_directory_inode = 0;
-    strcpy(current_directory, "/");
+    fs->disk = fopen(diskname, "rb+");
+    if (!fs->disk) {
+        fs_delete(fs);
+        if (err) *err = SFS_ERR_NOENT;
+        return NULL;
+    }
+    fs->io.fd = fileno(fs->disk);
+
+    // Метаданные живут в памяти монтирования, поэтому второй процесс с тем же
+    // образом испортил бы его; общий доступ — через sfs_serve
+    if (flock(fs->io.fd, LOCK_EX | LOCK_NB) != 0) {
+        fclose(fs->disk);
+        fs_delete(fs);
+        if (err) *err = SFS_ERR_LOCKED;
+        return NULL;
+    }
 
-    // ищем /home
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index != -1 &&
-            strcmp(directory[i].filename, "home") == 0 &&
-            inode_table[directory[i].inode_index].is_directory) {
-            current_directory_inode = directory[i].inode_index;
-            strcpy(current_directory, "/home");
-            break;
-        }
+    // проверка валидности ФС; суперблок читается один раз
+    if (!is_valid_filesystem(fs)) {
+        fclose(fs->disk);
+        fs_delete(fs);
+        if (err) *err = SFS_ERR_NOTFS;
+        return NULL;
     }
 
-    printf("Файловая система смонтирована. Текущая директория: %s\n", current_directory);
-}
+    if (alloc_tables(fs, options ? options->meta_cache_kb : 0) != 0) {
+        return mount_failed(fs, SFS_ERR_NOMEM, err);
+    }
+
+    io_attach(fs, options ? options->io_backend : IO_STDIO, options ? options->queue_depth : 0);
 
-void sfs_umount() {
-    if (disk) {
+    if (cache_init(fs, options ? options->cache_blocks : DEFAULT_CACHE_BLOCKS) != 0) {
+        return mount_failed(fs, SFS_ERR_NOMEM, err);
+    }
+
+    // Доигрываем изменения, закоммиченные в журнал до сбоя; геометрию журнал не меняет
+    int replayed = journal_replay(fs);
+    if (replayed < 0) {
+        return mount_failed(fs, replayed, err);
+    }
+    if (replayed > 0 && disk_read(fs, &fs->superblock, sizeof(Superblock), 0) != 0) {
+        return mount_failed(fs, SFS_ERR_IO, err);
+    }
 
-        fseek(disk, 0, SEEK_SET);
-        fwrite(&superblock, sizeof(Superblock), 1, disk);
+    // В память сразу читаются только битовая карта и directory[] форматов
+    // 1 и 2; inode и блоки директорий формата 3 — при первом обращении.
+    // Правки метаданных попадают в образ только после записи в журнал,
+    // поэтому прямо в отображении их менять нельзя.
+    if (disk_read(fs, fs->block_bitmap, fs->layout.bitmap_size, fs->layout.bitmap_offset) != 0 ||
+        (fs->layout.dirent_count > 0 &&
+         disk_read(fs, fs->dirent_area, (long)fs->layout.dirent_size * fs->layout.dirent_count,
+                   fs->layout.directory_offset) != 0)) {
+        return mount_failed(fs, SFS_ERR_IO, err);
+    }
+    if (fs->layout.dirent_count > 0) dirents_decode(fs);
+    if (!inode_get(fs, 0)) {
+        return mount_failed(fs, SFS_ERR_IO, err);
+    }
 
-        fseek(disk, sizeof(Superblock), SEEK_SET);
-        fwrite(inode_table, sizeof(Inode), MAX_FILES, disk);
+    if (name_index_build(fs) != 0) {
+        return mount_failed(fs, SFS_ERR_NOMEM, err);
+    }
+    meta_reset_dirty(fs);
 
-        fseek(disk, sizeof(Superblock) + sizeof(Inode) * MAX_FILES, SEEK_SET);
-        fwrite(directory, sizeof(DirectoryEntry), MAX_FILES, disk);
+    // Счётчик свободных блоков восстанавливаем по битовой карте
+    fs->superblock.free_blocks = count_free_blocks(fs);
 
-        fflush(disk);
-        fclose(disk);
-        disk = NULL;
+    // установка текущей директории
+    fs->current_directory_inode = 0;
+    strcpy(fs->current_directory, "/");
 
-        printf("Файловая система размонтирована. Все данные сохранены.\n");
+    // ищем /home
+    int home = name_index_lookup(fs, 0, "home");
+    Inode *home_inode = inode_get(fs, home);
+    if (home_inode && home_inode->is_directory) {
+        fs->current_directory_inode = home;
+        strcpy(fs->current_directory, "/home");
     }
+
+    if (err) *err = SFS_OK;
+    return fs;
+}
+
+// Сохраняет все изменения и освобождает дескриптор
+int sfs_umount(sfs_t *fs) {
+    if (!fs) return SFS_ERR_INVAL;
+    sfs_flush(fs);
+    journal_clear(fs);
+    io_detach(fs);
+    int err = fclose(fs->disk) == 0 && !fs->meta.commit_failed ? SFS_OK : SFS_ERR_IO;
+    fs_delete(fs);
+    return err;
 }
 
-int find_free_inode() {
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (inode_table[i].is_used == 0) {
+void sfs_get_stats(sfs_t *fs, SfsStats *stats) {
+    op_begin(fs, 0);
+    stats->block_size = fs->superblock.block_size;
+    stats->total_blocks = fs->superblock.total_blocks;
+    pthread_mutex_lock(&fs->alloc_lock);
+    stats->free_blocks = fs->superblock.free_blocks - fs->reserved_blocks;
+    pthread_mutex_unlock(&fs->alloc_lock);
+    stats->total_inodes = fs->superblock.total_inodes;
+    stats->free_inodes = fs->superblock.free_inodes;
+    stats->io_backend = fs->io.backend;
+    stats->format = fs->layout.format;
+    stats->table_bytes = fs->layout.journal_offset - fs->layout.inode_table_offset;
+    stats->meta_cache_bytes = __atomic_load_n(&fs->mcache.bytes, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&fs->meta_lock);
+    stats->meta = fs->meta.stats;
+    pthread_mutex_unlock(&fs->meta_lock);
+    cache_get_stats(fs, &stats->cache);
+    op_end(fs);
+}
+
+// Поиск свободных inode и записей directory[] идёт по кругу от места
+// последней находки, чтобы серия созданий не просматривала таблицу с начала.
+// Inode просматриваются страницами кэша метаданных; когда свободных нет
+// по суперблоку, таблица не читается вовсе.
+int find_free_inode(sfs_t *fs) {
+    if (fs->superblock.free_inodes <= 0) return -1;
+    int pages = fs->mcache.page_count;
+    int first = fs->inode_cursor / INODE_PAGE;
+    for (int n = 0; n <= pages; n++) {
+        int page = (first + n) % pages;
+        int i = inode_page_find_free(fs, page, n == 0 ? fs->inode_cursor % INODE_PAGE : 0);
+        if (i != -1) {
+            fs->inode_cursor = i;
             return i;
         }
     }
     return -1;
 }
 
-int find_free_block() {
-    for (int i = 0; i < MAX_BLOCKS; i++) {
-        if ((superblock.block_bitmap[i / 8] & (1 << (i % 8))) == 0) {
+// Первая из dirent_slots подряд свободных записей под имя name
+int find_free_dir_entry(sfs_t *fs, const char *name) {
+    int total = fs->layout.dirent_count;
+    int slots = dirent_slots(fs, strnlen(name, MAX_FILENAME_LENGTH - 1));
+    for (int n = 0; n < total; n++) {
+        int i = (fs->dir_entry_cursor + n) % total;
+        if (i + slots > total) continue;
+        int free_slots = 0;
+        while (free_slots < slots && fs->directory[i + free_slots].inode_index == DIRENT_FREE) free_slots++;
+        if (free_slots == slots) {
+            fs->dir_entry_cursor = i;
             return i;
         }
     }
     return -1;
 }
 
-void allocate_block(int block_index) {
-    superblock.block_bitmap[block_index / 8] |= (1 << (block_index % 8));
-    superblock.free_blocks--;
+// Аллокатор блоков. Битовая карта просматривается 64-битными словами
+// (бит i лежит в байте i/8 под номером i%8, что совпадает с little-endian
+// словом), поиск начинается с курсора next-fit за последним выделением.
+// Блоки, освобождённые в незакоммиченной группе (meta.discard_queued),
+// считаются занятыми до её коммита: иначе новые данные легли бы на место
+// блока, который после сбоя снова принадлежит прежнему файлу.
+
+static uint64_t bitmap_word(sfs_t *fs, long w) {
+    uint64_t word;
+    memcpy(&word, fs->block_bitmap + w * 8, sizeof(word));
+    return word;
 }
 
-void free_block(int block_index) {
-    superblock.block_bitmap[block_index / 8] &= ~(1 << (block_index % 8));
-    superblock.free_blocks++;
+// Слово карты для поиска свободного места (под alloc_lock)
+static uint64_t alloc_word(sfs_t *fs, long w) {
+    uint64_t pending;
+    memcpy(&pending, fs->meta.discard_queued + w * 8, sizeof(pending));
+    return bitmap_word(fs, w) | pending;
 }
 
-void print_current_directory() {
-    if (current_directory_inode == 0) {
-        printf("/\n");
-        return;
+// Первый блок >= from с заданным значением бита или total_blocks.
+// Биты за концом тома в последнем слове всегда установлены.
+static int bitmap_next(sfs_t *fs, int from, int used) {
+    int total = fs->superblock.total_blocks;
+    long words = fs->layout.bitmap_size / 8;
+    if (from >= total) return total;
+    long w = from / 64;
+    uint64_t word = used ? alloc_word(fs, w) : ~alloc_word(fs, w);
+    word &= ~0ULL << (from % 64);
+    while (word == 0) {
+        if (++w >= words) return total;
+        word = used ? alloc_word(fs, w) : ~alloc_word(fs, w);
     }
-    char path[MAX_FILENAME_LENGTH];
-    build_path_from_inode(current_directory_inode, path, MAX_FILENAME_LENGTH);
-    printf("%s\n", path);
+    long pos = w * 64 + __builtin_ctzll(word);
+    return pos < total ? pos : total;
 }
 
-void build_path_from_inode(int inode, char *path, size_t path_size) {
-    if (inode == 0) {
-        strncpy(path, "/", path_size);
-        return;
-    }
-    char parent_path[MAX_FILENAME_LENGTH] = "";
-    int parent_inode = inode_table[inode].directory_inode_index;
-    if (parent_inode != 0) {
-        build_path_from_inode(parent_inode, parent_path, sizeof(parent_path));
-    }
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index == inode) {
-            if (strcmp(parent_path, "/") == 0) {
-                snprintf(path, path_size, "/%s", directory[i].filename);
-            } else {
-                snprintf(path, path_size, "%s/%s", parent_path, directory[i].filename);
+// Ищет непрерывный свободный участок из want блоков, начиная с курсора.
+// Если такого нет, возвращает самый длинный найденный. *got — его длина.
+static int find_free_run(sfs_t *fs, int want, int *got) {
+    int best_start = -1, best_len = 0;
+    int from[2] = {fs->alloc_cursor, 0};
+    int to[2] = {fs->superblock.total_blocks, fs->alloc_cursor};
+
+    for (int pass = 0; pass < 2; pass++) {
+        int pos = bitmap_next(fs, from[pass], 0);
+        while (pos < to[pass]) {
+            int end = bitmap_next(fs, pos, 1);
+            if (end - pos >= want) {
+                *got = want;
+                return pos;
+            }
+            if (end - pos > best_len) {
+                best_start = pos;
+                best_len = end - pos;
             }
-            break;
+            pos = bitmap_next(fs, end, 0);
         }
     }
+
+    *got = best_len;
+    return best_start;
+}
+
+int count_free_blocks(sfs_t *fs) {
+    long words = fs->layout.bitmap_size / 8;
+    long used = 0;
+    for (long w = 0; w < words; w++) {
+        used += __builtin_popcountll(bitmap_word(fs, w));
+    }
+    return words * 64 - used;
 }
 
-void sfs_pwd() {
-    printf("Текущая директория: %s\n", current_directory);
+static void mark_allocated(sfs_t *fs, int block_index) {
+    fs->block_bitmap[block_index / 8] |= (1 << (block_index % 8));
+    fs->superblock.free_blocks--;
+    mark_bitmap_dirty(fs, block_index);
+    fs->alloc_cursor = block_index + 1 < fs->superblock.total_blocks ? block_index + 1 : 0;
 }
 
-void sfs_pwdm() {
-    printf("%s: ", current_directory);
+// Поиск и занятие участка — одно действие под alloc_lock, чтобы два
+// потока не получили одни и те же блоки. Возвращает начало участка или -1.
+// Блоки, зарезервированные под отложенную запись, достаются только
+// вызовам с reserved, и резерв уменьшается на выделенное.
+int allocate_run(sfs_t *fs, int want, int *got, int reserved) {
+    pthread_mutex_lock(&fs->alloc_lock);
+    int available = fs->superblock.free_blocks - fs->meta.discard_count - (reserved ? 0 : fs->reserved_blocks);
+    if (want > available) want = available;
+    int start = want > 0 ? find_free_run(fs, want, got) : -1;
+    for (int i = 0; start != -1 && i < *got; i++) {
+        mark_allocated(fs, start + i);
+    }
+    if (start != -1 && reserved) {
+        fs->reserved_blocks -= *got;
+    }
+    pthread_mutex_unlock(&fs->alloc_lock);
+    return start;
 }
 
-int is_valid_filesystem(FILE *f) {
-    if (!f) return 0;
+int allocate_block(sfs_t *fs) {
+    int got;
+    return allocate_run(fs, 1, &got, 0);
+}
 
-    // 1. Проверяем размер файла
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+// Резервирует до count свободных блоков; возвращает, сколько удалось
+int reserve_blocks(sfs_t *fs, int count) {
+    pthread_mutex_lock(&fs->alloc_lock);
+    int available = fs->superblock.free_blocks - fs->meta.discard_count - fs->reserved_blocks;
+    if (count > available) count = available;
+    if (count < 0) count = 0;
+    fs->reserved_blocks += count;
+    pthread_mutex_unlock(&fs->alloc_lock);
+    return count;
+}
 
-    if (size < sizeof(Superblock) + sizeof(Inode)*MAX_FILES) {
-        return 0;
+void release_blocks(sfs_t *fs, int count) {
+    pthread_mutex_lock(&fs->alloc_lock);
+    fs->reserved_blocks -= count;
+    pthread_mutex_unlock(&fs->alloc_lock);
+}
+
+// Ждёт ли коммита группы больше блоков, чем осталось свободных для выделения
+int alloc_frees_pending(sfs_t *fs) {
+    pthread_mutex_lock(&fs->alloc_lock);
+    int pending = fs->meta.discard_count;
+    int pressed = pending > 0 && pending > fs->superblock.free_blocks - pending - fs->reserved_blocks;
+    pthread_mutex_unlock(&fs->alloc_lock);
+    return pressed;
+}
+
+void free_block(sfs_t *fs, int block_index) {
+    pthread_mutex_lock(&fs->alloc_lock);
+    fs->block_bitmap[block_index / 8] &= ~(1 << (block_index % 8));
+    fs->superblock.free_blocks++;
+    mark_bitmap_dirty(fs, block_index);
+    queue_discard(fs, block_index);
+    pthread_mutex_unlock(&fs->alloc_lock);
+    // Содержимое свободного блока не нужно: изменённый кадр не пишем в образ
+    cache_discard(fs, block_index, 1);
+}
+
+static int cmp_extent_start(const void *a, const void *b) {
+    int x = ((const Extent *)a)->start, y = ((const Extent *)b)->start;
+    return (x > y) - (x < y);
+}
+
+// Освобождает блоки списка одним проходом по битовой карте: список
+// сортируется, alloc_lock берётся один раз, а изменённые участки карты
+// отмечаются по диапазонам, а не по блокам
+void free_block_list(sfs_t *fs, ExtentList *list) {
+    int total = fs->superblock.total_blocks;
+    if (list->count == 0) return;
+    qsort(list->items, list->count, sizeof(Extent), cmp_extent_start);
+    pthread_mutex_lock(&fs->alloc_lock);
+    for (int i = 0; i < list->count; i++) {
+        int start = list->items[i].start, end = start + list->items[i].length;
+        if (start < 0 || end > total) continue;
+        for (int b = start; b < end; b++) {
+            fs->block_bitmap[b / 8] &= ~(1 << (b % 8));
+            queue_discard(fs, b);
+        }
+        fs->superblock.free_blocks += end - start;
+        mark_bitmap_range_dirty(fs, start, end - start);
+    }
+    pthread_mutex_unlock(&fs->alloc_lock);
+    for (int i = 0; i < list->count; i++) {
+        if (list->items[i].start >= 0) cache_discard(fs, list->items[i].start, list->items[i].length);
     }
+}
 
-    // 2. Проверяем сигнатуру суперблока
-    Superblock sb;
-    if (fread(&sb, sizeof(Superblock), 1, f) != 1) {
-        return 0;
+void build_path_from_inode(sfs_t *fs, int inode, char *path, size_t path_size) {
+    name_index_path(fs, inode, path, path_size);
+}
+
+int sfs_path_of(sfs_t *fs, int inode, char *path, size_t path_size) {
+    op_begin(fs, 0);
+    int r = SFS_ERR_NOENT;
+    Inode *node = inode_get(fs, inode);
+    if (node && node->is_used) {
+        build_path_from_inode(fs, inode, path, path_size);
+        r = SFS_OK;
     }
+    op_end(fs);
+    return r;
+}
+
+const char *sfs_cwd(sfs_t *fs) {
+    return fs->current_directory;
+}
 
-    if (sb.total_blocks != MAX_BLOCKS || sb.total_inodes != MAX_FILES) {
+// Читает суперблок в fs->superblock и проверяет его и корневой inode
+int is_valid_filesystem(sfs_t *fs) {
+    // 1. Проверяем сигнатуру (формат 1, 2 или 3) и геометрию суперблока
+    Superblock *sb = &fs->superblock;
+    if (disk_read(fs, sb, sizeof(Superblock), 0) != 0 || format_of(sb->magic_number) == 0) {
         return 0;
     }
-
-    if (sb.magic_number != 0x53465331) {
+    if (!valid_geometry(sb->block_size, sb->total_blocks, sb->total_inodes) || sb->journal_blocks <= 0) {
         return 0;
     }
 
-    // 3. Проверяем корневую директорию
-    Inode root_inode;
-    fseek(f, sizeof(Superblock), SEEK_SET);
-    if (fread(&root_inode, sizeof(Inode), 1, f) != 1) {
+    // 2. Таблицы и журнал должны целиком помещаться в файле; блоки данных
+    // могут быть ещё не записаны
+    Layout l;
+    compute_layout(sb, &l);
+    struct stat st;
+    if (fstat(fs->io.fd, &st) != 0 || st.st_size < l.journal_offset) {
         return 0;
     }
 
-    if (!root_inode.is_used || !root_inode.is_directory) {
+    // 3. Проверяем корневую директорию
+    char raw[sizeof(InodeV1)];
+    if (disk_read(fs, raw, l.inode_size, l.inode_table_offset) != 0) {
         return 0;
     }
-
-    return 1;
+    Inode root_inode;
+    inode_decode(&l, raw, &root_inode);
+    return root_inode.is_used && root_inode.is_directory;
 }
 
-long get_block_offset(int block_index) {
-    return sizeof(Superblock)
-           + sizeof(Inode) * MAX_FILES
-           + sizeof(DirectoryEntry) * MAX_FILES
-           + block_index * BLOCK_SIZE;
+pthread_rwlock_t *inode_lock(sfs_t *fs, int inode) {
+    return &fs->inode_locks[(unsigned int)inode % INODE_LOCK_STRIPES];
 }
 
-void help() {
-    printf("\n\n\nc <filename>            - создание файла с именем filename\n");
-    printf("d <filename>            - удаление файла с именем filename\n");
-    printf("w <filename>            - открытие файла с именем filename для записи\n");
-    printf("r <filename>            - чтение файла с именем filename\n");
-    printf("mkdir <dirname>         - создание директории с именем dirname\n");
-    printf("rmdir <dirname>         - удаление директории с именем dirname\n");
-    printf("rm <dirname>            - рекурсивное удаление директории с именем dirname\n");
-    printf("cd <dirname>            - переход в директорию dirname (переход в предыдущую - ..)\n");
-    printf("ls [dirname]            - просмотр текущей директории(* - опционально) или директории с именем dirname\n");
-    printf("mv <filename> <dirname> - перемещение файла filename в директорию dirname\n");
-    printf("pwd                     - получение пути к текущей директории\n");
-    printf("е                       - выход из файловой системы\n\n");
-    printf("Для <filename> и <dirname> возможно указание как полного, так и относительного пути в формате:\n dirname\n ./dirname\n ../dirname\n ./dirname1/dirname2\n /home/.../dirname\n\n\n");
-}
\ No newline at end of file
+long get_block_offset(sfs_t *fs, int block_index) {
+    return fs->layout.data_offset
+           + (long)block_index * fs->superblock.block_size;
+}
@@ -1,81 +1,491 @@
 #ifndef SFS_H
 #define SFS_H
 
+// Внутренний заголовок libsfs: формат образа и состояние монтирования.
+// Внешний интерфейс — libsfs.h.
+
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "libsfs.h"
 
 // Константы
-#define MAX_FILENAME_LENGTH 256
-#define MAX_BLOCKS 2048
-#define MAX_FILES 128
-#define BLOCK_SIZE 4096
+#define SFS_MAGIC_V1 0x53465331         // "SFS1": inode с именем, записи directory[] по 260 байт
+#define SFS_MAGIC_V2 0x53465332         // "SFS2": компактные inode и записи имён переменной длины
+#define SFS_MAGIC_V3 0x53465333         // "SFS3": записи имён в блоках своих директорий
+#define INODE_EXTENTS 8                 // экстентов в inode в памяти (в формате 2 на диске — 5)
+#define INODE_INLINE_MAX (INODE_EXTENTS * (int)sizeof(Extent) + (int)sizeof(int32_t))  // байт данных в inode в памяти
+#define JOURNAL_SIZE (1024 * 1024)      // журнал метаданных, байт (округляется до блоков)
+#define INODE_PAGE 64                   // inode на страницу кэша метаданных
+#define INODE_LOCK_STRIPES 1024         // блокировок inode, по номеру inode по модулю
 
-// Структуры
+// Структуры. Поля, которые попадают в образ, — целые фиксированной ширины
 typedef struct {
-    int total_blocks;
-    int free_blocks;
-    int total_inodes;
-    int free_inodes;
-    unsigned char block_bitmap[MAX_BLOCKS/8];
-    int magic_number;
+    int32_t magic_number;
+    int32_t block_size;
+    int32_t total_blocks;
+    int32_t free_blocks;
+    int32_t total_inodes;
+    int32_t free_inodes;
+    int32_t journal_blocks;             // размер журнала в блоках
 } Superblock;
 
+// Расположение областей образа, вычисляется по суперблоку:
+// суперблок | битовая карта | inode | directory | журнал | блоки данных.
+// В формате 3 области directory нет: записи лежат в блоках директорий.
 typedef struct {
-    int is_used;
-    int is_directory;
-    int directory_inode_index;
-    char filename[MAX_FILENAME_LENGTH];
-    int size;
-    int block_count;
-    int blocks[16]; // Максимум 16 блоков на файл
+    long bitmap_offset;
+    long bitmap_size;                   // байт, кратно 8
+    long inode_table_offset;
+    long directory_offset;
+    long journal_offset;
+    long journal_size;
+    long data_offset;                   // выровнено по размеру блока
+
+    // Параметры формата образа (SFS_FORMAT_*)
+    int format;
+    int inode_size;                     // байт на inode в образе
+    int dirent_size;                    // байт на запись (слот) directory[] в образе
+    int dirent_count;                   // записей (слотов) directory[], в формате 3 — 0
+    int inode_extents;                  // экстентов в самом inode
+    int inline_max;                     // байт данных в inode вместо карты
+} Layout;
+
+#define HOLE_BLOCK -1                   // начало экстента-дыры: блоки не выделены, читаются как нули
+
+typedef struct {
+    int32_t start;   // первый блок или HOLE_BLOCK
+    int32_t length;  // число блоков подряд
+} Extent;
+
+// Inode в памяти; в образ он кодируется в формате тома (sfs_format.c)
+typedef struct {
+    uint8_t is_used;
+    uint8_t is_directory;
+    uint16_t reserved;
+    int32_t directory_inode_index;
+    int32_t size;
+    int32_t block_count;            // блоков в карте, включая дыры
+    int32_t extent_count;           // всего экстентов, включая вынесенные в цепочку
+    union {
+        struct {
+            Extent extents[INODE_EXTENTS];  // первые экстенты файла
+            int32_t extent_block;   // первый блок цепочки продолжения, если extents в inode не хватило
+        };
+        char inline_data[INODE_INLINE_MAX]; // содержимое файла без экстентов (size байт)
+    };
 } Inode;
 
+// Inode в образе формата 1: с копией имени, которую никто не читает
+typedef struct {
+    int32_t is_used;
+    int32_t is_directory;
+    int32_t directory_inode_index;
+    char filename[MAX_FILENAME_LENGTH];
+    int32_t size;
+    int32_t block_count;
+    int32_t extent_count;
+    union {
+        struct {
+            Extent extents[INODE_EXTENTS];
+            int32_t extent_block;
+        };
+        char inline_data[INODE_INLINE_MAX];
+    };
+} InodeV1;
+
+// Inode в образе формата 2: без имени, ровно 64 байта — строка кэша
+#define INODE_V2_EXTENTS 5
+#define INODE_V2_INLINE_MAX (INODE_V2_EXTENTS * (int)sizeof(Extent) + (int)sizeof(int32_t))
+
+typedef struct {
+    uint8_t is_used;
+    uint8_t is_directory;
+    uint16_t reserved;
+    int32_t directory_inode_index;
+    int32_t size;
+    int32_t block_count;
+    int32_t extent_count;
+    union {
+        struct {
+            Extent extents[INODE_V2_EXTENTS];
+            int32_t extent_block;
+        };
+        char inline_data[INODE_V2_INLINE_MAX];
+    };
+} InodeV2;
+
+// Запись directory[] формата 1: имя фиксированной длины
 typedef struct {
-    int inode_index;
+    int32_t inode_index;
     char filename[MAX_FILENAME_LENGTH];
+} DirentV1;
+
+// Запись directory[] формата 2 занимает slots подряд идущих слотов по
+// DIRENT_V2_SLOT байт: заголовок, затем имя с завершающим нулём.
+// В свободном слоте inode_index = -1. В формате 3 такие же записи лежат
+// в блоках директорий и не пересекают границу блока; свободен слот с
+// inode_index <= 0, так что обнулённый блок — пустой.
+#define DIRENT_V2_SLOT 32
+
+typedef struct {
+    int32_t inode_index;
+    uint8_t name_length;
+    uint8_t slots;
+    uint16_t reserved;
+} DirentV2;
+
+// Запись directory[] в памяти: имя лежит в образе таблицы (dirent_name)
+#define DIRENT_FREE -1                  // слот свободен
+#define DIRENT_CONT -2                  // слот занят продолжением имени предыдущей записи
+
+typedef struct {
+    int32_t inode_index;            // номер inode, DIRENT_FREE или DIRENT_CONT
+    uint16_t name_length;
+    uint16_t slots;                 // слотов под запись
 } DirectoryEntry;
 
-// Глобальные переменные (объявлены как extern)
-extern FILE *disk;
-extern Superblock superblock;
-extern Inode inode_table[MAX_FILES];
-extern DirectoryEntry directory[MAX_FILES];
-extern int current_directory_inode;
-extern char current_directory[MAX_FILENAME_LENGTH];
-
-// Прототипы функций
-void sfs_mkfs(const char *diskname);
-void sfs_mount(const char *diskname);
-void sfs_umount();
-void sfs_pwdm();
-void sfs_pwd();
-void help();
-int is_valid_filesystem(FILE *f);
-void create_home_directory();
-long get_block_offset(int block_index);
-
-// Функции для файлов
-void sfs_create(const char *filename);
-void sfs_write(const char *filename);
-void sfs_read(const char *filename);
-void sfs_delete(const char *filename);
-
-// Функции для директорий
-void sfs_cd(const char *dirname);
-void sfs_create_dir(const char *dirname);
-void sfs_ls_dir(const char *dirname);
-void sfs_delete_dir(const char *dirname);
-void sfs_delete_dir_recursive(const char *dirname);
-void get_parent_path_and_name(const char *full_path, char *parent_path, char *name);
+typedef struct {
+    long offset;                    // смещение участка в образе
+    const void *data;               // NULL — отмена блока в журнале (sfs_journal.c)
+    size_t len;
+} MetaRegion;
+
+typedef struct {                    // участок пакетного обращения к образу (sfs_io.c)
+    char *buf;
+    size_t len;
+    long offset;
+} DiskRequest;
+
+// Состояние модулей одного монтирования
+
+typedef struct IoRing IoRing;       // sfs_uring.c
+
+typedef struct {                    // sfs_io.c
+    int backend;
+    int fd;                         // позиционный ввод-вывод, без общей позиции FILE
+    IoRing *ring;                   // IO_URING
+    char *map;
+    size_t map_size;
+    pthread_mutex_t dirty_lock;
+    size_t dirty_lo, dirty_hi;      // изменённый диапазон отображения
+} IoState;
+
+typedef struct {                    // sfs_meta.c
+    int superblock_dirty;
+    unsigned char *inode_dirty;
+    int *dirty_inodes;
+    int dirty_inode_count;
+    unsigned char *dirent_dirty;
+    int *dirty_dirents;
+    int dirty_dirent_count;
+    int bitmap_chunks;
+    unsigned char *bitmap_dirty;
+    int *dirty_chunks;
+    int dirty_chunk_count;
+    MetaRegion *regions;            // участки текущей группы: сначала в журнал, затем на место
+    DiskRequest *requests;          // те же участки одним пакетом записи на место
+    int region_count;
+    int region_capacity;
+    int *revoked;                   // освобождённые блоки директорий: их старые записи в журнале не применять
+    int revoked_count;
+    int revoked_capacity;
+    unsigned char *discard_queued;  // бит на блок: освобождён в текущей группе, до коммита не выделяется
+    int *discard_queue;             // эти блоки: после коммита — аллокатору, их место — хосту
+    int discard_count;
+    int pending_ops;                // операций в незакоммиченной группе
+    int commit_failed;              // группа не уместилась в журнал и осталась в памяти
+    int group_commit_ops;
+    MetaStats stats;
+} MetaState;
+
+typedef struct {                    // sfs_journal.c
+    char *buf;                      // layout.journal_size байт
+    long tail;                      // смещение следующей транзакции от начала журнала
+    unsigned long long seq;         // номер следующей транзакции
+} JournalState;
+
+// Имя inode в его директории (sfs_index.c); у директории, чьи записи
+// прочитаны, — ещё и список её детей
+typedef struct Dentry {
+    int32_t inode;                  // -1 — запись отсутствующего имени
+    int32_t parent;                 // inode директории, -1 у корня
+    struct Dentry *hash_next;       // следующая запись той же корзины
+    struct Dentry *next_sibling;    // дети директории в порядке добавления; у отсутствующего
+    struct Dentry *prev_sibling;    //   имени — список отсутствующих имён той же директории
+    struct Dentry *first_child;
+    struct Dentry *last_child;
+    struct Dentry *negative;        // формат 3: запомненные отсутствующие имена директории
+    struct Dentry *next_loaded;     // формат 3: список директорий с прочитанными записями;
+    struct Dentry *prev_loaded;     //   у отсутствующего имени — общий список таких имён
+    int32_t slot;                   // форматы 1, 2: запись directory[]; формат 3: смещение в блоке
+    int32_t block;                  // формат 3: блок тома с записью
+    int32_t dir_block;              // формат 3: его номер в директории
+    int32_t free_block;             // формат 3: в блоках директории до этого места нет
+    int32_t loaded_dirs;            // поддиректорий с прочитанными записями
+    uint32_t used;                  // эпоха последнего обращения (MetaCache.epoch)
+    uint16_t name_length;
+    uint8_t loaded;                 // записи директории прочитаны
+    char name[];
+} Dentry;
+
+typedef struct {                    // sfs_index.c
+    unsigned int bucket_mask;       // число корзин - 1, корзин — степень двойки
+    Dentry **buckets;               // цепочки по (родитель, имя)
+    long count;                     // записей в корзинах
+    Dentry **of_inode;              // запись каждого inode, NULL — не прочитана
+    Dentry *root;
+    Dentry *loaded;                 // формат 3: директории с прочитанными записями
+    Dentry *negatives;              // формат 3: все запомненные отсутствующие имена
+    pthread_rwlock_t lock;          // чтение директорий параллельно с поиском
+} NameIndex;
+
+typedef struct InodePage InodePage;
+typedef struct MetaBlock MetaBlock;
+
+typedef struct {                    // sfs_mcache.c
+    InodePage **pages;              // страницы таблицы inode, NULL — не в памяти
+    int page_count;
+    MetaBlock **buckets;            // кадры блоков директорий по номеру блока
+    unsigned int bucket_mask;
+    int block_count;                // кадров в памяти
+    MetaBlock *dirty;               // изменённые кадры текущей группы
+    long dirty_bytes;               // сумма их изменённых диапазонов
+    long bytes;                     // память страниц, кадров и прочитанных записей директорий
+    long limit;
+    long high;                      // выше — коммит группы ради памяти (mcache_trim)
+    unsigned int epoch;             // растёт с каждым коммитом группы
+    pthread_mutex_t lock;           // загрузка страниц и таблица кадров
+} MetaCache;
+
+typedef struct {                    // отложенный хвост одного файла
+    char *data;                     // байты за последним выделенным блоком
+    size_t len;
+    size_t cap;
+    int reserved;                   // блоков в резерве под хвост
+    int slot;                       // позиция в DelayState.inodes
+    time_t since;                   // когда хвост появился
+} DelayedTail;
+
+typedef struct {                    // sfs_delay.c
+    DelayedTail *tails;             // по номеру inode
+    int *inodes;                    // файлы с непустым хвостом
+    int count;
+    long bytes;                     // байт во всех хвостах
+    pthread_mutex_t lock;           // inodes, count, bytes
+} DelayState;
+
+typedef struct CacheShard CacheShard;
+
+typedef struct {                    // упреждающее чтение одного файла
+    long next_offset;               // где началось бы последовательное чтение
+    long ahead;                     // до какого смещения блоки уже прочитаны заранее
+    int window;                     // окно упреждения, блоков; 0 — выключено
+} ReadAhead;
+
+typedef struct {                    // sfs_cache.c
+    int shard_count;                // 0 — кэш отключён
+    int capacity;                   // кадров во всех сегментах
+    CacheShard *shards;
+    ReadAhead *readahead;           // по номеру inode
+    pthread_mutex_t readahead_lock;
+} BlockCache;
+
+// Смонтированный образ. Блокировки берутся в порядке
+// ns_lock -> inode_lock(i) -> index.lock -> alloc_lock -> meta_lock;
+// блокировки сегментов кэша, cache.readahead_lock, delay.lock, mcache.lock
+// и io.dirty_lock — листовые, под ними другие не берутся. Поток держит
+// не больше одной блокировки inode, поэтому их можно делить между inode.
+struct sfs {
+    FILE *disk;
+    Superblock superblock;
+    Layout layout;
+    unsigned char *block_bitmap;
+    DirectoryEntry *directory;      // форматы 1, 2: layout.dirent_count записей
+    char *dirent_area;              // directory[] в формате образа, в том числе имена
+    int current_directory_inode;
+    char current_directory[MAX_FILENAME_LENGTH];
+
+    int alloc_cursor;               // next-fit курсор аллокатора блоков
+    int reserved_blocks;            // зарезервировано под отложенные хвосты
+    int inode_cursor;
+    int dir_entry_cursor;
+
+    // Пространство имён (directory[], индекс, выделение inode, текущая
+    // директория) меняется под записью; операции с данными держат чтение,
+    // коммит группы — запись, поэтому в журнал не попадает половина операции
+    pthread_rwlock_t ns_lock;
+    pthread_rwlock_t inode_locks[INODE_LOCK_STRIPES];  // размер, карта экстентов и данные файла
+    pthread_mutex_t alloc_lock;     // битовая карта, free_blocks, alloc_cursor, резерв
+    pthread_mutex_t meta_lock;      // отметки изменённых метаданных
+
+    IoState io;
+    MetaState meta;
+    JournalState journal;
+    NameIndex index;
+    MetaCache mcache;
+    BlockCache cache;
+    DelayState delay;
+};
+
+// Образ и таблицы (sfs.c)
+int is_valid_filesystem(sfs_t *fs);
+void compute_layout(const Superblock *sb, Layout *l);
+void create_home_directory(sfs_t *fs);
+long get_block_offset(sfs_t *fs, int block_index);
+pthread_rwlock_t *inode_lock(sfs_t *fs, int inode);
+
+// Записи таблиц в формате образа (sfs_format.c)
+void inode_decode(const Layout *l, const void *raw, Inode *inode);
+void inode_encode(const Layout *l, const Inode *inode, void *raw);
+void dirents_decode(sfs_t *fs);
+int dirent_slots(sfs_t *fs, size_t name_length);
+const char *dirent_name(sfs_t *fs, int dir_entry_index);
+void dirent_set(sfs_t *fs, int dir_entry_index, int inode, const char *name);
+void dirent_clear(sfs_t *fs, int dir_entry_index);
+int dirblock_record(sfs_t *fs, const char *block, int offset, int *inode, const char **name, size_t *name_length);
+int dirblock_find_free(sfs_t *fs, const char *block, int slots);
+void dirblock_set(sfs_t *fs, char *block, int offset, int inode, const char *name, size_t name_length);
+int dirblock_clear(sfs_t *fs, char *block, int offset);
 
 // Вспомогательные функции
-int find_free_inode();
-int find_free_block();
-void allocate_block(int block_index);
-void free_block(int block_index);
-void print_current_directory();
-void build_path_from_inode(int inode, char *path, size_t path_size);
-int resolve_path_to_inode(const char *path, int *parent_inode_index, char *basename);
-void sfs_move_to_dir(const char *file_input, const char *dir_input);
-
-#endif
\ No newline at end of file
+int find_free_inode(sfs_t *fs);
+int find_free_dir_entry(sfs_t *fs, const char *name);
+int count_free_blocks(sfs_t *fs);
+int allocate_block(sfs_t *fs);
+int allocate_run(sfs_t *fs, int want, int *got, int reserved);
+int reserve_blocks(sfs_t *fs, int count);
+void release_blocks(sfs_t *fs, int count);
+int alloc_frees_pending(sfs_t *fs);
+void free_block(sfs_t *fs, int block_index);
+void build_path_from_inode(sfs_t *fs, int inode, char *path, size_t path_size);
+int resolve_path_to_inode(sfs_t *fs, const char *path, int *parent_inode_index, char *basename);
+int lookup_path(sfs_t *fs, const char *path);
+int delete_file(sfs_t *fs, const char *path);
+int check_new_path(const char *path);
+void get_parent_path_and_name(const char *full_path, char *parent_path, char *name);
+
+// Грязные метаданные и их сброс на диск (sfs_meta.c)
+long inode_offset(sfs_t *fs, int inode);
+long dirent_offset(sfs_t *fs, int dir_entry_index);
+int meta_init(sfs_t *fs);
+void meta_free(sfs_t *fs);
+void mark_superblock_dirty(sfs_t *fs);
+void mark_inode_dirty(sfs_t *fs, int inode);
+void mark_dirent_dirty(sfs_t *fs, int dir_entry_index);
+void mark_bitmap_dirty(sfs_t *fs, int block_index);
+void mark_bitmap_range_dirty(sfs_t *fs, int start, int count);
+void mark_block_revoked(sfs_t *fs, int block_index);
+int meta_add_region(sfs_t *fs, long offset, const void *data, size_t len);
+void meta_reset_dirty(sfs_t *fs);
+void meta_commit(sfs_t *fs);
+int meta_group_full(sfs_t *fs);
+void meta_commit_now(sfs_t *fs);
+void queue_discard(sfs_t *fs, int block);
+void op_begin(sfs_t *fs, int exclusive);
+void op_end(sfs_t *fs);
+
+// Карта блоков файла (sfs_extent.c)
+typedef struct {
+    Extent *items;
+    int count;
+    int capacity;
+} ExtentList;
+
+void extent_list_init(ExtentList *list);
+void extent_list_free(ExtentList *list);
+int extent_append(ExtentList *list, int start, int length);
+int inode_load_extents(sfs_t *fs, int inode, ExtentList *list);
+int inode_store_extents(sfs_t *fs, int inode, const ExtentList *list);
+void inode_take_blocks(sfs_t *fs, int inode, ExtentList *list);
+void inode_free_blocks(sfs_t *fs, int inode);
+void free_block_list(sfs_t *fs, ExtentList *list);  // sfs.c
+int inode_allocated_blocks(sfs_t *fs, int inode);
+
+// Доступ к образу (sfs_io.c)
+int io_attach(sfs_t *fs, int backend, int queue_depth);
+void io_detach(sfs_t *fs);
+int disk_read(sfs_t *fs, void *buf, size_t len, long offset);
+int disk_write(sfs_t *fs, const void *buf, size_t len, long offset);
+int disk_read_batch(sfs_t *fs, DiskRequest *reqs, int count);
+int disk_write_batch(sfs_t *fs, DiskRequest *reqs, int count);
+int disk_discard(sfs_t *fs, long offset, size_t len);
+void disk_sync_range(sfs_t *fs, long offset, size_t len);
+void disk_sync(sfs_t *fs);
+
+// Кольцо io_uring (sfs_uring.c)
+IoRing *uring_open(unsigned depth);
+void uring_close(IoRing *ring);
+unsigned uring_depth(IoRing *ring);
+int uring_submit_batch(sfs_t *fs, IoRing *ring, DiskRequest *reqs, int count, int write);
+
+// Кэш блоков данных (sfs_cache.c)
+int cache_init(sfs_t *fs, int blocks);
+void cache_get_stats(sfs_t *fs, CacheStats *stats);
+void cache_free(sfs_t *fs);
+int cache_read(sfs_t *fs, int block, long offset, void *buf, size_t len);
+int cache_write(sfs_t *fs, int block, long offset, const void *buf, size_t len);
+int cache_readahead(sfs_t *fs, int inode, long offset, size_t len, long *from, long *to);
+void cache_prefetch(sfs_t *fs, const DiskRequest *spans, int count, int ahead);
+int cache_read_spans(sfs_t *fs, DiskRequest *spans, int count);
+int cache_write_spans(sfs_t *fs, DiskRequest *spans, int count);
+void cache_discard(sfs_t *fs, int block, int count);
+void cache_flush(sfs_t *fs);
+
+// Отложенное выделение (sfs_delay.c)
+int delay_init(sfs_t *fs);
+void delay_free(sfs_t *fs);
+long file_size(sfs_t *fs, int inode);
+int delay_tail_blocks(sfs_t *fs, int inode);
+long delay_write(sfs_t *fs, int inode, const char *buf, size_t len, long offset);
+void delay_read(sfs_t *fs, int inode, char *buf, size_t len, long offset);
+void delay_truncate(sfs_t *fs, int inode, long size);
+void delay_drop(sfs_t *fs, int inode);
+int delay_commit(sfs_t *fs, int inode, int may_inline);
+int delay_pending(sfs_t *fs, int inode);
+void delay_flush(sfs_t *fs, int force);
+int delay_over_limit(sfs_t *fs);
+int delay_file_full(sfs_t *fs, int inode);
+
+// Журнал метаданных (sfs_journal.c)
+int journal_init(sfs_t *fs);
+void journal_free(sfs_t *fs);
+int journal_commit(sfs_t *fs, const MetaRegion *regions, int count);
+int journal_replay(sfs_t *fs);
+void journal_clear(sfs_t *fs);
+
+// Кэш метаданных: страницы inode и блоки директорий (sfs_mcache.c)
+int mcache_init(sfs_t *fs, int limit_kb);
+void mcache_free(sfs_t *fs);
+Inode *inode_get(sfs_t *fs, int inode);
+int inode_page_find_free(sfs_t *fs, int page, int from);
+void inode_collect_dirty(sfs_t *fs, int *list, int count);
+char *dirblock_get(sfs_t *fs, int block, int fresh);
+void dirblock_dirty(sfs_t *fs, int block, int offset, int len);
+void dirblock_release(sfs_t *fs, int block);
+void dirblock_collect_dirty(sfs_t *fs);
+void dirblock_reset_dirty(sfs_t *fs);
+long dirblock_dirty_bytes(sfs_t *fs);
+void mcache_account(sfs_t *fs, long bytes);
+int mcache_over_limit(sfs_t *fs);
+void mcache_trim(sfs_t *fs);
+
+// Индекс имён и списки детей директорий (sfs_index.c)
+int name_index_build(sfs_t *fs);
+void name_index_free(sfs_t *fs);
+int name_index_lookup(sfs_t *fs, int parent_inode, const char *name);
+const char *name_index_name(sfs_t *fs, int inode);
+int name_index_path(sfs_t *fs, int inode, char *path, size_t path_size);
+void name_index_trim(sfs_t *fs, long target);
+int dir_link(sfs_t *fs, int parent_inode, int inode, const char *name);
+void dir_unlink(sfs_t *fs, int inode);
+void dir_unlink_children(sfs_t *fs, int dir_inode);
+int dir_relink(sfs_t *fs, int inode, int new_parent);
+void dir_release_blocks(sfs_t *fs, int dir_inode);
+int dir_ready(sfs_t *fs, int dir_inode);
+int dir_first_child(sfs_t *fs, int dir_inode);
+int dir_next_child(sfs_t *fs, int inode);
+
+#endif
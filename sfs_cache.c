@@ -0,0 +1,508 @@
+#include "sfs.h"
+#include <stdlib.h>
+
+// Кэш блоков данных. Фиксированное число кадров размером в блок тома,
+// поиск по номеру блока через цепочечный хеш, вытеснение по алгоритму
+// CLOCK: стрелка обходит кадры и снимает бит обращения, вытесняется
+// первый кадр без него. Запись отложенная: изменённый кадр пишется в образ
+// при вытеснении, при cache_flush (перед коммитом журнала, чтобы данные
+// попадали в образ раньше ссылающихся на них метаданных) и при sfs_umount.
+// Через кэш идут все обращения к блокам по get_block_offset.
+// С нулевой ёмкостью кэш отключён и обращения идут прямо в образ.
+//
+// Кэш разбит на сегменты со своими кадрами, стрелкой CLOCK и мьютексом.
+// Блок попадает в сегмент по номеру группы из CACHE_MAX_RUN блоков, так что
+// чтение подряд идущих промахов не выходит за один сегмент, а потоки,
+// читающие разные файлы, обычно не встречаются на одной блокировке.
+//
+// С IO_URING промахи всего чтения (cache_read_spans) сначала собираются
+// в один пакет и читаются без блокировок, а затем ставятся в кэш;
+// cache_flush пишет изменённые кадры всех сегментов одним пакетом.
+//
+// Упреждающее чтение: для каждого файла помнится, где кончилось прошлое
+// чтение. Чтение с этого места считается продолжением потока, и окно
+// упреждения удваивается (от READAHEAD_MIN до READAHEAD_MAX блоков, но не
+// больше половины сегмента: поток подряд идущих блоков попадает в один
+// сегмент, и более широкое окно вытесняло бы само себя); чтение с другого
+// места уменьшает окно вдвое.
+// Следующие блоки файла читаются заранее тем же пакетом, что и промахи,
+// когда прочитанного вперёд остаётся меньше половины окна.
+
+#define CACHE_MAX_RUN 64  // блоков, читаемых одним обращением при промахе
+#define CACHE_SHARDS 8
+#define READAHEAD_MIN 4   // блоков
+#define READAHEAD_MAX 256
+
+// Почему кадр попал в кэш раньше первого обращения
+#define PREFETCH_NONE 0
+#define PREFETCH_BATCH 1  // промах пакетного чтения (IO_URING)
+#define PREFETCH_AHEAD 2  // упреждающее чтение
+
+typedef struct {
+    int block;        // номер блока или -1, если кадр свободен
+    int next;         // следующий кадр в корзине хеша
+    unsigned char referenced;
+    unsigned char dirty;
+    unsigned char prefetched;       // PREFETCH_*: поставлен заранее, обращений ещё не было
+} CacheFrame;
+
+struct CacheShard {
+    pthread_mutex_t lock;
+    int capacity;
+    CacheFrame *frames;
+    char *frame_data;               // capacity * block_size байт
+    int *bucket_head;
+    unsigned int bucket_mask;
+    int clock_hand;
+    char *run_buf;                  // буфер чтения подряд идущих промахов
+    CacheStats stats;
+};
+
+static char *frame_ptr(sfs_t *fs, CacheShard *c, int f) {
+    return c->frame_data + (size_t)f * fs->superblock.block_size;
+}
+
+static unsigned int block_hash(CacheShard *c, int block) {
+    unsigned int h = (unsigned int)block * 2654435761u;
+    return (h ^ (h >> 16)) & c->bucket_mask;
+}
+
+static CacheShard *shard_of(sfs_t *fs, int block) {
+    return &fs->cache.shards[(block / CACHE_MAX_RUN) % fs->cache.shard_count];
+}
+
+void cache_free(sfs_t *fs) {
+    BlockCache *cache = &fs->cache;
+    for (int i = 0; i < cache->shard_count; i++) {
+        CacheShard *c = &cache->shards[i];
+        free(c->frames);
+        free(c->frame_data);
+        free(c->bucket_head);
+        free(c->run_buf);
+        pthread_mutex_destroy(&c->lock);
+    }
+    free(cache->shards);
+    free(cache->readahead);
+    cache->shards = NULL;
+    cache->readahead = NULL;
+    cache->shard_count = 0;
+    cache->capacity = 0;
+}
+
+static int shard_init(sfs_t *fs, CacheShard *c, int blocks) {
+    unsigned int buckets = 1;
+    while (buckets < (unsigned int)blocks * 2) buckets <<= 1;
+    int run = blocks < CACHE_MAX_RUN ? blocks : CACHE_MAX_RUN;
+
+    pthread_mutex_init(&c->lock, NULL);
+    c->frames = malloc(sizeof(CacheFrame) * blocks);
+    c->frame_data = malloc((size_t)blocks * fs->superblock.block_size);
+    c->bucket_head = malloc(sizeof(int) * buckets);
+    c->run_buf = malloc((size_t)run * fs->superblock.block_size);
+    if (!c->frames || !c->frame_data || !c->bucket_head || !c->run_buf) {
+        return -1;
+    }
+
+    c->capacity = blocks;
+    c->bucket_mask = buckets - 1;
+    for (unsigned int i = 0; i < buckets; i++) {
+        c->bucket_head[i] = -1;
+    }
+    for (int f = 0; f < c->capacity; f++) {
+        c->frames[f].block = -1;
+        c->frames[f].next = -1;
+        c->frames[f].referenced = 0;
+        c->frames[f].dirty = 0;
+        c->frames[f].prefetched = PREFETCH_NONE;
+    }
+    return 0;
+}
+
+// Выделяет кэш на blocks блоков текущей геометрии; 0 — кэш отключён
+int cache_init(sfs_t *fs, int blocks) {
+    BlockCache *cache = &fs->cache;
+    cache_free(fs);
+    if (blocks <= 0) return 0;
+
+    int count = blocks < CACHE_SHARDS ? blocks : CACHE_SHARDS;
+    cache->shards = calloc(count, sizeof(CacheShard));
+    cache->readahead = calloc(fs->superblock.total_inodes, sizeof(ReadAhead));
+    if (!cache->shards || !cache->readahead) {
+        cache_free(fs);
+        return -1;
+    }
+    cache->shard_count = count;
+    cache->capacity = blocks;
+    for (int i = 0; i < count; i++) {
+        if (shard_init(fs, &cache->shards[i], blocks / count + (i < blocks % count)) != 0) {
+            cache_free(fs);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void cache_get_stats(sfs_t *fs, CacheStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < fs->cache.shard_count; i++) {
+        CacheShard *c = &fs->cache.shards[i];
+        pthread_mutex_lock(&c->lock);
+        stats->hits += c->stats.hits;
+        stats->misses += c->stats.misses;
+        stats->evictions += c->stats.evictions;
+        stats->writebacks += c->stats.writebacks;
+        stats->readahead += c->stats.readahead;
+        stats->readahead_hits += c->stats.readahead_hits;
+        stats->readahead_wasted += c->stats.readahead_wasted;
+        pthread_mutex_unlock(&c->lock);
+    }
+}
+
+static int cache_lookup(CacheShard *c, int block) {
+    for (int f = c->bucket_head[block_hash(c, block)]; f != -1; f = c->frames[f].next) {
+        if (c->frames[f].block == block) return f;
+    }
+    return -1;
+}
+
+static void cache_unlink(CacheShard *c, int f) {
+    int *link = &c->bucket_head[block_hash(c, c->frames[f].block)];
+    while (*link != f) link = &c->frames[*link].next;
+    *link = c->frames[f].next;
+    c->frames[f].next = -1;
+    c->frames[f].block = -1;
+}
+
+static void write_back(sfs_t *fs, CacheShard *c, int f) {
+    disk_write(fs, frame_ptr(fs, c, f), fs->superblock.block_size, get_block_offset(fs, c->frames[f].block));
+    c->frames[f].dirty = 0;
+    c->stats.writebacks++;
+}
+
+// Освобождает кадр по CLOCK и привязывает его к блоку; содержимое не заполняется
+static int cache_install(sfs_t *fs, CacheShard *c, int block) {
+    while (1) {
+        int f = c->clock_hand;
+        c->clock_hand = (c->clock_hand + 1) % c->capacity;
+        if (c->frames[f].block != -1 && c->frames[f].referenced) {
+            c->frames[f].referenced = 0;
+            continue;
+        }
+        if (c->frames[f].block != -1) {
+            if (c->frames[f].dirty) write_back(fs, c, f);
+            if (c->frames[f].prefetched == PREFETCH_AHEAD) c->stats.readahead_wasted++;
+            cache_unlink(c, f);
+            c->stats.evictions++;
+        }
+        unsigned int b = block_hash(c, block);
+        c->frames[f].block = block;
+        c->frames[f].next = c->bucket_head[b];
+        c->frames[f].referenced = 1;
+        c->frames[f].dirty = 0;
+        c->frames[f].prefetched = PREFETCH_NONE;
+        c->bucket_head[b] = f;
+        return f;
+    }
+}
+
+// Читает len байт начиная с байта in блока b; участок не выходит за группу
+static int shard_read(sfs_t *fs, CacheShard *c, int b, int in, char *out, size_t len) {
+    int bs = fs->superblock.block_size;
+    int last = b + (in + len - 1) / bs;
+    while (len > 0) {
+        int f = cache_lookup(c, b);
+        if (f != -1) {
+            // Блок, прочитанный пакетом промахов, при первом обращении
+            // считается промахом, прочитанный с упреждением — попаданием
+            if (c->frames[f].prefetched == PREFETCH_BATCH) {
+                c->stats.misses++;
+            } else {
+                c->stats.hits++;
+                if (c->frames[f].prefetched == PREFETCH_AHEAD) c->stats.readahead_hits++;
+            }
+            c->frames[f].prefetched = PREFETCH_NONE;
+            c->frames[f].referenced = 1;
+            size_t n = len < (size_t)(bs - in) ? len : (size_t)(bs - in);
+            memcpy(out, frame_ptr(fs, c, f) + in, n);
+            out += n;
+            len -= n;
+            b++;
+            in = 0;
+            continue;
+        }
+
+        int run = 1;
+        int max_run = c->capacity < CACHE_MAX_RUN ? c->capacity : CACHE_MAX_RUN;
+        while (run < max_run && b + run <= last && cache_lookup(c, b + run) == -1) run++;
+        if (disk_read(fs, c->run_buf, (size_t)run * bs, get_block_offset(fs, b)) != 0) return -1;
+
+        for (int i = 0; i < run; i++) {
+            c->stats.misses++;
+            f = cache_install(fs, c, b);
+            memcpy(frame_ptr(fs, c, f), c->run_buf + (size_t)i * bs, bs);
+            size_t n = len < (size_t)(bs - in) ? len : (size_t)(bs - in);
+            memcpy(out, c->run_buf + (size_t)i * bs + in, n);
+            out += n;
+            len -= n;
+            b++;
+            in = 0;
+        }
+    }
+    return 0;
+}
+
+// Записывает len байт начиная с байта in блока b; участок не выходит за группу
+static int shard_write(sfs_t *fs, CacheShard *c, int b, int in, const char *src, size_t len) {
+    int bs = fs->superblock.block_size;
+    while (len > 0) {
+        size_t n = len < (size_t)(bs - in) ? len : (size_t)(bs - in);
+        int f = cache_lookup(c, b);
+        if (f != -1) {
+            c->stats.hits++;
+            c->frames[f].prefetched = PREFETCH_NONE;
+        } else {
+            c->stats.misses++;
+            f = cache_install(fs, c, b);
+            if (n < (size_t)bs && disk_read(fs, frame_ptr(fs, c, f), bs, get_block_offset(fs, b)) != 0) {
+                cache_unlink(c, f);
+                return -1;
+            }
+        }
+        memcpy(frame_ptr(fs, c, f) + in, src, n);
+        c->frames[f].referenced = 1;
+        c->frames[f].dirty = 1;
+        src += n;
+        len -= n;
+        b++;
+        in = 0;
+    }
+    return 0;
+}
+
+// Разбивает участок на части по группам и выполняет каждую под блокировкой сегмента
+static int cache_access(sfs_t *fs, int block, long offset, char *buf, size_t len, int write) {
+    int bs = fs->superblock.block_size;
+    int b = block + offset / bs;
+    int in = offset % bs;
+
+    while (len > 0) {
+        long group_bytes = (long)(CACHE_MAX_RUN - b % CACHE_MAX_RUN) * bs - in;
+        size_t n = len < (size_t)group_bytes ? len : (size_t)group_bytes;
+
+        CacheShard *c = shard_of(fs, b);
+        pthread_mutex_lock(&c->lock);
+        int r = write ? shard_write(fs, c, b, in, buf, n) : shard_read(fs, c, b, in, buf, n);
+        pthread_mutex_unlock(&c->lock);
+        if (r != 0) return -1;
+
+        buf += n;
+        len -= n;
+        b += (in + n + bs - 1) / bs;
+        in = 0;
+    }
+    return 0;
+}
+
+// Читает len байт начиная с байта offset блока block (участок может
+// занимать несколько блоков подряд). Подряд идущие промахи читаются
+// из образа одним обращением.
+int cache_read(sfs_t *fs, int block, long offset, void *buf, size_t len) {
+    if (fs->cache.shard_count == 0) {
+        return disk_read(fs, buf, len, get_block_offset(fs, block) + offset);
+    }
+    return cache_access(fs, block, offset, buf, len, 0);
+}
+
+// Записывает len байт начиная с байта offset блока block. Целые блоки
+// не читаются из образа; изменённые кадры остаются в кэше до вытеснения.
+int cache_write(sfs_t *fs, int block, long offset, const void *buf, size_t len) {
+    if (fs->cache.shard_count == 0) {
+        return disk_write(fs, buf, len, get_block_offset(fs, block) + offset);
+    }
+    return cache_access(fs, block, offset, (char *)buf, len, 1);
+}
+
+// Ставит в кэш блоки участков, которых в нём нет: промахи читаются из
+// образа одним пакетом без блокировок сегментов. Вызывающий держит
+// блокировку inode на чтение, поэтому записать эти блоки, пока идёт
+// чтение, никто не может; если блок успели поставить другие читатели,
+// прочитанная копия отбрасывается. Объём ограничен половиной кэша.
+// ahead — блоки читаются с упреждением, а не по запросу.
+void cache_prefetch(sfs_t *fs, const DiskRequest *spans, int count, int ahead) {
+    int bs = fs->superblock.block_size;
+    int limit = fs->cache.capacity / 2;
+
+    // Промахи подряд в пределах группы — один запрос пакета
+    int max_runs = 0, blocks = 0;
+    DiskRequest *runs = NULL;
+    for (int i = 0; i < count && blocks < limit; i++) {
+        long rel = spans[i].offset - fs->layout.data_offset;
+        int first = rel / bs;
+        int last = (rel + spans[i].len - 1) / bs;
+        for (int b = first; b <= last && blocks < limit; b++) {
+            CacheShard *c = shard_of(fs, b);
+            pthread_mutex_lock(&c->lock);
+            int cached = cache_lookup(c, b) != -1;
+            pthread_mutex_unlock(&c->lock);
+            if (cached) continue;
+
+            DiskRequest *run = max_runs > 0 ? &runs[max_runs - 1] : NULL;
+            if (run && run->offset + (long)run->len == get_block_offset(fs, b) && b % CACHE_MAX_RUN != 0) {
+                run->len += bs;
+            } else {
+                DiskRequest *grown = realloc(runs, sizeof(DiskRequest) * (max_runs + 1));
+                if (!grown) break;
+                runs = grown;
+                runs[max_runs].buf = NULL;
+                runs[max_runs].len = bs;
+                runs[max_runs].offset = get_block_offset(fs, b);
+                max_runs++;
+            }
+            blocks++;
+        }
+    }
+
+    char *data = blocks > 0 ? malloc((size_t)blocks * bs) : NULL;
+    if (data) {
+        char *p = data;
+        for (int r = 0; r < max_runs; r++) {
+            runs[r].buf = p;
+            p += runs[r].len;
+        }
+        if (disk_read_batch(fs, runs, max_runs) == 0) {
+            for (int r = 0; r < max_runs; r++) {
+                int b = (runs[r].offset - fs->layout.data_offset) / bs;
+                CacheShard *c = shard_of(fs, b);
+                pthread_mutex_lock(&c->lock);
+                for (size_t k = 0; k < runs[r].len / bs; k++, b++) {
+                    if (cache_lookup(c, b) != -1) continue;
+                    int f = cache_install(fs, c, b);
+                    memcpy(frame_ptr(fs, c, f), runs[r].buf + k * bs, bs);
+                    c->frames[f].prefetched = ahead ? PREFETCH_AHEAD : PREFETCH_BATCH;
+                    if (ahead) c->stats.readahead++;
+                }
+                pthread_mutex_unlock(&c->lock);
+            }
+        }
+    }
+    free(data);
+    free(runs);
+}
+
+// Отмечает чтение [offset, offset + len) файла inode и выбирает байты
+// файла, которые стоит прочитать с упреждением: [*from, *to).
+// Возвращает 0, если читать заранее ничего не нужно.
+int cache_readahead(sfs_t *fs, int inode, long offset, size_t len, long *from, long *to) {
+    BlockCache *cache = &fs->cache;
+    if (cache->shard_count == 0) return 0;
+    long bs = fs->superblock.block_size;
+    int half_shard = cache->capacity / cache->shard_count / 2;
+    int max_window = half_shard < READAHEAD_MAX ? half_shard : READAHEAD_MAX;
+    if (max_window < READAHEAD_MIN) return 0;
+
+    long end = offset + len;
+    pthread_mutex_lock(&cache->readahead_lock);
+    ReadAhead *ra = &cache->readahead[inode];
+    if (offset == ra->next_offset) {
+        ra->window = ra->window == 0 ? READAHEAD_MIN : ra->window * 2;
+        if (ra->window > max_window) ra->window = max_window;
+    } else {
+        ra->window /= 2;
+        if (ra->window < READAHEAD_MIN) ra->window = 0;
+        ra->ahead = 0;
+    }
+    ra->next_offset = end;
+
+    int start = 0;
+    long window_bytes = ra->window * bs;
+    if (ra->window > 0 && ra->ahead - end < window_bytes / 2) {
+        *from = ra->ahead > end ? ra->ahead : end;
+        *to = end + window_bytes;
+        ra->ahead = *to;
+        start = 1;
+    }
+    pthread_mutex_unlock(&cache->readahead_lock);
+    return start;
+}
+
+// Переносит данные участков образа (смещения в области данных) через кэш.
+// Без кэша участки идут в образ одним пакетом disk_*_batch.
+int cache_read_spans(sfs_t *fs, DiskRequest *spans, int count) {
+    if (fs->cache.shard_count == 0) return disk_read_batch(fs, spans, count);
+    if (fs->io.backend == IO_URING) cache_prefetch(fs, spans, count, 0);
+    for (int i = 0; i < count; i++) {
+        long rel = spans[i].offset - fs->layout.data_offset;
+        if (cache_access(fs, 0, rel, spans[i].buf, spans[i].len, 0) != 0) return -1;
+    }
+    return 0;
+}
+
+int cache_write_spans(sfs_t *fs, DiskRequest *spans, int count) {
+    if (fs->cache.shard_count == 0) return disk_write_batch(fs, spans, count);
+    for (int i = 0; i < count; i++) {
+        long rel = spans[i].offset - fs->layout.data_offset;
+        if (cache_access(fs, 0, rel, spans[i].buf, spans[i].len, 1) != 0) return -1;
+    }
+    return 0;
+}
+
+// Забывает кадры блоков [block, block + count), не записывая их: блоки
+// получают новое содержимое мимо кэша
+void cache_discard(sfs_t *fs, int block, int count) {
+    for (int b = block; fs->cache.shard_count > 0 && b < block + count; b++) {
+        CacheShard *c = shard_of(fs, b);
+        pthread_mutex_lock(&c->lock);
+        int f = cache_lookup(c, b);
+        if (f != -1) {
+            c->frames[f].dirty = 0;
+            c->frames[f].prefetched = PREFETCH_NONE;
+            cache_unlink(c, f);
+        }
+        pthread_mutex_unlock(&c->lock);
+    }
+}
+
+static int cmp_request(const void *a, const void *b) {
+    long x = ((const DiskRequest *)a)->offset, y = ((const DiskRequest *)b)->offset;
+    return (x > y) - (x < y);
+}
+
+// Записывает в образ все изменённые кадры одним пакетом в порядке смещений.
+// Сегменты блокируются все сразу по порядку номеров; больше одного сегмента
+// одновременно нигде больше не держат.
+void cache_flush(sfs_t *fs) {
+    BlockCache *cache = &fs->cache;
+    int total = 0;
+    for (int i = 0; i < cache->shard_count; i++) {
+        pthread_mutex_lock(&cache->shards[i].lock);
+        total += cache->shards[i].capacity;
+    }
+
+    DiskRequest *reqs = malloc(sizeof(DiskRequest) * (total > 0 ? total : 1));
+    int count = 0;
+    for (int i = 0; i < cache->shard_count; i++) {
+        CacheShard *c = &cache->shards[i];
+        for (int f = 0; f < c->capacity; f++) {
+            if (c->frames[f].block == -1 || !c->frames[f].dirty) continue;
+            if (!reqs) {
+                write_back(fs, c, f);
+                continue;
+            }
+            reqs[count].buf = frame_ptr(fs, c, f);
+            reqs[count].len = fs->superblock.block_size;
+            reqs[count].offset = get_block_offset(fs, c->frames[f].block);
+            count++;
+            c->frames[f].dirty = 0;
+            c->stats.writebacks++;
+        }
+    }
+    if (reqs) {
+        qsort(reqs, count, sizeof(DiskRequest), cmp_request);
+        disk_write_batch(fs, reqs, count);
+        free(reqs);
+    }
+
+    for (int i = cache->shard_count - 1; i >= 0; i--) {
+        pthread_mutex_unlock(&cache->shards[i].lock);
+    }
+}
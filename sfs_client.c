@@ -0,0 +1,330 @@
+#include "sfs_client.h"
+#include "sfs_proto.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Запросы копятся в out и уходят пачкой перед ожиданием ответа. Пока
+// пачка отправляется, поступающие ответы вычитываются в in: иначе сервер,
+// отвечающий на начало длинного конвейера, и клиент, ещё отправляющий его
+// конец, заблокировались бы друг на друге.
+
+#define SEND_BATCH 65536
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Buffer;
+
+struct sfsc {
+    int fd;
+    int broken;                     // соединение оборвалось
+    uint32_t next_id;
+    int pending;                    // отправлено запросов без полученного ответа
+    Buffer out;                     // ещё не отправленные запросы
+    Buffer in;                      // полученные, но не разобранные ответы
+    size_t in_done;
+};
+
+static int buffer_reserve(Buffer *b, size_t extra) {
+    if (b->len + extra <= b->cap) return 0;
+    size_t cap = b->cap ? b->cap : SEND_BATCH;
+    while (cap < b->len + extra) cap *= 2;
+    char *data = realloc(b->data, cap);
+    if (!data) return -1;
+    b->data = data;
+    b->cap = cap;
+    return 0;
+}
+
+sfsc_t *sfsc_connect(const char *socket_path, int *err) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        if (err) *err = SFS_ERR_NAMETOOLONG;
+        return NULL;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        if (err) *err = SFS_ERR_IO;
+        return NULL;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        if (err) *err = (errno == ENOENT || errno == ECONNREFUSED) ? SFS_ERR_NOENT : SFS_ERR_IO;
+        close(fd);
+        return NULL;
+    }
+
+    sfsc_t *c = calloc(1, sizeof(sfsc_t));
+    if (!c) {
+        close(fd);
+        if (err) *err = SFS_ERR_NOMEM;
+        return NULL;
+    }
+    c->fd = fd;
+    if (err) *err = SFS_OK;
+    return c;
+}
+
+void sfsc_close(sfsc_t *c) {
+    if (!c) return;
+    close(c->fd);
+    free(c->out.data);
+    free(c->in.data);
+    free(c);
+}
+
+// Дочитывает из сокета то, что уже пришло или придёт
+static int receive_some(sfsc_t *c) {
+    if (c->in_done > 0) {
+        memmove(c->in.data, c->in.data + c->in_done, c->in.len - c->in_done);
+        c->in.len -= c->in_done;
+        c->in_done = 0;
+    }
+    if (buffer_reserve(&c->in, SEND_BATCH) != 0) return -1;
+    ssize_t n;
+    do {
+        n = recv(c->fd, c->in.data + c->in.len, c->in.cap - c->in.len, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return -1;
+    c->in.len += n;
+    return 0;
+}
+
+static int send_queued(sfsc_t *c) {
+    size_t sent = 0;
+    while (sent < c->out.len) {
+        struct pollfd p = {c->fd, POLLIN | POLLOUT, 0};
+        if (poll(&p, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if ((p.revents & POLLIN) && receive_some(c) != 0) return -1;
+        if (p.revents & POLLOUT) {
+            ssize_t n = send(c->fd, c->out.data + sent, c->out.len - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0 && errno != EAGAIN && errno != EINTR) return -1;
+            if (n > 0) sent += n;
+        }
+        if (p.revents & (POLLERR | POLLHUP)) return -1;
+    }
+    c->out.len = 0;
+    return 0;
+}
+
+static int queue_request(sfsc_t *c, int op, int inode, size_t count, long offset,
+                         const void *a, size_t a_len, const void *b, size_t b_len) {
+    if (c->broken) return SFS_ERR_IO;
+    ProtoRequest req;
+    memset(&req, 0, sizeof(req));
+    req.length = a_len + b_len;
+    req.id = c->next_id++;
+    req.op = op;
+    req.count = count;
+    req.inode = inode;
+    req.offset = offset;
+    if (buffer_reserve(&c->out, sizeof(req) + a_len + b_len) != 0) return SFS_ERR_NOMEM;
+    memcpy(c->out.data + c->out.len, &req, sizeof(req));
+    if (a_len) memcpy(c->out.data + c->out.len + sizeof(req), a, a_len);
+    if (b_len) memcpy(c->out.data + c->out.len + sizeof(req) + a_len, b, b_len);
+    c->out.len += sizeof(req) + a_len + b_len;
+    c->pending++;
+    if (c->out.len >= SEND_BATCH && send_queued(c) != 0) {
+        c->broken = 1;
+        return SFS_ERR_IO;
+    }
+    return SFS_OK;
+}
+
+// Ответ на самый ранний неполученный запрос; данные действительны до
+// следующего обращения к соединению
+static long next_response(sfsc_t *c, const char **payload, size_t *payload_len) {
+    if (c->broken) return SFS_ERR_IO;
+    if (c->pending == 0) return SFS_ERR_INVAL;
+
+    // Очередь отправляется, только когда нужного ответа ещё нет: пока
+    // разбираются уже полученные ответы, новые запросы копятся в пачку
+    ProtoResponse resp;
+    for (;;) {
+        size_t have = c->in.len - c->in_done;
+        if (have >= sizeof(resp)) {
+            memcpy(&resp, c->in.data + c->in_done, sizeof(resp));
+            if (have >= sizeof(resp) + resp.length) break;
+        }
+        if (c->out.len > 0) {
+            if (send_queued(c) != 0) {
+                c->broken = 1;
+                return SFS_ERR_IO;
+            }
+            continue;
+        }
+        if (receive_some(c) != 0) {
+            c->broken = 1;
+            return SFS_ERR_IO;
+        }
+    }
+    *payload = c->in.data + c->in_done + sizeof(resp);
+    *payload_len = resp.length;
+    c->in_done += sizeof(resp) + resp.length;
+    c->pending--;
+    return resp.result;
+}
+
+// Синхронный запрос: отправить и дождаться ответа
+static long call(sfsc_t *c, int op, int inode, size_t count, long offset,
+                 const void *a, size_t a_len, const void *b, size_t b_len,
+                 const char **payload, size_t *payload_len) {
+    if (c->pending > 0) return SFS_ERR_INVAL;
+    int err = queue_request(c, op, inode, count, offset, a, a_len, b, b_len);
+    if (err != SFS_OK) return err;
+    const char *p;
+    size_t len;
+    return next_response(c, payload ? payload : &p, payload_len ? payload_len : &len);
+}
+
+static long call_path(sfsc_t *c, int op, const char *path) {
+    return call(c, op, 0, 0, 0, path, strlen(path) + 1, NULL, 0, NULL, NULL);
+}
+
+int sfsc_lookup(sfsc_t *c, const char *path) { return call_path(c, OP_LOOKUP, path); }
+int sfsc_create(sfsc_t *c, const char *path) { return call_path(c, OP_CREATE, path); }
+int sfsc_create_dir(sfsc_t *c, const char *path) { return call_path(c, OP_MKDIR, path); }
+int sfsc_delete(sfsc_t *c, const char *path) { return call_path(c, OP_DELETE, path); }
+int sfsc_delete_dir(sfsc_t *c, const char *path) { return call_path(c, OP_RMDIR, path); }
+int sfsc_delete_dir_recursive(sfsc_t *c, const char *path) { return call_path(c, OP_RMTREE, path); }
+
+int sfsc_move_to_dir(sfsc_t *c, const char *path, const char *dir_path) {
+    return call(c, OP_MOVE, 0, 0, 0, path, strlen(path) + 1, dir_path, strlen(dir_path) + 1, NULL, NULL);
+}
+
+static void stat_from_wire(const ProtoStat *w, SfsStat *st) {
+    st->inode = w->inode;
+    st->is_directory = w->is_directory;
+    st->parent = w->parent;
+    st->size = w->size;
+    st->blocks = w->blocks;
+    st->is_inline = w->is_inline;
+}
+
+int sfsc_stat(sfsc_t *c, int inode, SfsStat *st) {
+    const char *payload;
+    size_t len;
+    long r = call(c, OP_STAT, inode, 0, 0, NULL, 0, NULL, 0, &payload, &len);
+    if (r == SFS_OK) {
+        if (len < sizeof(ProtoStat)) return SFS_ERR_IO;
+        ProtoStat w;
+        memcpy(&w, payload, sizeof(w));
+        stat_from_wire(&w, st);
+    }
+    return r;
+}
+
+int sfsc_list_dir(sfsc_t *c, const char *path, sfs_dir_fn fn, void *ctx) {
+    const char *payload;
+    size_t len;
+    if (!path) path = "";
+    long r = call(c, OP_LIST, 0, 0, 0, path, strlen(path) + 1, NULL, 0, &payload, &len);
+    if (r < 0) return r;
+
+    size_t pos = 0;
+    while (pos + sizeof(ProtoStat) <= len) {
+        ProtoStat w;
+        char name[MAX_FILENAME_LENGTH];
+        memcpy(&w, payload + pos, sizeof(w));
+        pos += sizeof(w);
+        if (pos + w.name_length > len) return SFS_ERR_IO;
+        memcpy(name, payload + pos, w.name_length);
+        name[w.name_length] = '\0';
+        pos += w.name_length;
+        SfsStat st;
+        stat_from_wire(&w, &st);
+        if (fn(ctx, name, &st) != 0) break;
+    }
+    return r;
+}
+
+// Данные больше PROTO_MAX_DATA передаются несколькими запросами
+long sfsc_pread(sfsc_t *c, int inode, void *buf, size_t len, long offset) {
+    size_t done = 0;
+    while (done < len) {
+        size_t n = len - done < PROTO_MAX_DATA ? len - done : PROTO_MAX_DATA;
+        const char *payload;
+        size_t got;
+        long r = call(c, OP_PREAD, inode, n, offset + done, NULL, 0, NULL, 0, &payload, &got);
+        if (r < 0) return done > 0 ? (long)done : r;
+        memcpy((char *)buf + done, payload, got);
+        done += got;
+        if (got < n) break;
+    }
+    return done;
+}
+
+static long write_chunks(sfsc_t *c, int op, int inode, const void *buf, size_t len, long offset) {
+    size_t done = 0;
+    while (done < len) {
+        size_t n = len - done < PROTO_MAX_DATA ? len - done : PROTO_MAX_DATA;
+        long r = call(c, op, inode, 0, offset + done, (const char *)buf + done, n, NULL, 0, NULL, NULL);
+        if (r < 0) return done > 0 ? (long)done : r;
+        done += r;
+        if ((size_t)r < n) break;
+    }
+    return done;
+}
+
+long sfsc_pwrite(sfsc_t *c, int inode, const void *buf, size_t len, long offset) {
+    return write_chunks(c, OP_PWRITE, inode, buf, len, offset);
+}
+
+long sfsc_append(sfsc_t *c, int inode, const void *buf, size_t len) {
+    return write_chunks(c, OP_APPEND, inode, buf, len, 0);
+}
+
+int sfsc_truncate(sfsc_t *c, int inode, long size) {
+    return call(c, OP_TRUNCATE, inode, 0, size, NULL, 0, NULL, 0, NULL, NULL);
+}
+
+int sfsc_flush(sfsc_t *c) {
+    return call(c, OP_FLUSH, 0, 0, 0, NULL, 0, NULL, 0, NULL, NULL);
+}
+
+int sfsc_get_stats(sfsc_t *c, SfsStats *stats) {
+    const char *payload;
+    size_t len;
+    long r = call(c, OP_STATS, 0, 0, 0, NULL, 0, NULL, 0, &payload, &len);
+    if (r == SFS_OK) {
+        if (len < sizeof(SfsStats)) return SFS_ERR_IO;
+        memcpy(stats, payload, sizeof(SfsStats));
+    }
+    return r;
+}
+
+int sfsc_send_pread(sfsc_t *c, int inode, size_t len, long offset) {
+    if (len > PROTO_MAX_DATA) return SFS_ERR_INVAL;
+    return queue_request(c, OP_PREAD, inode, len, offset, NULL, 0, NULL, 0);
+}
+
+int sfsc_send_pwrite(sfsc_t *c, int inode, const void *buf, size_t len, long offset) {
+    if (len > PROTO_MAX_DATA) return SFS_ERR_INVAL;
+    return queue_request(c, OP_PWRITE, inode, 0, offset, buf, len, NULL, 0);
+}
+
+int sfsc_send_create(sfsc_t *c, const char *path) {
+    return queue_request(c, OP_CREATE, 0, 0, 0, path, strlen(path) + 1, NULL, 0);
+}
+
+long sfsc_receive(sfsc_t *c, void *buf, size_t len) {
+    const char *payload;
+    size_t got;
+    long r = next_response(c, &payload, &got);
+    if (buf && got > 0 && r >= 0) {
+        memcpy(buf, payload, got < len ? got : len);
+    }
+    return r;
+}
@@ -0,0 +1,45 @@
+#ifndef SFS_CLIENT_H
+#define SFS_CLIENT_H
+
+#include "libsfs.h"
+
+// Клиент сервера libsfs (sfs_serve, sfs -S). Функции повторяют libsfs.h,
+// но работают через соединение с сервером, поэтому один образ могут
+// использовать сразу несколько процессов. Коды результата те же; обрыв
+// соединения — SFS_ERR_IO. Текущая директория у всех клиентов общая —
+// директория сервера, поэтому пути лучше указывать абсолютные.
+// Соединение не потокобезопасно: у каждого потока должно быть своё.
+
+#define SFS_DEFAULT_SOCKET "sfs.sock"
+
+typedef struct sfsc sfsc_t;
+
+sfsc_t *sfsc_connect(const char *socket_path, int *err);
+void sfsc_close(sfsc_t *c);
+
+int sfsc_lookup(sfsc_t *c, const char *path);
+int sfsc_stat(sfsc_t *c, int inode, SfsStat *st);
+int sfsc_create(sfsc_t *c, const char *path);
+int sfsc_create_dir(sfsc_t *c, const char *path);
+int sfsc_list_dir(sfsc_t *c, const char *path, sfs_dir_fn fn, void *ctx);
+int sfsc_delete(sfsc_t *c, const char *path);
+int sfsc_delete_dir(sfsc_t *c, const char *path);
+int sfsc_delete_dir_recursive(sfsc_t *c, const char *path);
+int sfsc_move_to_dir(sfsc_t *c, const char *path, const char *dir_path);
+long sfsc_pread(sfsc_t *c, int inode, void *buf, size_t len, long offset);
+long sfsc_pwrite(sfsc_t *c, int inode, const void *buf, size_t len, long offset);
+long sfsc_append(sfsc_t *c, int inode, const void *buf, size_t len);
+int sfsc_truncate(sfsc_t *c, int inode, long size);
+int sfsc_flush(sfsc_t *c);
+int sfsc_get_stats(sfsc_t *c, SfsStats *stats);
+
+// Конвейер: sfsc_send_* отправляют запрос, не дожидаясь ответа, а
+// sfsc_receive возвращает результат самого раннего неполученного запроса
+// (для чтения данные кладутся в buf). Пока есть неполученные ответы,
+// обычные функции выше возвращают SFS_ERR_INVAL.
+int sfsc_send_pread(sfsc_t *c, int inode, size_t len, long offset);
+int sfsc_send_pwrite(sfsc_t *c, int inode, const void *buf, size_t len, long offset);
+int sfsc_send_create(sfsc_t *c, const char *path);
+long sfsc_receive(sfsc_t *c, void *buf, size_t len);
+
+#endif
@@ -0,0 +1,305 @@
+#include "sfs.h"
+#include <stdlib.h>
+#include <time.h>
+
+// Отложенное выделение. Данные, которые пишутся за последним выделенным
+// блоком файла, копятся в памяти (хвост файла), а блоки под них только
+// резервируются: обычные выделения резерв не трогают, поэтому нехватка
+// места видна уже при записи. Место на диске выбирается, когда размер
+// хвоста окончателен: при sfs_flush и sfs_umount, при переполнении хвоста
+// файла (DELAY_FILE_MAX) или всех хвостов (DELAY_TOTAL_MAX), а хвосты
+// старше DELAY_EXPIRE_SEC — при ближайшем коммите группы. Хвост целиком
+// получает один участок и пишется в образ одним обращением на экстент,
+// минуя кэш. Хвост файла без блоков, умещающийся в layout.inline_max,
+// блоков не получает вовсе и сохраняется в самом inode.
+//
+// В inode хранится размер только выделенной части, так что журнал никогда
+// не ссылается на данные, которых ещё нет в образе; полный размер файла —
+// file_size(). Хвост меняется под блокировкой inode на запись, список
+// файлов с хвостами и счётчик байт — под delay.lock.
+
+#define DELAY_FILE_MAX (4 << 20)    // байт в хвосте одного файла
+#define DELAY_TOTAL_MAX (16 << 20)  // байт во всех хвостах
+#define DELAY_EXPIRE_SEC 5
+
+void delay_free(sfs_t *fs) {
+    DelayState *d = &fs->delay;
+    // Буферы есть только у файлов из списка: память таблицы хвостов,
+    // которой не касались, так и остаётся нетронутой
+    for (int i = 0; d->tails && i < d->count; i++) {
+        free(d->tails[d->inodes[i]].data);
+    }
+    free(d->tails);
+    free(d->inodes);
+    d->tails = NULL;
+    d->inodes = NULL;
+    d->count = 0;
+    d->bytes = 0;
+}
+
+int delay_init(sfs_t *fs) {
+    DelayState *d = &fs->delay;
+    delay_free(fs);
+    d->tails = calloc(fs->superblock.total_inodes, sizeof(DelayedTail));
+    d->inodes = malloc(sizeof(int) * fs->superblock.total_inodes);
+    if (!d->tails || !d->inodes) {
+        delay_free(fs);
+        return -1;
+    }
+    return 0;
+}
+
+// Полный размер файла с учётом отложенного хвоста
+long file_size(sfs_t *fs, int inode) {
+    DelayedTail *t = &fs->delay.tails[inode];
+    if (t->len == 0) return inode_get(fs, inode)->size;
+    return (long)inode_get(fs, inode)->block_count * fs->superblock.block_size + t->len;
+}
+
+// Блоков, которые хвост займёт в образе; короткий хвост файла без блоков
+// при коммите группы ляжет в inode и места не займёт
+int delay_tail_blocks(sfs_t *fs, int inode) {
+    DelayedTail *t = &fs->delay.tails[inode];
+    if (t->len == 0) return 0;
+    if (inode_get(fs, inode)->extent_count == 0 && t->len <= (size_t)fs->layout.inline_max) return 0;
+    int bs = fs->superblock.block_size;
+    return (t->len + bs - 1) / bs;
+}
+
+// Меняет длину хвоста, поддерживая список файлов с хвостами и общий счётчик
+static void set_tail_length(sfs_t *fs, int inode, size_t len) {
+    DelayState *d = &fs->delay;
+    DelayedTail *t = &d->tails[inode];
+    pthread_mutex_lock(&d->lock);
+    if (t->len == 0 && len > 0) {
+        t->slot = d->count;
+        t->since = time(NULL);
+        d->inodes[d->count++] = inode;
+    } else if (t->len > 0 && len == 0) {
+        int moved = d->inodes[--d->count];
+        d->inodes[t->slot] = moved;
+        d->tails[moved].slot = t->slot;
+    }
+    d->bytes += (long)len - (long)t->len;
+    pthread_mutex_unlock(&d->lock);
+    t->len = len;
+}
+
+// Освобождает хвост и его резерв
+void delay_drop(sfs_t *fs, int inode) {
+    DelayedTail *t = &fs->delay.tails[inode];
+    set_tail_length(fs, inode, 0);
+    release_blocks(fs, t->reserved);
+    free(t->data);
+    t->data = NULL;
+    t->cap = 0;
+    t->reserved = 0;
+}
+
+// Записывает len байт с позиции offset файла в хвост; offset не меньше
+// конца выделенных блоков. Промежуток от конца хвоста до offset заполняется
+// нулями. Возвращает число принятых байт (меньше len, если кончилось место)
+// или код ошибки.
+long delay_write(sfs_t *fs, int inode, const char *buf, size_t len, long offset) {
+    DelayedTail *t = &fs->delay.tails[inode];
+    int bs = fs->superblock.block_size;
+    size_t from = offset - (long)inode_get(fs, inode)->block_count * bs;
+    size_t end = from + len;
+
+    if (end > t->len) {
+        int need = (end + bs - 1) / bs - t->reserved;
+        if (need > 0) t->reserved += reserve_blocks(fs, need);
+        if (end > (size_t)t->reserved * bs) end = (size_t)t->reserved * bs;
+        if (end <= from) return 0;
+
+        // Буфер покрывает весь резерв, чтобы при записи дополнить блок нулями
+        size_t want = (size_t)t->reserved * bs;
+        if (want > t->cap) {
+            size_t cap = t->cap * 2 > want ? t->cap * 2 : want;
+            char *data = realloc(t->data, cap);
+            if (!data) return SFS_ERR_NOMEM;
+            t->data = data;
+            t->cap = cap;
+        }
+        if (from > t->len) memset(t->data + t->len, 0, from - t->len);
+        memcpy(t->data + from, buf, end - from);
+        set_tail_length(fs, inode, end);
+        return end - from;
+    }
+    memcpy(t->data + from, buf, len);
+    return len;
+}
+
+// Читает len байт хвоста с позиции offset файла; диапазон лежит в хвосте
+void delay_read(sfs_t *fs, int inode, char *buf, size_t len, long offset) {
+    DelayedTail *t = &fs->delay.tails[inode];
+    size_t from = offset - (long)inode_get(fs, inode)->block_count * fs->superblock.block_size;
+    memcpy(buf, t->data + from, len);
+}
+
+// Укорачивает хвост до полного размера size (не меньше выделенной части)
+void delay_truncate(sfs_t *fs, int inode, long size) {
+    DelayedTail *t = &fs->delay.tails[inode];
+    int bs = fs->superblock.block_size;
+    size_t len = size - (long)inode_get(fs, inode)->block_count * bs;
+    if (len >= t->len) return;
+    if (len == 0) {
+        // Файл кончается ровно на выделенных блоках
+        delay_drop(fs, inode);
+        inode_get(fs, inode)->size = size;
+        mark_inode_dirty(fs, inode);
+        return;
+    }
+    set_tail_length(fs, inode, len);
+    int keep = (len + bs - 1) / bs;
+    release_blocks(fs, t->reserved - keep);
+    t->reserved = keep;
+}
+
+// Доращивает карту файла до required_blocks блоков непрерывными участками
+// из резерва. Возвращает число блоков в карте; при неудаче — меньше запрошенного.
+static int extend_file(sfs_t *fs, int file_inode, ExtentList *map, int required_blocks) {
+    Inode *inode = inode_get(fs, file_inode);
+    int old_count = map->count;
+    int old_last_length = old_count > 0 ? map->items[old_count - 1].length : 0;
+    int have_blocks = inode->block_count;
+
+    while (have_blocks < required_blocks) {
+        int run_length;
+        int run_start = allocate_run(fs, required_blocks - have_blocks, &run_length, 1);
+        if (run_start == -1) {
+            break;
+        }
+        extent_append(map, run_start, run_length);
+        have_blocks += run_length;
+    }
+    if (have_blocks != inode->block_count && inode_store_extents(fs, file_inode, map) != 0) {
+        // Некуда записать продолжение карты — возвращаем блоки в резерв
+        int returned = 0;
+        for (int j = (old_count > 0 ? old_count - 1 : 0); j < map->count; j++) {
+            int from = (j == old_count - 1) ? old_last_length : 0;
+            for (int b = from; b < map->items[j].length; b++) {
+                free_block(fs, map->items[j].start + b);
+                returned++;
+            }
+        }
+        reserve_blocks(fs, returned);
+        map->count = old_count;
+        if (old_count > 0) map->items[old_count - 1].length = old_last_length;
+        have_blocks = inode->block_count;
+    }
+    return have_blocks;
+}
+
+// Выделяет блоки под хвост файла и пишет его в образ; при may_inline
+// короткий хвост файла без блоков вместо этого переносится в inode.
+// Вызывающий держит блокировку inode на запись или ns_lock на запись.
+int delay_commit(sfs_t *fs, int inode, int may_inline) {
+    DelayedTail *t = &fs->delay.tails[inode];
+    if (t->len == 0) return 0;
+    Inode *node = inode_get(fs, inode);
+    int bs = fs->superblock.block_size;
+    int old_blocks = node->block_count;
+
+    if (may_inline && node->extent_count == 0 && t->len <= (size_t)fs->layout.inline_max) {
+        memset(node->inline_data, 0, INODE_INLINE_MAX);
+        memcpy(node->inline_data, t->data, t->len);
+        node->size = t->len;
+        mark_inode_dirty(fs, inode);
+        delay_drop(fs, inode);
+        return 0;
+    }
+
+    ExtentList map;
+    if (inode_load_extents(fs, inode, &map) != 0) {
+        extent_list_free(&map);
+        return -1;
+    }
+    int got = extend_file(fs, inode, &map, old_blocks + (t->len + bs - 1) / bs) - old_blocks;
+    if (got <= 0) {
+        extent_list_free(&map);
+        return -1;
+    }
+    t->reserved -= got;
+
+    // Новые блоки: по участку на экстент, последний блок дополнен нулями
+    size_t covered = t->len < (size_t)got * bs ? t->len : (size_t)got * bs;
+    memset(t->data + covered, 0, (size_t)got * bs - covered);
+    DiskRequest *spans = malloc(sizeof(DiskRequest) * map.count);
+    if (!spans) {
+        extent_list_free(&map);
+        return -1;
+    }
+    int count = 0;
+    long skip = old_blocks;  // блоков карты до начала хвоста
+    size_t done = 0;
+    for (int j = 0; j < map.count; j++) {
+        int start = map.items[j].start;
+        int length = map.items[j].length;
+        if (skip >= length) {
+            skip -= length;
+            continue;
+        }
+        start += skip;
+        length -= skip;
+        skip = 0;
+        cache_discard(fs, start, length);
+        spans[count].buf = t->data + done;
+        spans[count].len = (size_t)length * bs;
+        spans[count].offset = get_block_offset(fs, start);
+        done += spans[count].len;
+        count++;
+    }
+    int r = disk_write_batch(fs, spans, count);
+    free(spans);
+    extent_list_free(&map);
+
+    node->size = (long)old_blocks * bs + covered;
+    mark_inode_dirty(fs, inode);
+
+    // Не уместившееся (только при нехватке места под карту) остаётся в хвосте
+    size_t rest = t->len - covered;
+    memmove(t->data, t->data + covered, rest);
+    if (rest == 0) {
+        delay_drop(fs, inode);
+    } else {
+        set_tail_length(fs, inode, rest);
+    }
+    return r;
+}
+
+// Пишет хвосты при коммите группы (ns_lock взят на запись): все при force,
+// иначе — устаревшие, а при переполнении общего предела тоже все. Каждый
+// записанный хвост оставляет образ согласованным, и если группа выросла
+// до предела журнала, она коммитится, не дожидаясь остальных хвостов.
+void delay_flush(sfs_t *fs, int force) {
+    DelayState *d = &fs->delay;
+    if (d->count == 0) return;
+    if (d->bytes > DELAY_TOTAL_MAX) force = 1;
+    time_t now = time(NULL);
+    for (int i = d->count - 1; i >= 0; i--) {
+        int inode = d->inodes[i];
+        if (force || now - d->tails[inode].since >= DELAY_EXPIRE_SEC) {
+            delay_commit(fs, inode, 1);
+            if (meta_group_full(fs)) meta_commit_now(fs);
+        }
+    }
+}
+
+// Есть ли у файла отложенный хвост
+int delay_pending(sfs_t *fs, int inode) {
+    return fs->delay.tails[inode].len > 0;
+}
+
+// Пора ли коммитить группу ради хвостов
+int delay_over_limit(sfs_t *fs) {
+    pthread_mutex_lock(&fs->delay.lock);
+    int over = fs->delay.bytes > DELAY_TOTAL_MAX;
+    pthread_mutex_unlock(&fs->delay.lock);
+    return over;
+}
+
+// Хвост файла слишком велик, чтобы держать его дальше
+int delay_file_full(sfs_t *fs, int inode) {
+    return fs->delay.tails[inode].len >= DELAY_FILE_MAX;
+}
@@ -1,149 +1,170 @@
 #include "sfs.h"
+#include <stdlib.h>
 
-void create_home_directory() {
+void create_home_directory(sfs_t *fs) {
     // Проверка существования /home
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index != -1 &&
-            strcmp(directory[i].filename, "home") == 0) {
-            return;
-        }
+    if (name_index_lookup(fs, 0, "home") != -1) {
+        return;
     }
 
     // Создание /home
-    int home_inode = find_free_inode();
+    int home_inode = find_free_inode(fs);
     if (home_inode == -1) return;
 
-    inode_table[home_inode].is_used = 1;
-    inode_table[home_inode].is_directory = 1;
-    inode_table[home_inode].directory_inode_index = 0;
-    strncpy(inode_table[home_inode].filename, "home", MAX_FILENAME_LENGTH);
-
-    for (int i = 1; i < MAX_FILES; i++) {
-        if (directory[i].inode_index == -1) {
-            directory[i].inode_index = home_inode;
-            strncpy(directory[i].filename, "home", MAX_FILENAME_LENGTH);
-            break;
-        }
+    Inode *home = inode_get(fs, home_inode);
+    home->is_used = 1;
+    home->is_directory = 1;
+    home->directory_inode_index = 0;
+    if (dir_link(fs, 0, home_inode, "home") != SFS_OK) {
+        memset(home, 0, sizeof(Inode));
+        return;
     }
 
-    superblock.free_inodes--;
-    current_directory_inode = home_inode;
-    strncpy(current_directory, "/home", MAX_FILENAME_LENGTH);
-    printf("Директория /home создана.\n");
+    fs->superblock.free_inodes--;
+    mark_inode_dirty(fs, home_inode);
+    mark_superblock_dirty(fs);
+    fs->current_directory_inode = home_inode;
+    strncpy(fs->current_directory, "/home", MAX_FILENAME_LENGTH);
 }
 
-void sfs_cd(const char *dirname) {
-    if (dirname == NULL || strlen(dirname) == 0) {
-        printf("Ошибка: путь не указан.\n");
-        return;
+// Номер inode по пути или SFS_ERR_NOENT
+int lookup_path(sfs_t *fs, const char *path) {
+    if (path == NULL || path[0] == '\0') {
+        return SFS_ERR_INVAL;
     }
-
-    char basename[MAX_FILENAME_LENGTH];
     int parent_inode;
-    int target_inode = resolve_path_to_inode(dirname, &parent_inode, basename);
+    char basename[MAX_FILENAME_LENGTH];
+    int inode = resolve_path_to_inode(fs, path, &parent_inode, basename);
+    return inode == -1 ? SFS_ERR_NOENT : inode;
+}
+
+static int stat_inode(sfs_t *fs, int inode, SfsStat *st) {
+    Inode *node = inode_get(fs, inode);
+    if (!node || !node->is_used) {
+        return SFS_ERR_NOENT;
+    }
+    st->inode = inode;
+    st->is_directory = node->is_directory;
+    st->parent = node->directory_inode_index;
+    st->size = file_size(fs, inode);
+    // Отложенный хвост уже занял место резервом — считаем и его блоки
+    st->blocks = inode_allocated_blocks(fs, inode) + delay_tail_blocks(fs, inode);
+    // Без экстентов и без блоков под хвост файл живёт в inode
+    st->is_inline = !node->is_directory && node->extent_count == 0 && st->blocks == 0;
+    return SFS_OK;
+}
+
+static int change_dir(sfs_t *fs, const char *dirname) {
+    int target_inode = lookup_path(fs, dirname);
 
     // Проверяем, что директория существует
-    if (target_inode == -1) {
-        printf("Директория '%s' не найдена.\n", dirname);
-        return;
+    if (target_inode < 0) {
+        return target_inode;
     }
 
     // Проверяем, что это действительно директория
-    if (!inode_table[target_inode].is_directory) {
-        printf("'%s' не является директорией.\n", dirname);
-        return;
+    if (!inode_get(fs, target_inode)->is_directory) {
+        return SFS_ERR_NOTDIR;
     }
 
     // Обновляем текущую директорию
-    current_directory_inode = target_inode;
+    fs->current_directory_inode = target_inode;
 
     // Обновляем строковое представление пути
     if (target_inode == 0) {
-        strcpy(current_directory, "/");
+        strcpy(fs->current_directory, "/");
     } else {
         // Строим полный путь по inode
-        build_path_from_inode(target_inode, current_directory, MAX_FILENAME_LENGTH);
+        build_path_from_inode(fs, target_inode, fs->current_directory, MAX_FILENAME_LENGTH);
     }
-
-    printf("Текущая директория: %s\n", current_directory);
+    return SFS_OK;
 }
 
-void sfs_create_dir(const char *path) {
+static int create_dir(sfs_t *fs, const char *path) {
     char parent_path[MAX_FILENAME_LENGTH * 2];
     char dirname[MAX_FILENAME_LENGTH];
 
+    int err = check_new_path(path);
+    if (err != SFS_OK) {
+        return err;
+    }
+
     get_parent_path_and_name(path, parent_path, dirname);
 
     int parent_inode_index;
     char dummy[MAX_FILENAME_LENGTH];
-    int parent_inode = resolve_path_to_inode(parent_path, &parent_inode_index, dummy);
+    int parent_inode = resolve_path_to_inode(fs, parent_path, &parent_inode_index, dummy);
 
     if (parent_inode == -1) {
-        printf("Родительский путь '%s' не найден.\n", parent_path);
-        return;
+        return SFS_ERR_NOENT;
+    }
+    if (!inode_get(fs, parent_inode)->is_directory) {
+        return SFS_ERR_NOTDIR;
     }
 
     // Проверка, существует ли уже такая директория
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index != -1 &&
-            inode_table[directory[i].inode_index].directory_inode_index == parent_inode &&
-            strcmp(directory[i].filename, dirname) == 0) {
-            printf("Директория '%s' уже существует.\n", path);
-            return;
-        }
+    if (name_index_lookup(fs, parent_inode, dirname) != -1) {
+        return SFS_ERR_EXIST;
     }
 
-    int inode_index = find_free_inode();
+    int inode_index = find_free_inode(fs);
     if (inode_index == -1) {
-        printf("Нет свободных inode.\n");
-        return;
+        return SFS_ERR_NOINODE;
     }
 
-    int block_index = find_free_block();
-    if (block_index == -1) {
-        printf("Нет свободных блоков.\n");
-        return;
+    // В форматах 1 и 2 директория по традиции получает блок сразу;
+    // в формате 3 блок появится с первой записью в ней
+    int block_index = -1;
+    if (fs->layout.format != SFS_FORMAT_V3) {
+        block_index = allocate_block(fs);
+        if (block_index == -1) {
+            return SFS_ERR_NOSPC;
+        }
     }
 
     // Создаём inode
-    Inode *inode = &inode_table[inode_index];
+    Inode *inode = inode_get(fs, inode_index);
     inode->is_used = 1;
     inode->is_directory = 1;
     inode->directory_inode_index = parent_inode;
     inode->size = 0;
-    inode->block_count = 1;
-    inode->blocks[0] = block_index;
-
-    // Запись в directory
-    int dir_entry_index = -1;
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index == -1) {
-            dir_entry_index = i;
-            break;
-        }
-    }
+    inode->block_count = block_index != -1;
+    inode->extent_count = block_index != -1;
+    inode->extents[0].start = block_index;
+    inode->extents[0].length = 1;
 
-    if (dir_entry_index == -1) {
-        printf("Нет места в каталоге.\n");
-        return;
+    // Запись в родительской директории
+    err = dir_link(fs, parent_inode, inode_index, dirname);
+    if (err != SFS_OK) {
+        memset(inode, 0, sizeof(Inode));
+        if (block_index != -1) free_block(fs, block_index);
+        return err;
     }
 
-    strncpy(directory[dir_entry_index].filename, dirname, MAX_FILENAME_LENGTH);
-    directory[dir_entry_index].inode_index = inode_index;
+    fs->superblock.free_inodes--;
 
-    superblock.free_inodes--;
-    allocate_block(block_index);
+    mark_inode_dirty(fs, inode_index);
+    mark_superblock_dirty(fs);
 
     // Сохраняем на диск
-    fseek(disk, 0, SEEK_SET);
-    fwrite(&superblock, sizeof(Superblock), 1, disk);
-    fseek(disk, sizeof(Superblock), SEEK_SET);
-    fwrite(inode_table, sizeof(Inode), MAX_FILES, disk);
-    fseek(disk, sizeof(Superblock) + sizeof(Inode) * MAX_FILES, SEEK_SET);
-    fwrite(directory, sizeof(DirectoryEntry), MAX_FILES, disk);
-    fflush(disk);
-
-    printf("Директория '%s' создана.\n", path);
+    meta_commit(fs);
+    return inode_index;
+}
+
+// Проверяет путь создаваемого элемента до разбора get_parent_path_and_name
+int check_new_path(const char *path) {
+    if (path == NULL || path[0] == '\0') {
+        return SFS_ERR_INVAL;
+    }
+    const char *slash = strrchr(path, '/');
+    const char *name = slash ? slash + 1 : path;
+    if (name[0] == '\0') {
+        return SFS_ERR_INVAL;
+    }
+    if (strlen(name) >= MAX_FILENAME_LENGTH || strlen(path) >= MAX_FILENAME_LENGTH * 2) {
+        return SFS_ERR_NAMETOOLONG;
+    }
+    return SFS_OK;
 }
 
 void get_parent_path_and_name(const char *full_path, char *parent_path, char *name) {
@@ -165,158 +186,105 @@ void get_parent_path_and_name(const char *full_path, char *parent_path, char *na
     }
 }
 
-void sfs_ls_dir(const char *dirname) {
-    // Определяем директорию для вывода содержимого
+// Вызывает fn для каждого элемента директории (NULL или "" — текущая).
+// Возвращает число просмотренных элементов.
+static int list_dir(sfs_t *fs, const char *dirname, sfs_dir_fn fn, void *ctx) {
+    // Определяем директорию для обхода
     int target_inode;
-    char basename[MAX_FILENAME_LENGTH];
-    int parent_inode;
-
     if (dirname == NULL || strlen(dirname) == 0) {
-        // Если путь не указан - используем текущую директорию
-        target_inode = current_directory_inode;
+        target_inode = fs->current_directory_inode;
     } else {
-        // Разрешаем переданный путь
-        target_inode = resolve_path_to_inode(dirname, &parent_inode, basename);
+        target_inode = lookup_path(fs, dirname);
     }
 
     // Проверяем, что объект существует
-    if (target_inode == -1) {
-        printf("'%s' не найдено.\n", dirname ? dirname : "текущий путь");
-        return;
+    if (target_inode < 0) {
+        return target_inode;
     }
 
     // Проверяем, что это директория (если не корень)
-    if (target_inode != 0 && !inode_table[target_inode].is_directory) {
-        printf("'%s' не является директорией.\n", dirname ? dirname : "текущий путь");
-        return;
-    }
-
-    // Получаем полное имя директории для вывода
-    char dir_path[MAX_FILENAME_LENGTH];
-    if (target_inode == 0) {
-        strcpy(dir_path, "/");
-    } else {
-        build_path_from_inode(target_inode, dir_path, MAX_FILENAME_LENGTH);
-    }
-
-    printf("Содержимое директории '%s':\n", dir_path);
-
-    // Выводим содержимое директории
-    int empty = 1;
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index != -1) {
-            // Для файлов и поддиректорий этой директории
-            if (inode_table[directory[i].inode_index].directory_inode_index == target_inode) {
-                printf("- %s", directory[i].filename);
-                if (inode_table[directory[i].inode_index].is_directory) {
-                    printf(" (директория)");
-                } else {
-                    printf(" (файл, размер: %d)", inode_table[directory[i].inode_index].size);
-                }
-                printf("\n");
-                empty = 0;
-            }
+    Inode *target = inode_get(fs, target_inode);
+    if (!target) {
+        return SFS_ERR_IO;
+    }
+    if (target_inode != 0 && !target->is_directory) {
+        return SFS_ERR_NOTDIR;
+    }
+
+    int count = 0;
+    for (int child = dir_first_child(fs, target_inode); child != -1; child = dir_next_child(fs, child)) {
+        // Размер файла меняется под блокировкой inode, не пространства имён
+        SfsStat st;
+        pthread_rwlock_rdlock(inode_lock(fs, child));
+        int r = stat_inode(fs, child, &st);
+        pthread_rwlock_unlock(inode_lock(fs, child));
+        if (r != SFS_OK) {
+            return SFS_ERR_IO;
+        }
+        count++;
+        if (fn(ctx, name_index_name(fs, child), &st) != 0) {
+            break;
         }
     }
-
-    if (empty) {
-        printf("Директория пуста.\n");
-    }
+    return count;
 }
 
-void sfs_delete_dir(const char *dirname) {
-    if (disk == NULL) {
-        fprintf(stderr, "Ошибка: файловая система не смонтирована.\n");
-        return;
-    }
-
-    if (dirname == NULL || strlen(dirname) == 0) {
-        printf("Ошибка: не указано имя директории.\n");
-        return;
-    }
-
+// Общие проверки перед удалением директории; возвращает её inode
+static int dir_for_delete(sfs_t *fs, const char *dirname) {
     // Разрешаем путь к директории
-    int parent_inode;
-    char basename[MAX_FILENAME_LENGTH];
-    int dir_inode = resolve_path_to_inode(dirname, &parent_inode, basename);
+    int dir_inode = lookup_path(fs, dirname);
 
     // Проверяем, что директория существует
-    if (dir_inode == -1) {
-        printf("Директория '%s' не найдена.\n", dirname);
-        return;
+    if (dir_inode < 0) {
+        return dir_inode;
     }
 
-    // Нельзя удалить корневую директорию
-    if (dir_inode == 0) {
-        printf("Ошибка: нельзя удалить корневую директорию.\n");
-        return;
+    // Нельзя удалить корневую и текущую директорию
+    if (dir_inode == 0 || dir_inode == fs->current_directory_inode) {
+        return SFS_ERR_BUSY;
     }
 
     // Проверяем, что это действительно директория
-    if (!inode_table[dir_inode].is_directory) {
-        printf("Ошибка: '%s' не является директорией.\n", dirname);
-        return;
+    if (!inode_get(fs, dir_inode)->is_directory) {
+        return SFS_ERR_NOTDIR;
     }
 
-    // Проверяем, не пытаемся ли удалить текущую директорию
-    if (dir_inode == current_directory_inode) {
-        printf("Ошибка: нельзя удалить текущую директорию.\n");
-        return;
-    }
-
-    // Проверяем, пуста ли директория
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index != -1 &&
-            inode_table[directory[i].inode_index].directory_inode_index == dir_inode) {
-            printf("Директория '%s' не пуста, невозможно удалить.\n", dirname);
-            return;
-        }
+    if (!name_index_name(fs, dir_inode)) {
+        return SFS_ERR_NOENT;
     }
+    return dir_inode;
+}
 
-    // Находим запись в directory для удаляемой директории
-    int dir_entry_index = -1;
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index == dir_inode) {
-            dir_entry_index = i;
-            break;
-        }
+static int delete_dir(sfs_t *fs, const char *dirname) {
+    int dir_inode = dir_for_delete(fs, dirname);
+    if (dir_inode < 0) {
+        return dir_inode;
     }
 
-    if (dir_entry_index == -1) {
-        printf("Ошибка: не найдена запись в директории.\n");
-        return;
+    // Проверяем, пуста ли директория
+    if (dir_first_child(fs, dir_inode) != -1) {
+        return SFS_ERR_NOTEMPTY;
     }
 
-    // Получаем полный путь для сообщения
-    char dir_path[MAX_FILENAME_LENGTH];
-    build_path_from_inode(dir_inode, dir_path, sizeof(dir_path));
+    // Удаляем запись из родительской директории
+    dir_unlink(fs, dir_inode);
 
-    // Освобождаем inode
-    inode_table[dir_inode].is_used = 0;
-    superblock.free_inodes++;
+    // Освобождаем блоки директории и inode
+    dir_release_blocks(fs, dir_inode);
+    inode_free_blocks(fs, dir_inode);
+    memset(inode_get(fs, dir_inode), 0, sizeof(Inode));
+    fs->superblock.free_inodes++;
 
-    // Удаляем запись из directory
-    directory[dir_entry_index].inode_index = -1;
-    memset(directory[dir_entry_index].filename, 0, MAX_FILENAME_LENGTH);
+    mark_inode_dirty(fs, dir_inode);
+    mark_superblock_dirty(fs);
 
     // Сохраняем изменения на диск
-    fseek(disk, 0, SEEK_SET);
-    fwrite(&superblock, sizeof(Superblock), 1, disk);
-
-    fseek(disk, sizeof(Superblock), SEEK_SET);
-    fwrite(inode_table, sizeof(Inode), MAX_FILES, disk);
-
-    fseek(disk, sizeof(Superblock) + sizeof(Inode) * MAX_FILES, SEEK_SET);
-    fwrite(directory, sizeof(DirectoryEntry), MAX_FILES, disk);
-
-    fflush(disk); // Гарантируем запись на диск
-
-    printf("Директория '%s' успешно удалена.\n", dir_path);
+    meta_commit(fs);
+    return SFS_OK;
 }
 
-int resolve_path_to_inode(const char *path, int *parent_inode_index, char *basename) {
+int resolve_path_to_inode(sfs_t *fs, const char *path, int *parent_inode_index, char *basename) {
     if (!path || !parent_inode_index || !basename) {
-        printf("[ERROR] Неверные аргументы resolve_path_to_inode.\n");
         return -1;
     }
 
@@ -327,7 +295,7 @@ int resolve_path_to_inode(const char *path, int *parent_inode_index, char *basen
 
     char *token;
     char *rest = temp_path;
-    int current_inode = (path[0] == '/') ? 0 : current_directory_inode;
+    int current_inode = (path[0] == '/') ? 0 : fs->current_directory_inode;
     *parent_inode_index = -1;
     char last_token[MAX_FILENAME_LENGTH] = "";
 
@@ -348,31 +316,26 @@ int resolve_path_to_inode(const char *path, int *parent_inode_index, char *basen
         // Обработка перехода в родительскую директорию
         if (strcmp(token, "..") == 0) {
             if (current_inode != 0) {  // Не выходим за пределы корня
-                *parent_inode_index = inode_table[current_inode].directory_inode_index;
+                Inode *node = inode_get(fs, current_inode);
+                if (!node) {
+                    return -1;
+                }
+                *parent_inode_index = node->directory_inode_index;
                 current_inode = *parent_inode_index;
             }
             continue;
         }
 
         // Поиск токена в текущей директории
-        int found = 0;
-        for (int i = 0; i < MAX_FILES; i++) {
-            if (directory[i].inode_index >= 0 &&
-                inode_table[directory[i].inode_index].directory_inode_index == current_inode &&
-                strncmp(directory[i].filename, token, MAX_FILENAME_LENGTH) == 0) {
-
-                *parent_inode_index = current_inode;
-                current_inode = directory[i].inode_index;
-                found = 1;
-                strncpy(last_token, token, MAX_FILENAME_LENGTH);
-                break;
-            }
-        }
-
-        if (!found) {
+        int inode = name_index_lookup(fs, current_inode, token);
+        if (inode == -1) {
             strncpy(basename, token, MAX_FILENAME_LENGTH);
             return -1;
         }
+
+        *parent_inode_index = current_inode;
+        current_inode = inode;
+        strncpy(last_token, token, MAX_FILENAME_LENGTH);
     }
 
     // Обработка случая, когда путь заканчивается слешем (например, "dir/")
@@ -385,165 +348,237 @@ int resolve_path_to_inode(const char *path, int *parent_inode_index, char *basen
     return current_inode;
 }
 
-void sfs_move_to_dir(const char *file_input, const char *dir_input) {
-    int file_parent_inode, dir_parent_inode;
-    char file_name[MAX_FILENAME_LENGTH];
-    char dir_name[MAX_FILENAME_LENGTH];
-
-    // Получаем inode файла и родительской директории
-    int file_inode_index = resolve_path_to_inode(file_input, &file_parent_inode, file_name);
-    if (file_inode_index == -1) {
-        printf("Файл '%s' не найден.\n", file_input);
-        return;
+static int move_to_dir(sfs_t *fs, const char *file_input, const char *dir_input) {
+    // Получаем inode файла
+    int file_inode_index = lookup_path(fs, file_input);
+    if (file_inode_index < 0) {
+        return file_inode_index;
     }
 
     // Получаем inode целевой директории
-    int dir_inode_index = resolve_path_to_inode(dir_input, &dir_parent_inode, dir_name);
-    if (dir_inode_index == -1 || !inode_table[dir_inode_index].is_directory) {
-        printf("Директория '%s' не найдена или это не директория.\n", dir_input);
-        return;
+    int dir_inode_index = lookup_path(fs, dir_input);
+    if (dir_inode_index < 0) {
+        return dir_inode_index;
     }
-
-    // Проверяем, нет ли файла с таким именем в целевой директории
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index >= 0 &&
-            inode_table[directory[i].inode_index].directory_inode_index == dir_inode_index &&
-            strcmp(directory[i].filename, file_name) == 0) {
-            printf("Файл с именем '%s' уже существует в директории '%s'.\n", file_name, dir_input);
-            return;
-        }
+    if (!inode_get(fs, dir_inode_index)->is_directory) {
+        return SFS_ERR_NOTDIR;
     }
 
-    // Удаляем запись из старой директории
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index == file_inode_index &&
-            inode_table[directory[i].inode_index].directory_inode_index == file_parent_inode) {
-            directory[i].inode_index = -1; // Помечаем как свободную запись
-            break;
+    // Директорию нельзя перенести в неё саму или в её поддерево: цепочка
+    // родителей от целевой директории до корня не должна её встретить
+    for (int up = dir_inode_index, steps = 0; up != 0 && steps < fs->superblock.total_inodes; steps++) {
+        if (up == file_inode_index) {
+            return SFS_ERR_INVAL;
         }
-    }
-
-    // Добавляем запись в новую директорию
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index == -1) { // Находим свободную запись
-            directory[i].inode_index = file_inode_index;
-            strncpy(directory[i].filename, file_name, MAX_FILENAME_LENGTH);
-            inode_table[file_inode_index].directory_inode_index = dir_inode_index;
-            break;
+        Inode *node = inode_get(fs, up);
+        if (!node) {
+            return SFS_ERR_IO;
         }
+        up = node->directory_inode_index;
     }
 
-    // Сохраняем изменения
-    fseek(disk, sizeof(Superblock) + sizeof(Inode) * MAX_FILES, SEEK_SET);
-    fwrite(directory, sizeof(DirectoryEntry), MAX_FILES, disk);
-
-    printf("Файл '%s' перемещён в '%s'.\n", file_input, dir_input);
-}
-
-// Рекурсивное удаление директории
-void sfs_delete_dir_recursive(const char *dirname) {
-    if (disk == NULL) {
-        fprintf(stderr, "Ошибка: файловая система не смонтирована.\n");
-        return;
+    const char *name = name_index_name(fs, file_inode_index);
+    if (!name) {
+        return SFS_ERR_NOENT;
     }
 
-    if (dirname == NULL || strlen(dirname) == 0) {
-        printf("Ошибка: не указано имя директории.\n");
-        return;
+    // Проверяем, нет ли файла с таким именем в целевой директории
+    if (name_index_lookup(fs, dir_inode_index, name) != -1) {
+        return SFS_ERR_EXIST;
     }
 
-    // Разрешаем путь к директории
-    int parent_inode;
-    char basename[MAX_FILENAME_LENGTH];
-    int dir_inode = resolve_path_to_inode(dirname, &parent_inode, basename);
-
-    // Проверяем, что директория существует
-    if (dir_inode == -1) {
-        printf("Директория '%s' не найдена.\n", dirname);
-        return;
+    // Переносим запись в новую директорию: имя сохраняется, меняется родитель
+    int err = dir_relink(fs, file_inode_index, dir_inode_index);
+    if (err != SFS_OK) {
+        return err;
     }
 
-    // Нельзя удалить корневую директорию
-    if (dir_inode == 0) {
-        printf("Ошибка: нельзя удалить корневую директорию.\n");
-        return;
-    }
+    // Сохраняем изменения
+    meta_commit(fs);
+    return SFS_OK;
+}
 
-    // Проверяем, что это действительно директория
-    if (!inode_table[dir_inode].is_directory) {
-        printf("Ошибка: '%s' не является директорией.\n", dirname);
-        return;
-    }
+// Освобождает inode удаляемого поддерева; его блоки добавляются в blocks
+static void release_inode(sfs_t *fs, int inode, ExtentList *blocks) {
+    delay_drop(fs, inode);
+    inode_take_blocks(fs, inode, blocks);
+    memset(inode_get(fs, inode), 0, sizeof(Inode));
+    mark_inode_dirty(fs, inode);
+}
 
-    // Проверяем, не пытаемся ли удалить текущую директорию
-    if (dir_inode == current_directory_inode) {
-        printf("Ошибка: нельзя удалить текущую директорию.\n");
-        return;
+// Убирает из директории записи уже освобождённых детей — всех до stop
+static void unlink_released(sfs_t *fs, int dir, int stop) {
+    for (int c = dir_first_child(fs, dir); c != -1 && c != stop;) {
+        int next = dir_next_child(fs, c);
+        dir_unlink(fs, c);
+        c = next;
     }
+}
 
-    // Получаем полный путь для сообщений
-    char dir_path[MAX_FILENAME_LENGTH];
-    build_path_from_inode(dir_inode, dir_path, sizeof(dir_path));
-
-    // Рекурсивно удаляем все содержимое директории
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index != -1 &&
-            inode_table[directory[i].inode_index].directory_inode_index == dir_inode) {
+// Коммит посреди большого удаления: освобождённое к этой точке уже убрано
+// из директорий, так что образ согласован — без удалённого поддерева
+static void delete_checkpoint(sfs_t *fs, ExtentList *blocks, int *released) {
+    free_block_list(fs, blocks);
+    blocks->count = 0;
+    fs->superblock.free_inodes += *released;
+    *released = 0;
+    mark_superblock_dirty(fs);
+    meta_commit_now(fs);
+}
 
-            // Для поддиректорий вызываем рекурсивное удаление
-            if (inode_table[directory[i].inode_index].is_directory) {
-                char subdir_path[MAX_FILENAME_LENGTH];
-                snprintf(subdir_path, MAX_FILENAME_LENGTH, "%s/%s", dir_path, directory[i].filename);
-                sfs_delete_dir_recursive(subdir_path);
+// Рекурсивное удаление директории по номерам inode, без разбора путей.
+// Сначала поддерево обходится целиком: читаются все его директории и
+// inode детей, и ошибка чтения прерывает удаление, ничего не изменив.
+// Затем директории разбираются в обратном порядке обхода — каждая после
+// всех своих поддиректорий. Блоки всех inode копятся в одном списке и
+// возвращаются в битовую карту одним проходом. Обычно вся операция — один
+// коммит; поддерево, изменения которого не уместились бы в журнал,
+// удаляется несколькими, каждый из которых оставляет дерево целым.
+static int delete_dir_recursive(sfs_t *fs, const char *dirname) {
+    int top = dir_for_delete(fs, dirname);
+    if (top < 0) {
+        return top;
+    }
+
+    // Директории поддерева в порядке обхода: родитель раньше детей
+    int count = 1, capacity = 64;
+    int *dirs = malloc(sizeof(int) * capacity);
+    if (!dirs) {
+        return SFS_ERR_NOMEM;
+    }
+    dirs[0] = top;
+    for (int i = 0; i < count; i++) {
+        if (!dir_ready(fs, dirs[i])) {
+            free(dirs);
+            return SFS_ERR_IO;
+        }
+        for (int c = dir_first_child(fs, dirs[i]); c != -1; c = dir_next_child(fs, c)) {
+            Inode *node = inode_get(fs, c);
+            if (!node) {
+                free(dirs);
+                return SFS_ERR_IO;
             }
-                // Для файлов вызываем обычное удаление
-            else {
-                sfs_delete(directory[i].filename);
+            if (!node->is_directory) continue;
+            if (c == fs->current_directory_inode) {
+                free(dirs);
+                return SFS_ERR_BUSY;
             }
+            if (count == capacity) {
+                capacity *= 2;
+                int *grown = realloc(dirs, sizeof(int) * capacity);
+                if (!grown) {
+                    free(dirs);
+                    return SFS_ERR_NOMEM;
+                }
+                dirs = grown;
+            }
+            dirs[count++] = c;
         }
     }
 
-    // Находим запись в directory для удаляемой директории
-    int dir_entry_index = -1;
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index == dir_inode) {
-            dir_entry_index = i;
-            break;
+    ExtentList blocks;
+    extent_list_init(&blocks);
+    int released = 0;
+    for (int i = count - 1; i >= 0; i--) {
+        int dir = dirs[i];
+        for (int c = dir_first_child(fs, dir); c != -1;) {
+            int next = dir_next_child(fs, c);
+            Inode *node = inode_get(fs, c);
+            if (node->is_used && !node->is_directory) {
+                release_inode(fs, c, &blocks);
+                released++;
+                if (meta_group_full(fs)) {
+                    unlink_released(fs, dir, next);
+                    delete_checkpoint(fs, &blocks, &released);
+                }
+            }
+            c = next;
+        }
+        // Поддиректории уже убраны из неё; записи файлов уходят разом.
+        // Сама директория сразу уходит из родителя: коммит может случиться
+        // раньше, чем до родителя дойдёт очередь
+        dir_unlink_children(fs, dir);
+        dir_unlink(fs, dir);
+        dir_release_blocks(fs, dir);
+        release_inode(fs, dir, &blocks);
+        released++;
+        if (meta_group_full(fs)) {
+            delete_checkpoint(fs, &blocks, &released);
         }
     }
+    free(dirs);
 
-    if (dir_entry_index == -1) {
-        printf("Ошибка: не найдена запись в директории.\n");
-        return;
-    }
+    free_block_list(fs, &blocks);
+    extent_list_free(&blocks);
+    fs->superblock.free_inodes += released;
+    mark_superblock_dirty(fs);
 
-    // Освобождаем блоки директории (если они есть)
-    for (int i = 0; i < inode_table[dir_inode].block_count; i++) {
-        int block_index = inode_table[dir_inode].blocks[i];
-        if (block_index >= 0 && block_index < MAX_BLOCKS) {
-            free_block(block_index);
-        }
-    }
+    // Сохраняем изменения на диск
+    meta_commit(fs);
+    return SFS_OK;
+}
 
-    // Освобождаем inode
-    inode_table[dir_inode].is_used = 0;
-    superblock.free_inodes++;
+// Внешний интерфейс: операции выше не берут блокировок и вызывают друг
+// друга; здесь каждая обёрнута в op_begin/op_end. Изменения пространства
+// имён исключают все остальные операции, чтение — только изменения.
 
-    // Удаляем запись из directory
-    directory[dir_entry_index].inode_index = -1;
-    memset(directory[dir_entry_index].filename, 0, MAX_FILENAME_LENGTH);
+int sfs_lookup(sfs_t *fs, const char *path) {
+    op_begin(fs, 0);
+    int r = lookup_path(fs, path);
+    op_end(fs);
+    return r;
+}
 
-    // Сохраняем изменения на диск
-    fseek(disk, 0, SEEK_SET);
-    fwrite(&superblock, sizeof(Superblock), 1, disk);
+int sfs_stat(sfs_t *fs, int inode, SfsStat *st) {
+    op_begin(fs, 0);
+    int r = SFS_ERR_NOENT;
+    if (inode >= 0 && inode < fs->superblock.total_inodes) {
+        pthread_rwlock_rdlock(inode_lock(fs, inode));
+        r = inode_get(fs, inode) ? stat_inode(fs, inode, st) : SFS_ERR_IO;
+        pthread_rwlock_unlock(inode_lock(fs, inode));
+    }
+    op_end(fs);
+    return r;
+}
 
-    fseek(disk, sizeof(Superblock), SEEK_SET);
-    fwrite(inode_table, sizeof(Inode), MAX_FILES, disk);
+int sfs_cd(sfs_t *fs, const char *dirname) {
+    op_begin(fs, 1);
+    int r = change_dir(fs, dirname);
+    op_end(fs);
+    return r;
+}
+
+int sfs_create_dir(sfs_t *fs, const char *path) {
+    op_begin(fs, 1);
+    int r = create_dir(fs, path);
+    op_end(fs);
+    return r;
+}
+
+int sfs_list_dir(sfs_t *fs, const char *dirname, sfs_dir_fn fn, void *ctx) {
+    op_begin(fs, 0);
+    int r = list_dir(fs, dirname, fn, ctx);
+    op_end(fs);
+    return r;
+}
 
-    fseek(disk, sizeof(Superblock) + sizeof(Inode) * MAX_FILES, SEEK_SET);
-    fwrite(directory, sizeof(DirectoryEntry), MAX_FILES, disk);
+int sfs_delete_dir(sfs_t *fs, const char *dirname) {
+    op_begin(fs, 1);
+    int r = delete_dir(fs, dirname);
+    op_end(fs);
+    return r;
+}
 
-    fflush(disk); // Гарантируем запись на диск
+int sfs_move_to_dir(sfs_t *fs, const char *file_input, const char *dir_input) {
+    op_begin(fs, 1);
+    int r = move_to_dir(fs, file_input, dir_input);
+    op_end(fs);
+    return r;
+}
 
-    printf("Директория '%s' и все её содержимое успешно удалены.\n", dir_path);
-}
\ No newline at end of file
+int sfs_delete_dir_recursive(sfs_t *fs, const char *dirname) {
+    op_begin(fs, 1);
+    int r = delete_dir_recursive(fs, dirname);
+    op_end(fs);
+    return r;
+}
@@ -0,0 +1,219 @@
+#include "sfs.h"
+#include <stdlib.h>
+
+// Карта блоков файла в виде экстентов (начальный блок, длина).
+// Первые layout.inode_extents экстентов хранятся в самом inode, остальные — в цепочке
+// блоков продолжения (ExtentBlock), на первый из которых указывает extent_block.
+// Экстент с началом HOLE_BLOCK — дыра: логические блоки файла без места в томе.
+// Цепочка перезаписывается копированием: новые блоки пишутся до коммита inode,
+// старые освобождаются в той же группе, поэтому журнал видит атомарную замену.
+
+// Блок цепочки: заголовок и столько экстентов, сколько влезает в блок тома
+typedef struct {
+    int32_t next;   // следующий блок цепочки или -1
+    int32_t count;  // экстентов в этом блоке
+    Extent extents[];
+} ExtentBlock;
+
+static int extents_per_block(sfs_t *fs) {
+    return (fs->superblock.block_size - (int)sizeof(ExtentBlock)) / (int)sizeof(Extent);
+}
+
+static ExtentBlock *read_extent_block(sfs_t *fs, int block, ExtentBlock *eb) {
+    if (cache_read(fs, block, 0, eb, fs->superblock.block_size) != 0) return NULL;
+    if (eb->count < 0 || eb->count > extents_per_block(fs)) return NULL;
+    return eb;
+}
+
+void extent_list_init(ExtentList *list) {
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+void extent_list_free(ExtentList *list) {
+    free(list->items);
+    extent_list_init(list);
+}
+
+// Добавляет блоки в конец карты, склеивая с последним экстентом, если они
+// продолжают его; дыры склеиваются с дырами
+int extent_append(ExtentList *list, int start, int length) {
+    if (list->count > 0) {
+        Extent *last = &list->items[list->count - 1];
+        int hole = start == HOLE_BLOCK;
+        if (hole ? last->start == HOLE_BLOCK
+                 : last->start != HOLE_BLOCK && last->start + last->length == start) {
+            last->length += length;
+            return 0;
+        }
+    }
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : INODE_EXTENTS * 2;
+        Extent *items = realloc(list->items, sizeof(Extent) * capacity);
+        if (!items) return -1;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count].start = start;
+    list->items[list->count].length = length;
+    list->count++;
+    return 0;
+}
+
+int inode_load_extents(sfs_t *fs, int inode, ExtentList *list) {
+    Inode *node = inode_get(fs, inode);
+    extent_list_init(list);
+
+    int in_inode = fs->layout.inode_extents;
+    int inline_count = node->extent_count < in_inode ? node->extent_count : in_inode;
+    for (int i = 0; i < inline_count; i++) {
+        if (extent_append(list, node->extents[i].start, node->extents[i].length) != 0) return -1;
+    }
+
+    if (node->extent_count > in_inode) {
+        ExtentBlock *eb = malloc(fs->superblock.block_size);
+        if (!eb) return -1;
+        for (int b = node->extent_block; b != -1; b = eb->next) {
+            if (!read_extent_block(fs, b, eb)) {
+                free(eb);
+                return -1;
+            }
+            for (int i = 0; i < eb->count; i++) {
+                if (extent_append(list, eb->extents[i].start, eb->extents[i].length) != 0) {
+                    free(eb);
+                    return -1;
+                }
+            }
+        }
+        free(eb);
+    }
+    return 0;
+}
+
+// Освобождает блоки цепочки продолжения inode
+static void free_extent_chain(sfs_t *fs, int inode) {
+    Inode *node = inode_get(fs, inode);
+    if (node->extent_count <= fs->layout.inode_extents) return;
+
+    ExtentBlock *eb = malloc(fs->superblock.block_size);
+    if (!eb) return;
+    for (int b = node->extent_block; b != -1; b = eb->next) {
+        if (!read_extent_block(fs, b, eb)) break;
+        free_block(fs, b);
+    }
+    free(eb);
+}
+
+// Сохраняет карту в inode; хвост, не влезший в inode, пишется в новую цепочку блоков
+int inode_store_extents(sfs_t *fs, int inode, const ExtentList *list) {
+    Inode *node = inode_get(fs, inode);
+
+    int per_block = extents_per_block(fs);
+    int in_inode = fs->layout.inode_extents;
+    int spill = list->count - in_inode;
+    int chain_length = spill > 0 ? (spill + per_block - 1) / per_block : 0;
+    int *chain = malloc(sizeof(int) * (chain_length > 0 ? chain_length : 1));
+    ExtentBlock *eb = calloc(1, fs->superblock.block_size);
+    if (!chain || !eb) {
+        free(chain);
+        free(eb);
+        return -1;
+    }
+
+    // Новые блоки цепочки выделяются до освобождения старых, чтобы не пересечься с ними
+    for (int c = 0; c < chain_length; c++) {
+        chain[c] = allocate_block(fs);
+        if (chain[c] == -1) {
+            for (int k = 0; k < c; k++) free_block(fs, chain[k]);
+            free(chain);
+            free(eb);
+            return -1;
+        }
+    }
+
+    for (int c = 0; c < chain_length; c++) {
+        memset(eb, 0, fs->superblock.block_size);
+        eb->next = c + 1 < chain_length ? chain[c + 1] : -1;
+        int first = in_inode + c * per_block;
+        eb->count = list->count - first < per_block ? list->count - first : per_block;
+        memcpy(eb->extents, list->items + first, sizeof(Extent) * eb->count);
+        cache_write(fs, chain[c], 0, eb, fs->superblock.block_size);
+    }
+
+    free_extent_chain(fs, inode);
+
+    int inline_count = list->count < in_inode ? list->count : in_inode;
+    memcpy(node->extents, list->items, sizeof(Extent) * inline_count);
+    node->extent_count = list->count;
+    node->extent_block = chain_length > 0 ? chain[0] : -1;
+    free(chain);
+    free(eb);
+
+    node->block_count = 0;
+    for (int i = 0; i < list->count; i++) {
+        node->block_count += list->items[i].length;
+    }
+
+    mark_inode_dirty(fs, inode);
+    return 0;
+}
+
+// Добавляет в list все блоки inode — данные и цепочку продолжения — и
+// обнуляет его карту. Освобождать их вызывающему (free_block_list): так
+// блоки многих inode возвращаются в битовую карту за один проход.
+void inode_take_blocks(sfs_t *fs, int inode, ExtentList *list) {
+    Inode *node = inode_get(fs, inode);
+    int in_inode = fs->layout.inode_extents;
+    int inline_count = node->extent_count < in_inode ? node->extent_count : in_inode;
+    for (int i = 0; i < inline_count; i++) {
+        if (node->extents[i].start != HOLE_BLOCK) {
+            extent_append(list, node->extents[i].start, node->extents[i].length);
+        }
+    }
+    if (node->extent_count > in_inode) {
+        ExtentBlock *eb = malloc(fs->superblock.block_size);
+        for (int b = node->extent_block; eb && b != -1; b = eb->next) {
+            if (!read_extent_block(fs, b, eb)) break;
+            extent_append(list, b, 1);
+            for (int i = 0; i < eb->count; i++) {
+                if (eb->extents[i].start != HOLE_BLOCK) {
+                    extent_append(list, eb->extents[i].start, eb->extents[i].length);
+                }
+            }
+        }
+        free(eb);
+    }
+    node->extent_count = 0;
+    node->block_count = 0;
+    mark_inode_dirty(fs, inode);
+}
+
+// Освобождает все блоки данных и цепочку экстентов inode
+void inode_free_blocks(sfs_t *fs, int inode) {
+    ExtentList list;
+    extent_list_init(&list);
+    inode_take_blocks(fs, inode, &list);
+    free_block_list(fs, &list);
+    extent_list_free(&list);
+}
+
+// Число блоков тома, занятых данными файла (без дыр и отложенного хвоста)
+int inode_allocated_blocks(sfs_t *fs, int inode) {
+    Inode *node = inode_get(fs, inode);
+    int blocks = 0;
+    if (node->extent_count <= fs->layout.inode_extents) {
+        for (int i = 0; i < node->extent_count; i++) {
+            if (node->extents[i].start != HOLE_BLOCK) blocks += node->extents[i].length;
+        }
+        return blocks;
+    }
+    ExtentList list;
+    if (inode_load_extents(fs, inode, &list) == 0) {
+        for (int i = 0; i < list.count; i++) {
+            if (list.items[i].start != HOLE_BLOCK) blocks += list.items[i].length;
+        }
+    }
+    extent_list_free(&list);
+    return blocks;
+}
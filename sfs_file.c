@@ -1,258 +1,579 @@
 #include "sfs.h"
+#include <limits.h>
+#include <stdlib.h>
 
-char data[BLOCK_SIZE * 15];
-
-void sfs_create(const char *path) {
+// Создаёт пустой файл; возвращает его inode
+static int create_file(sfs_t *fs, const char *path) {
     char parent_path[MAX_FILENAME_LENGTH * 2];
     char filename[MAX_FILENAME_LENGTH];
 
-    get_parent_path_and_name(path, parent_path, filename);
-
-    if (strlen(filename) >= MAX_FILENAME_LENGTH) {
-        printf("Слишком длинное имя файла.\n");
-        return;
+    int err = check_new_path(path);
+    if (err != SFS_OK) {
+        return err;
     }
 
+    get_parent_path_and_name(path, parent_path, filename);
+
     int parent_inode_index;
     char dummy[MAX_FILENAME_LENGTH];
-    int parent_inode = resolve_path_to_inode(parent_path, &parent_inode_index, dummy);
+    int parent_inode = resolve_path_to_inode(fs, parent_path, &parent_inode_index, dummy);
 
     if (parent_inode == -1) {
-        printf("Родительский путь '%s' не найден.\n", parent_path);
-        return;
+        return SFS_ERR_NOENT;
+    }
+    if (!inode_get(fs, parent_inode)->is_directory) {
+        return SFS_ERR_NOTDIR;
     }
 
     // Проверка существования файла
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index != -1 &&
-            inode_table[directory[i].inode_index].directory_inode_index == parent_inode &&
-            strcmp(directory[i].filename, filename) == 0) {
-            printf("Файл '%s' уже существует.\n", path);
-            return;
-        }
+    if (name_index_lookup(fs, parent_inode, filename) != -1) {
+        return SFS_ERR_EXIST;
     }
 
     // Создание файла
-    int inode_index = find_free_inode();
+    int inode_index = find_free_inode(fs);
     if (inode_index == -1) {
-        printf("Нет свободных inode.\n");
-        return;
-    }
-
-    int block_index = find_free_block();
-    if (block_index == -1) {
-        printf("Нет свободных блоков.\n");
-        return;
-    }
-
-    int dir_entry_index = -1;
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index == -1) {
-            dir_entry_index = i;
-            break;
-        }
+        return SFS_ERR_NOINODE;
     }
 
-    if (dir_entry_index == -1) {
-        printf("Нет места в директории.\n");
-        return;
+    // Заполнение структур; блоки файл получит при сбросе отложенного хвоста
+    Inode *inode = inode_get(fs, inode_index);
+    memset(inode, 0, sizeof(Inode));
+    inode->is_used = 1;
+    inode->is_directory = 0;
+    inode->directory_inode_index = parent_inode;
+
+    err = dir_link(fs, parent_inode, inode_index, filename);
+    if (err != SFS_OK) {
+        memset(inode, 0, sizeof(Inode));
+        return err;
     }
 
-    // Заполнение структур
-    inode_table[inode_index].is_used = 1;
-    inode_table[inode_index].is_directory = 0;
-    inode_table[inode_index].directory_inode_index = parent_inode;
-    strncpy(inode_table[inode_index].filename, filename, MAX_FILENAME_LENGTH);
-    inode_table[inode_index].size = 0;
-    inode_table[inode_index].block_count = 1;
-    inode_table[inode_index].blocks[0] = block_index;
+    fs->superblock.free_inodes--;
 
-    directory[dir_entry_index].inode_index = inode_index;
-    strncpy(directory[dir_entry_index].filename, filename, MAX_FILENAME_LENGTH);
-
-    superblock.free_inodes--;
-    allocate_block(block_index);
+    mark_inode_dirty(fs, inode_index);
+    mark_superblock_dirty(fs);
 
     // Сохраняем на диск
-    fseek(disk, 0, SEEK_SET);
-    fwrite(&superblock, sizeof(Superblock), 1, disk);
-    fseek(disk, sizeof(Superblock), SEEK_SET);
-    fwrite(inode_table, sizeof(Inode), MAX_FILES, disk);
-    fseek(disk, sizeof(Superblock) + sizeof(Inode) * MAX_FILES, SEEK_SET);
-    fwrite(directory, sizeof(DirectoryEntry), MAX_FILES, disk);
-    fflush(disk);
-
-    printf("Файл '%s' создан.\n", path);
+    meta_commit(fs);
+    return inode_index;
 }
 
+// SFS_OK, если inode — используемый обычный файл
+static int check_regular(sfs_t *fs, int file_inode) {
+    if (file_inode < 0 || file_inode >= fs->superblock.total_inodes) {
+        return SFS_ERR_NOENT;
+    }
+    Inode *inode = inode_get(fs, file_inode);
+    if (!inode) {
+        return SFS_ERR_IO;
+    }
+    if (!inode->is_used) {
+        return SFS_ERR_NOENT;
+    }
+    return inode->is_directory ? SFS_ERR_ISDIR : SFS_OK;
+}
 
-#define MAX_FILE_BLOCKS 10  // Задай это значение по максимуму, если еще не задано
-
-void sfs_write(const char *filename) {
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (strncmp(directory[i].filename, filename, MAX_FILENAME_LENGTH) == 0 &&
-            inode_table[directory[i].inode_index].is_directory == 0) {
+// Заполняет spans участками образа, занятыми байтами [offset, offset + len)
+// файла, по экстентам карты; buf — адрес данных для байта offset. Дыры
+// в spans не попадают; при zero_holes их часть buf заполняется нулями.
+// В spans должно быть место на map->count участков; возвращает их число.
+static int map_spans(sfs_t *fs, const ExtentList *map, char *buf, size_t len, long offset,
+                     DiskRequest *spans, int zero_holes) {
+    long end = offset + len;
+    long pos = 0;  // логическое смещение начала текущего экстента
+    int count = 0;
+    for (int j = 0; j < map->count && pos < end; j++) {
+        long extent_bytes = (long)map->items[j].length * fs->superblock.block_size;
+        long lo = offset > pos ? offset : pos;
+        long hi = end < pos + extent_bytes ? end : pos + extent_bytes;
+        if (lo < hi && map->items[j].start == HOLE_BLOCK) {
+            if (buf && zero_holes) memset(buf + (lo - offset), 0, hi - lo);
+        } else if (lo < hi) {
+            spans[count].buf = buf ? buf + (lo - offset) : NULL;
+            spans[count].len = hi - lo;
+            spans[count].offset = get_block_offset(fs, map->items[j].start) + (lo - pos);
+            count++;
+        }
+        pos += extent_bytes;
+    }
+    return count;
+}
 
-            Inode *inode = &inode_table[directory[i].inode_index];
+// Переносит байты [offset, offset + len) файла между buf и его блоками,
+// затрагивая только блоки, попавшие в диапазон. Участки всех экстентов
+// передаются кэшу одним пакетом; дыры читаются как нули без обращений
+// к образу, а запись в них пропускается (см. fill_holes).
+static int transfer(sfs_t *fs, const ExtentList *map, char *buf, size_t len, long offset, int write) {
+    DiskRequest local[16];
+    DiskRequest *spans = local;
+    if (map->count > 16) {
+        spans = malloc(sizeof(DiskRequest) * map->count);
+        if (!spans) return -1;
+    }
+    int count = map_spans(fs, map, buf, len, offset, spans, !write);
+    int r = write ? cache_write_spans(fs, spans, count) : cache_read_spans(fs, spans, count);
+    if (spans != local) free(spans);
+    return r;
+}
 
-            printf("Введите данные для записи в файл '%s': ", filename);
-            fgets(data, sizeof(data), stdin);
+// Отмечает чтение в детекторе последовательного доступа и, если поток
+// продолжается, ставит в кэш следующие блоки файла по его карте экстентов
+static void read_ahead(sfs_t *fs, int file_inode, const ExtentList *map, long offset, size_t len) {
+    long from, to;
+    if (!cache_readahead(fs, file_inode, offset, len, &from, &to)) return;
+    long bs = fs->superblock.block_size;
+    long size = inode_get(fs, file_inode)->size;
+    from = from / bs * bs;
+    if (to > size) to = (size + bs - 1) / bs * bs;
+    if (from >= to) return;
+
+    DiskRequest local[16];
+    DiskRequest *spans = local;
+    if (map->count > 16) {
+        spans = malloc(sizeof(DiskRequest) * map->count);
+        if (!spans) return;
+    }
+    int count = map_spans(fs, map, NULL, to - from, from, spans, 0);
+    cache_prefetch(fs, spans, count, 1);
+    if (spans != local) free(spans);
+}
 
-            int size = strlen(data);
-            int required_blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+// Записывает нули в [from, to) уже выделенных блоков файла
+static int zero_range(sfs_t *fs, const ExtentList *map, long from, long to) {
+    static char zero_block[MAX_BLOCK_SIZE];
+    while (from < to) {
+        long n = to - from < fs->superblock.block_size ? to - from : fs->superblock.block_size;
+        if (transfer(fs, map, zero_block, n, from, 1) != 0) return -1;
+        from += n;
+    }
+    return 0;
+}
 
-            // Ограничение по количеству блоков
-            if (required_blocks > MAX_FILE_BLOCKS) {
-                printf("Превышен максимальный размер файла. Будут записаны только первые %d байт.\n", MAX_FILE_BLOCKS * BLOCK_SIZE);
-                size = MAX_FILE_BLOCKS * BLOCK_SIZE;
-                required_blocks = MAX_FILE_BLOCKS;
+// Выделяет блоки под дыры карты в байтах [from, to) файла и сохраняет карту.
+// Крайние новые блоки, которые запись [from, to) покроет не целиком,
+// заранее обнуляются. Возвращает конец начальной части диапазона, которая
+// получила блоки (меньше to при нехватке места), или -1.
+static long fill_holes(sfs_t *fs, int file_inode, ExtentList *map, long from, long to) {
+    int bs = fs->superblock.block_size;
+    int first = from / bs;
+    int last = (to + bs - 1) / bs;  // блоки [first, last)
+    int stop = last;                // первый блок, на который не хватило места
+    int head = -1, tail = -1;       // новые блоки под first и last - 1
+
+    int pos = 0;
+    int holes = 0;
+    for (int j = 0; j < map->count && pos < last; j++) {
+        if (map->items[j].start == HOLE_BLOCK && pos + map->items[j].length > first) holes = 1;
+        pos += map->items[j].length;
+    }
+    if (!holes) return to;
+
+    ExtentList filled, fresh;
+    extent_list_init(&filled);
+    extent_list_init(&fresh);
+    pos = 0;
+    int r = 0;
+    for (int j = 0; j < map->count && r == 0; j++) {
+        int start = map->items[j].start;
+        int length = map->items[j].length;
+        int lo = first > pos ? first : pos;
+        int hi = last < pos + length ? last : pos + length;
+        if (start != HOLE_BLOCK || lo >= hi || lo >= stop) {
+            r = extent_append(&filled, start, length);
+            pos += length;
+            continue;
+        }
+        if (lo > pos) r = extent_append(&filled, HOLE_BLOCK, lo - pos);
+        int b = lo;
+        while (r == 0 && b < hi) {
+            int got;
+            int run = allocate_run(fs, hi - b, &got, 0);
+            if (run == -1) {
+                stop = b;
+                break;
             }
+            if (b == first) head = run;
+            if (b + got == last) tail = run + got - 1;
+            r = extent_append(&filled, run, got);
+            if (r == 0) r = extent_append(&fresh, run, got);
+            b += got;
+        }
+        if (r == 0 && b < pos + length) r = extent_append(&filled, HOLE_BLOCK, pos + length - b);
+        pos += length;
+    }
 
-            // Выделяем недостающие блоки
-            while (inode->block_count < required_blocks) {
-                int new_block = find_free_block();
-                if (new_block == -1) {
-                    printf("Недостаточно свободного места. Запись будет неполной.\n");
-                    break;
-                }
-                inode->blocks[inode->block_count++] = new_block;
-                allocate_block(new_block);
-            }
+    if (fresh.count > 0 && (r != 0 || inode_store_extents(fs, file_inode, &filled) != 0)) {
+        for (int j = 0; j < fresh.count; j++) {
+            for (int b = 0; b < fresh.items[j].length; b++) free_block(fs, fresh.items[j].start + b);
+        }
+        r = -1;
+    }
+    extent_list_free(&fresh);
+    if (r != 0) {
+        extent_list_free(&filled);
+        return -1;
+    }
+    extent_list_free(map);
+    *map = filled;
 
-            // Запись данных по блокам
-            int data_written = 0;
-            for (int j = 0; j < inode->block_count && data_written < size; j++) {
-                int block_size = (size - data_written > BLOCK_SIZE) ? BLOCK_SIZE : size - data_written;
+    static char zero_block[MAX_BLOCK_SIZE];
+    if (head != -1 && (from % bs != 0 || (head == tail && to % bs != 0))) {
+        cache_write(fs, head, 0, zero_block, bs);
+    }
+    if (tail != -1 && tail != head && to % bs != 0) cache_write(fs, tail, 0, zero_block, bs);
+    return stop == last ? to : ((long)stop * bs > from ? (long)stop * bs : from);
+}
 
-                fseek(disk, get_block_offset(inode->blocks[j]), SEEK_SET);
-                fwrite(data + data_written, 1, block_size, disk);
+// Файл без экстентов хранит содержимое в самом inode (inline_data), пока
+// оно не длиннее layout.inline_max; такие файлы читаются и пишутся без
+// блоков и без обращений к области данных.
+static int is_inline(sfs_t *fs, int file_inode) {
+    return inode_get(fs, file_inode)->extent_count == 0 && !delay_pending(fs, file_inode);
+}
 
-                data_written += block_size;
-            }
+// Переносит содержимое inode в отложенный хвост перед записью, которая
+// в inode не уместится; блоки хвост получит при сбросе (sfs_delay.c)
+static int inline_to_tail(sfs_t *fs, int file_inode) {
+    Inode *inode = inode_get(fs, file_inode);
+    if (!is_inline(fs, file_inode) || inode->size == 0) return SFS_OK;
+    long w = delay_write(fs, file_inode, inode->inline_data, inode->size, 0);
+    if (w < 0) return w;
+    return w == inode->size ? SFS_OK : SFS_ERR_NOSPC;
+}
 
-            inode->size = data_written;
+// Меняет данные в inode: байты [offset, end) берутся из buf (если он есть),
+// промежуток за старым концом заполняется нулями, size становится новым размером
+static void write_inline(sfs_t *fs, int file_inode, const void *buf, long offset, long end, long size) {
+    Inode *inode = inode_get(fs, file_inode);
+    if (offset > inode->size) memset(inode->inline_data + inode->size, 0, offset - inode->size);
+    if (buf) memcpy(inode->inline_data + offset, buf, end - offset);
+    if (size < INODE_INLINE_MAX) memset(inode->inline_data + size, 0, INODE_INLINE_MAX - size);
+    inode->size = size;
+    mark_inode_dirty(fs, file_inode);
+}
 
-            // Сохранение изменений
-            fseek(disk, 0, SEEK_SET);
-            fwrite(&superblock, sizeof(Superblock), 1, disk);
-            fseek(disk, sizeof(Superblock), SEEK_SET);
-            fwrite(inode_table, sizeof(Inode), MAX_FILES, disk);
+// Доводит размер файла до size (больше текущего), не выделяя блоков:
+// отложенный хвост пишется в образ, остаток последнего блока обнуляется,
+// а недостающие блоки добавляются в карту дырой
+static int extend_with_hole(sfs_t *fs, int file_inode, long size) {
+    Inode *inode = inode_get(fs, file_inode);
+    int bs = fs->superblock.block_size;
+    int r = inline_to_tail(fs, file_inode);
+    if (r != SFS_OK) return r;
+    delay_commit(fs, file_inode, 0);
+    if (delay_pending(fs, file_inode)) return SFS_ERR_NOSPC;
+
+    ExtentList map;
+    r = inode_load_extents(fs, file_inode, &map);
+    long base = (long)inode->block_count * bs;
+    if (r == 0 && inode->size < base) r = zero_range(fs, &map, inode->size, base);
+    int blocks = (size + bs - 1) / bs;
+    if (r == 0 && blocks > inode->block_count) {
+        r = extent_append(&map, HOLE_BLOCK, blocks - inode->block_count);
+        if (r == 0) r = inode_store_extents(fs, file_inode, &map);
+    }
+    extent_list_free(&map);
+    if (r != 0) return SFS_ERR_NOSPC;
+    inode->size = size;
+    mark_inode_dirty(fs, file_inode);
+    return SFS_OK;
+}
 
-            fflush(disk);
+// Реализации чтения, записи и усечения: вызывающий держит блокировку inode
+// Байты до конца выделенных блоков идут через кэш, дальше — отложенный хвост
+static long read_file(sfs_t *fs, int file_inode, void *buf, size_t len, long offset) {
+    if (offset < 0) return SFS_ERR_INVAL;
+
+    long size = file_size(fs, file_inode);
+    if (offset >= size || len == 0) return 0;
+    if ((long)len > size - offset) len = size - offset;
+    if (is_inline(fs, file_inode)) {
+        memcpy(buf, inode_get(fs, file_inode)->inline_data + offset, len);
+        return len;
+    }
 
-            printf("Записано %d байт в файл '%s'.\n", data_written, filename);
-            return;
+    long base = (long)inode_get(fs, file_inode)->block_count * fs->superblock.block_size;
+    size_t direct = offset >= base ? 0 : (size_t)(base - offset) < len ? (size_t)(base - offset) : len;
+    if (direct > 0) {
+        ExtentList map;
+        if (inode_load_extents(fs, file_inode, &map) != 0) {
+            extent_list_free(&map);
+            return SFS_ERR_IO;
         }
+        int r = transfer(fs, &map, buf, direct, offset, 0);
+        if (r == 0) read_ahead(fs, file_inode, &map, offset, direct);
+        extent_list_free(&map);
+        if (r != 0) return SFS_ERR_IO;
     }
-
-    printf("Файл '%s' не найден или является директорией.\n", filename);
+    if (len > direct) delay_read(fs, file_inode, (char *)buf + direct, len - direct, offset + direct);
+    return len;
 }
 
+// Запись в выделенные блоки идёт на место, за ними — в отложенный хвост,
+// блоки под который выделяются позже (sfs_delay.c)
+static long write_file(sfs_t *fs, int file_inode, const void *buf, size_t len, long offset) {
+    if (offset < 0 || offset + (long)len > INT_MAX) return SFS_ERR_INVAL;
+    if (len == 0) return 0;  // пустая запись размер файла не меняет
+    Inode *inode = inode_get(fs, file_inode);
+    int bs = fs->superblock.block_size;
+    long size = file_size(fs, file_inode);
+    long end = offset + len;
+
+    // Маленький файл целиком остаётся в inode, иначе его данные уходят в хвост
+    if (is_inline(fs, file_inode) && end <= fs->layout.inline_max) {
+        write_inline(fs, file_inode, buf, offset, end, end > size ? end : size);
+        meta_commit(fs);
+        return len;
+    }
+    int r = inline_to_tail(fs, file_inode);
+    if (r != SFS_OK) return r;
+
+    // Целые блоки между концом файла и offset не выделяются, а становятся дырой
+    long hole_end = offset / bs * bs;
+    if (hole_end > (size + bs - 1) / bs * bs) {
+        r = extend_with_hole(fs, file_inode, hole_end);
+        if (r != SFS_OK) return r;
+        size = hole_end;
+    }
 
-void sfs_read(const char *filename) {
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (strncmp(directory[i].filename, filename, MAX_FILENAME_LENGTH) == 0 && inode_table[directory[i].inode_index].is_directory == 0) {//////////////////////////
-            Inode *inode = &inode_table[directory[i].inode_index];
-
-            int data_read = 0;
-            int size = inode->size;
-            char buffer[size + 1];
-
-            for (int j = 0; j < inode->block_count; j++) {
-                int block_size = (size - data_read > BLOCK_SIZE) ? BLOCK_SIZE : size - data_read;
-
-                fseek(disk, get_block_offset(inode->blocks[j]), SEEK_SET);
-                fread(buffer + data_read, 1, block_size, disk);
-
-                data_read += block_size;
-                if (data_read == size) break;
+    long base = (long)inode->block_count * bs;
+    long written = 0;
+
+    // Промежуток от конца файла до offset в выделенных блоках заполняется нулями
+    long direct_end = end < base ? end : base;
+    long gap_end = offset < base ? offset : base;
+    int complete = 1;
+    if (offset < direct_end || size < gap_end) {
+        ExtentList map;
+        r = inode_load_extents(fs, file_inode, &map);
+        if (r == 0 && size < gap_end) r = zero_range(fs, &map, size, gap_end);
+        if (r == 0 && offset < direct_end) {
+            long backed = fill_holes(fs, file_inode, &map, offset, direct_end);
+            if (backed < 0) r = -1;
+            if (backed >= 0 && backed < direct_end) {
+                direct_end = backed;
+                complete = 0;
             }
-
-            buffer[size] = '\0';
-
-            printf("Данные из файла '%s':\n%s\n", filename, buffer);
-            return;
         }
+        if (r == 0 && offset < direct_end) r = transfer(fs, &map, (char *)buf, direct_end - offset, offset, 1);
+        extent_list_free(&map);
+        if (r != 0) return SFS_ERR_IO;
+        if (offset < direct_end) written = direct_end - offset;
+    }
+    if (written > 0 && offset + written > inode->size) {
+        inode->size = offset + written;
+        mark_inode_dirty(fs, file_inode);
     }
-    printf("Файл '%s' не найден.\n", filename);
+    if (!complete && written == 0) return SFS_ERR_NOSPC;
+
+    if (complete && end > base) {
+        long from = offset > base ? offset : base;
+        long w = delay_write(fs, file_inode, (const char *)buf + (from - offset), end - from, from);
+        if (w < 0 && written == 0) return w;
+        if (w > 0) written += w;
+        if (delay_file_full(fs, file_inode)) delay_commit(fs, file_inode, 0);
+    }
+    meta_commit(fs);
+    return written;
 }
 
-void sfs_delete(const char *filename) {
-    if (disk == NULL) {
-        fprintf(stderr, "Ошибка: файловая система не смонтирована.\n");
-        return;
+static int truncate_file(sfs_t *fs, int file_inode, long size) {
+    if (size < 0 || size > INT_MAX) return SFS_ERR_INVAL;
+    Inode *inode = inode_get(fs, file_inode);
+    long current = file_size(fs, file_inode);
+    if (is_inline(fs, file_inode) && size <= fs->layout.inline_max) {
+        write_inline(fs, file_inode, NULL, size, size, size);
+        meta_commit(fs);
+        return SFS_OK;
     }
-
-    if (filename == NULL || strlen(filename) == 0) {
-        printf("Ошибка: не указано имя файла.\n");
-        return;
+    int r = inline_to_tail(fs, file_inode);
+    if (r != SFS_OK) return r;
+    long block_end = (current + fs->superblock.block_size - 1) / fs->superblock.block_size * fs->superblock.block_size;
+    if (size > block_end) {
+        // Новые блоки не выделяются: файл доращивается дырой
+        r = extend_with_hole(fs, file_inode, size);
+        if (r == SFS_OK) meta_commit(fs);
+        return r;
+    }
+    if (size > current) {
+        // В пределах последнего блока дописываем нули
+        static char zero_block[MAX_BLOCK_SIZE];
+        while (current < size) {
+            long n = size - current < fs->superblock.block_size ? size - current : fs->superblock.block_size;
+            long w = write_file(fs, file_inode, zero_block, n, current);
+            if (w < 0) return w;
+            if (w != n) return SFS_ERR_NOSPC;
+            current += w;
+        }
+        return SFS_OK;
     }
 
-    // Ищем файл в текущей директории
-    int dir_entry_index = -1;
-    int file_inode_index = -1;
+    // Укорачивание в пределах хвоста блоков не касается
+    if (size >= (long)inode->block_count * fs->superblock.block_size) {
+        delay_truncate(fs, file_inode, size);
+        return SFS_OK;
+    }
+    delay_drop(fs, file_inode);
 
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (directory[i].inode_index != -1 &&
-            inode_table[directory[i].inode_index].directory_inode_index == current_directory_inode &&
-            strcmp(directory[i].filename, filename) == 0) {
+    ExtentList map;
+    if (inode_load_extents(fs, file_inode, &map) != 0) {
+        extent_list_free(&map);
+        return SFS_ERR_IO;
+    }
 
-            // Проверяем, что это не директория
-            if (inode_table[directory[i].inode_index].is_directory) {
-                printf("Ошибка: '%s' является директорией. Используйте rmdir для удаления директорий.\n", filename);
-                return;
+    // Отрезаем от карты блоки за новым концом, запоминая их
+    int keep_blocks = (size + fs->superblock.block_size - 1) / fs->superblock.block_size;
+    ExtentList cut;
+    extent_list_init(&cut);
+    int seen = 0;
+    int count = 0;
+    for (int j = 0; j < map.count; j++) {
+        int length = map.items[j].length;
+        if (seen + length <= keep_blocks) {
+            count++;
+        } else if (seen < keep_blocks) {
+            int keep = keep_blocks - seen;
+            int start = map.items[j].start;
+            extent_append(&cut, start == HOLE_BLOCK ? HOLE_BLOCK : start + keep, length - keep);
+            map.items[j].length = keep;
+            count++;
+        } else {
+            extent_append(&cut, map.items[j].start, length);
+        }
+        seen += length;
+    }
+    map.count = count;
+
+    r = 0;
+    if (cut.count > 0) {
+        r = inode_store_extents(fs, file_inode, &map);
+        if (r == 0) {
+            for (int j = 0; j < cut.count; j++) {
+                if (cut.items[j].start == HOLE_BLOCK) continue;
+                for (int b = 0; b < cut.items[j].length; b++) {
+                    free_block(fs, cut.items[j].start + b);
+                }
             }
-
-            dir_entry_index = i;
-            file_inode_index = directory[i].inode_index;
-            break;
         }
     }
+    extent_list_free(&cut);
+    extent_list_free(&map);
 
-    if (dir_entry_index == -1) {
-        printf("Файл '%s' не найден в текущей директории.\n", filename);
-        return;
+    if (r == 0) {
+        inode->size = size;
+        mark_inode_dirty(fs, file_inode);
+        meta_commit(fs);
     }
+    return r == 0 ? SFS_OK : SFS_ERR_NOSPC;
+}
 
-    Inode *file_inode = &inode_table[file_inode_index];
+int delete_file(sfs_t *fs, const char *filename) {
+    int file_inode_index = lookup_path(fs, filename);
+    if (file_inode_index < 0) {
+        return file_inode_index;
+    }
 
-    // Освобождаем все блоки файла
-    for (int i = 0; i < file_inode->block_count; i++) {
-        int block_index = file_inode->blocks[i];
+    // Проверяем, что это не директория
+    Inode *file_inode = inode_get(fs, file_inode_index);
+    if (file_inode->is_directory) {
+        return SFS_ERR_ISDIR;
+    }
 
-        if (block_index < 0 || block_index >= MAX_BLOCKS) {
-            printf("Предупреждение: некорректный индекс блока %d, пропускаем.\n", block_index);
-            continue;
-        }
+    if (!name_index_name(fs, file_inode_index)) {
+        return SFS_ERR_NOENT;
+    }
 
-        // Очищаем блок на диске
-        char zero_block[BLOCK_SIZE] = {0};
-        fseek(disk, block_index * BLOCK_SIZE, SEEK_SET);
-        fwrite(zero_block, BLOCK_SIZE, 1, disk);
+    // Удаляем запись из директории
+    dir_unlink(fs, file_inode_index);
+    delay_drop(fs, file_inode_index);
 
-        // Освобождаем блок в битовой карте
-        free_block(block_index);
-    }
+    // Освобождаем блоки в битовой карте; данные не трогаем — место блоков
+    // вернётся хосту после коммита группы
+    inode_free_blocks(fs, file_inode_index);
 
     // Освобождаем inode
     memset(file_inode, 0, sizeof(Inode));
-    superblock.free_inodes++;
+    fs->superblock.free_inodes++;
 
-    // Удаляем запись из директории
-    directory[dir_entry_index].inode_index = -1;
-    memset(directory[dir_entry_index].filename, 0, MAX_FILENAME_LENGTH);
+    mark_inode_dirty(fs, file_inode_index);
+    mark_superblock_dirty(fs);
 
     // Сохраняем изменения на диск
-    fseek(disk, 0, SEEK_SET);
-    fwrite(&superblock, sizeof(Superblock), 1, disk);
+    meta_commit(fs);
+    return SFS_OK;
+}
+
+// Внешний интерфейс. Создание и удаление меняют пространство имён; чтение
+// и запись держат его на чтение, а сам файл — блокировкой его inode, так
+// что разные файлы читаются и пишутся параллельно.
+
+int sfs_create(sfs_t *fs, const char *path) {
+    op_begin(fs, 1);
+    int r = create_file(fs, path);
+    op_end(fs);
+    return r;
+}
 
-    fseek(disk, sizeof(Superblock), SEEK_SET);
-    fwrite(inode_table, sizeof(Inode), MAX_FILES, disk);
+int sfs_delete(sfs_t *fs, const char *path) {
+    op_begin(fs, 1);
+    int r = delete_file(fs, path);
+    op_end(fs);
+    return r;
+}
 
-    fseek(disk, sizeof(Superblock) + sizeof(Inode) * MAX_FILES, SEEK_SET);
-    fwrite(directory, sizeof(DirectoryEntry), MAX_FILES, disk);
+// Читает до len байт файла начиная с offset. Возвращает число прочитанных
+// байт (0 за концом файла) или код ошибки.
+long sfs_pread(sfs_t *fs, int file_inode, void *buf, size_t len, long offset) {
+    op_begin(fs, 0);
+    long r = check_regular(fs, file_inode);
+    if (r == SFS_OK) {
+        pthread_rwlock_rdlock(inode_lock(fs, file_inode));
+        r = read_file(fs, file_inode, buf, len, offset);
+        pthread_rwlock_unlock(inode_lock(fs, file_inode));
+    }
+    op_end(fs);
+    return r;
+}
 
-    fflush(disk); // Гарантируем запись на диск
+// Записывает len байт в файл с позиции offset, выделяя недостающие блоки.
+// Промежуток между старым концом файла и offset читается как нули; целые
+// блоки в нём не выделяются (дыра).
+// Возвращает число записанных байт (меньше len при нехватке места) или код ошибки.
+long sfs_pwrite(sfs_t *fs, int file_inode, const void *buf, size_t len, long offset) {
+    op_begin(fs, 0);
+    long r = check_regular(fs, file_inode);
+    if (r == SFS_OK) {
+        pthread_rwlock_wrlock(inode_lock(fs, file_inode));
+        r = write_file(fs, file_inode, buf, len, offset);
+        pthread_rwlock_unlock(inode_lock(fs, file_inode));
+    }
+    op_end(fs);
+    return r;
+}
 
-    printf("Файл '%s' успешно удален.\n", filename);
-}
\ No newline at end of file
+long sfs_append(sfs_t *fs, int file_inode, const void *buf, size_t len) {
+    op_begin(fs, 0);
+    long r = check_regular(fs, file_inode);
+    if (r == SFS_OK) {
+        pthread_rwlock_wrlock(inode_lock(fs, file_inode));
+        r = write_file(fs, file_inode, buf, len, file_size(fs, file_inode));
+        pthread_rwlock_unlock(inode_lock(fs, file_inode));
+    }
+    op_end(fs);
+    return r;
+}
+
+// Устанавливает размер файла: при уменьшении освобождает блоки за новым концом,
+// при увеличении доращивает файл дырой, которая читается как нули
+int sfs_truncate(sfs_t *fs, int file_inode, long size) {
+    op_begin(fs, 0);
+    int r = check_regular(fs, file_inode);
+    if (r == SFS_OK) {
+        pthread_rwlock_wrlock(inode_lock(fs, file_inode));
+        r = truncate_file(fs, file_inode, size);
+        pthread_rwlock_unlock(inode_lock(fs, file_inode));
+    }
+    op_end(fs);
+    return r;
+}
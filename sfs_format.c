@@ -0,0 +1,235 @@
+#include "sfs.h"
+#include <stddef.h>
+
+// Таблицы inode и directory[] в формате образа. В памяти inode и записи
+// директорий одинаковы для всех форматов. Inode читаются страницами кэша
+// метаданных (sfs_mcache.c) и кодируются обратно при коммите группы;
+// directory[] форматов 1 и 2 лежит в памяти целиком вместе с копией в
+// формате тома (dirent_area), записи меняются сразу в обеих.
+//
+// Формат 1: inode по 348 байт с копией имени, directory[] — по записи
+// в 260 байт на inode. Формат 2: inode по 64 байта без имени, так что
+// просмотр таблицы читает по одной строке кэша на inode; directory[] —
+// слоты по 32 байта, запись занимает столько слотов подряд, сколько нужно
+// её имени (до 23 байт — один). Слотов вдвое больше, чем inode.
+// Формат 3: inode как в формате 2, а общей таблицы directory[] нет — такие
+// же записи лежат в блоках данных своей директории, не пересекая границ
+// блоков, и читаются вместе с директорией.
+
+_Static_assert(sizeof(InodeV1) == 348, "inode формата 1 — 348 байт");
+_Static_assert(sizeof(InodeV2) == 64, "inode формата 2 — 64 байта");
+_Static_assert(sizeof(DirentV2) == 8, "заголовок записи формата 2 — 8 байт");
+
+void inode_decode(const Layout *l, const void *raw, Inode *inode) {
+    memset(inode, 0, sizeof(Inode));
+    if (l->format == SFS_FORMAT_V1) {
+        const InodeV1 *d = raw;
+        inode->is_used = d->is_used != 0;
+        inode->is_directory = d->is_directory != 0;
+        inode->directory_inode_index = d->directory_inode_index;
+        inode->size = d->size;
+        inode->block_count = d->block_count;
+        inode->extent_count = d->extent_count;
+        memcpy(inode->inline_data, d->inline_data, INODE_INLINE_MAX);
+        return;
+    }
+    const InodeV2 *d = raw;
+    inode->is_used = d->is_used;
+    inode->is_directory = d->is_directory;
+    inode->directory_inode_index = d->directory_inode_index;
+    inode->size = d->size;
+    inode->block_count = d->block_count;
+    inode->extent_count = d->extent_count;
+    if (d->extent_count == 0) {
+        memcpy(inode->inline_data, d->inline_data, INODE_V2_INLINE_MAX);
+    } else {
+        memcpy(inode->extents, d->extents, sizeof(d->extents));
+        inode->extent_block = d->extent_block;
+    }
+}
+
+void inode_encode(const Layout *l, const Inode *inode, void *raw) {
+    if (l->format == SFS_FORMAT_V1) {
+        InodeV1 *d = raw;
+        memset(d, 0, sizeof(InodeV1));
+        d->is_used = inode->is_used;
+        d->is_directory = inode->is_directory;
+        d->directory_inode_index = inode->directory_inode_index;
+        d->size = inode->size;
+        d->block_count = inode->block_count;
+        d->extent_count = inode->extent_count;
+        memcpy(d->inline_data, inode->inline_data, INODE_INLINE_MAX);
+        return;
+    }
+    InodeV2 *d = raw;
+    memset(d, 0, sizeof(InodeV2));
+    d->is_used = inode->is_used;
+    d->is_directory = inode->is_directory;
+    d->directory_inode_index = inode->directory_inode_index;
+    d->size = inode->size;
+    d->block_count = inode->block_count;
+    d->extent_count = inode->extent_count;
+    if (inode->extent_count == 0) {
+        memcpy(d->inline_data, inode->inline_data, INODE_V2_INLINE_MAX);
+    } else {
+        memcpy(d->extents, inode->extents, sizeof(d->extents));
+        d->extent_block = inode->extent_block;
+    }
+}
+
+static char *dirent_raw(sfs_t *fs, int dir_entry_index) {
+    return fs->dirent_area + (long)fs->layout.dirent_size * dir_entry_index;
+}
+
+// Слотов под запись с именем длины name_length
+int dirent_slots(sfs_t *fs, size_t name_length) {
+    if (fs->layout.format == SFS_FORMAT_V1) return 1;
+    return (sizeof(DirentV2) + name_length + 1 + DIRENT_V2_SLOT - 1) / DIRENT_V2_SLOT;
+}
+
+const char *dirent_name(sfs_t *fs, int dir_entry_index) {
+    size_t header = fs->layout.format == SFS_FORMAT_V1 ? offsetof(DirentV1, filename) : sizeof(DirentV2);
+    return dirent_raw(fs, dir_entry_index) + header;
+}
+
+// Разбирает прочитанную с диска directory[] форматов 1 и 2. Запись
+// формата 2, которая не сходится со своим именем или выходит за таблицу,
+// считается свободной.
+void dirents_decode(sfs_t *fs) {
+    const Layout *l = &fs->layout;
+    for (int i = 0; i < l->dirent_count; ) {
+        char *raw = dirent_raw(fs, i);
+        DirectoryEntry *e = &fs->directory[i];
+        int32_t inode_index;
+        memcpy(&inode_index, raw, sizeof(inode_index));
+        e->inode_index = inode_index < 0 ? DIRENT_FREE : inode_index;
+        e->name_length = 0;
+        e->slots = 1;
+        if (e->inode_index == DIRENT_FREE) {
+            i++;
+            continue;
+        }
+        if (l->format == SFS_FORMAT_V1) {
+            raw[l->dirent_size - 1] = '\0';
+            e->name_length = strlen(dirent_name(fs, i));
+        } else {
+            DirentV2 h;
+            memcpy(&h, raw, sizeof(h));
+            if (h.slots != dirent_slots(fs, h.name_length) || i + h.slots > l->dirent_count) {
+                e->inode_index = DIRENT_FREE;
+                i++;
+                continue;
+            }
+            raw[sizeof(DirentV2) + h.name_length] = '\0';
+            e->name_length = h.name_length;
+            e->slots = h.slots;
+        }
+        for (int k = 1; k < e->slots; k++) {
+            fs->directory[i + k].inode_index = DIRENT_CONT;
+            fs->directory[i + k].name_length = 0;
+            fs->directory[i + k].slots = 0;
+        }
+        i += e->slots;
+    }
+}
+
+// Занимает запись: слоты [dir_entry_index, +dirent_slots) должны быть свободны
+void dirent_set(sfs_t *fs, int dir_entry_index, int inode, const char *name) {
+    size_t len = strnlen(name, MAX_FILENAME_LENGTH - 1);
+    int slots = dirent_slots(fs, len);
+    char *raw = dirent_raw(fs, dir_entry_index);
+    memset(raw, 0, (size_t)fs->layout.dirent_size * slots);
+    if (fs->layout.format == SFS_FORMAT_V1) {
+        DirentV1 *d = (DirentV1 *)raw;
+        d->inode_index = inode;
+        memcpy(d->filename, name, len);
+    } else {
+        DirentV2 h = {inode, len, slots, 0};
+        memcpy(raw, &h, sizeof(h));
+        memcpy(raw + sizeof(h), name, len);
+    }
+
+    for (int k = 0; k < slots; k++) {
+        DirectoryEntry *e = &fs->directory[dir_entry_index + k];
+        e->inode_index = k == 0 ? inode : DIRENT_CONT;
+        e->name_length = k == 0 ? len : 0;
+        e->slots = k == 0 ? slots : 0;
+        mark_dirent_dirty(fs, dir_entry_index + k);
+    }
+}
+
+// Освобождает запись вместе со слотами продолжения
+void dirent_clear(sfs_t *fs, int dir_entry_index) {
+    int slots = fs->directory[dir_entry_index].slots;
+    for (int k = 0; k < slots; k++) {
+        char *raw = dirent_raw(fs, dir_entry_index + k);
+        memset(raw, 0, fs->layout.dirent_size);
+        if (fs->layout.format == SFS_FORMAT_V1) {
+            ((DirentV1 *)raw)->inode_index = DIRENT_FREE;
+        } else {
+            DirentV2 h = {DIRENT_FREE, 0, 1, 0};
+            memcpy(raw, &h, sizeof(h));
+        }
+        DirectoryEntry *e = &fs->directory[dir_entry_index + k];
+        e->inode_index = DIRENT_FREE;
+        e->name_length = 0;
+        e->slots = 1;
+        mark_dirent_dirty(fs, dir_entry_index + k);
+    }
+}
+
+// Записи в блоке директории формата 3; offset — смещение слота в блоке.
+// Возвращает число слотов записи или 0, если слот свободен или запись
+// испорчена (не сходится с именем, выходит за блок).
+int dirblock_record(sfs_t *fs, const char *block, int offset, int *inode, const char **name, size_t *name_length) {
+    DirentV2 h;
+    memcpy(&h, block + offset, sizeof(h));
+    if (h.inode_index <= 0 || h.inode_index >= fs->superblock.total_inodes) return 0;
+    if (h.slots != dirent_slots(fs, h.name_length) || offset + h.slots * DIRENT_V2_SLOT > fs->superblock.block_size) {
+        return 0;
+    }
+    *inode = h.inode_index;
+    *name = block + offset + sizeof(DirentV2);
+    *name_length = h.name_length;
+    return h.slots;
+}
+
+// Смещение первых slots подряд свободных слотов блока или -1
+int dirblock_find_free(sfs_t *fs, const char *block, int slots) {
+    int bs = fs->superblock.block_size;
+    int run = 0;
+    for (int offset = 0; offset < bs; ) {
+        int inode;
+        const char *name;
+        size_t len;
+        int used = dirblock_record(fs, block, offset, &inode, &name, &len);
+        if (used > 0) {
+            run = 0;
+            offset += used * DIRENT_V2_SLOT;
+            continue;
+        }
+        offset += DIRENT_V2_SLOT;
+        if (++run == slots) return offset - slots * DIRENT_V2_SLOT;
+    }
+    return -1;
+}
+
+// Занимает запись в блоке: слоты под имя с offset должны быть свободны
+void dirblock_set(sfs_t *fs, char *block, int offset, int inode, const char *name, size_t name_length) {
+    int slots = dirent_slots(fs, name_length);
+    DirentV2 h = {inode, name_length, slots, 0};
+    memset(block + offset, 0, (size_t)slots * DIRENT_V2_SLOT);
+    memcpy(block + offset, &h, sizeof(h));
+    memcpy(block + offset + sizeof(h), name, name_length);
+}
+
+// Обнуляет запись в блоке; возвращает, сколько слотов она занимала
+int dirblock_clear(sfs_t *fs, char *block, int offset) {
+    int inode;
+    const char *name;
+    size_t len;
+    int slots = dirblock_record(fs, block, offset, &inode, &name, &len);
+    if (slots == 0) slots = 1;
+    memset(block + offset, 0, (size_t)slots * DIRENT_V2_SLOT);
+    return slots;
+}
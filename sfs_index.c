@@ -0,0 +1,732 @@
+#include "sfs.h"
+#include <stdlib.h>
+
+// Индекс имён: запись (Dentry) на каждый inode с известным именем —
+// хеш по (inode родительской директории, имя) и списки детей директорий.
+// Живёт только в памяти и поддерживается при создании, удалении и
+// перемещении записей.
+//
+// В форматах 1 и 2 индекс строится при монтировании по всей directory[].
+// В формате 3 записи директории читаются из её блоков при первом
+// обращении к ней (dir_loaded): чтобы прочитать директорию, сначала
+// читаются её предки. Давно не нужные прочитанные директории без
+// прочитанных поддиректорий выбрасываются при коммите группы
+// (name_index_trim), их записи занимают память кэша метаданных.
+//
+// Промах поиска, ради которого директорию пришлось читать, в формате 3
+// запоминается записью отсутствующего имени (inode -1): она переживает
+// выбрасывание директории, и повторный поиск того же имени отвечает без
+// чтения её блоков. Такая запись исчезает, когда имя появляется в
+// директории, вместе с самой директорией и при нехватке памяти кэша.
+// В форматах 1 и 2 индекс полон, и промах в нём и так окончателен.
+//
+// Чтение директорий идёт под ns_lock на чтение и поэтому — под index.lock
+// на запись; поиск держит его на чтение. Создание, удаление и перемещение
+// записей, как и выбрасывание директорий, идут под ns_lock на запись и
+// index.lock не берут. Списки детей прочитанной директории меняются только
+// под ns_lock на запись, так что их обходят без index.lock.
+
+#define MAX_DIR_DEPTH 1024  // предков при чтении директории; больше — цикл в испорченном образе
+#define NO_ENTRY (-1)       // inode записи отсутствующего имени
+
+static int lazy(sfs_t *fs) {
+    return fs->layout.format == SFS_FORMAT_V3;
+}
+
+static unsigned int name_hash(sfs_t *fs, int parent_inode, const char *name, size_t len) {
+    // FNV-1a по имени, перемешанный с номером родителя
+    unsigned int h = 2166136261u ^ (unsigned int)parent_inode;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    return h & fs->index.bucket_mask;
+}
+
+static size_t dentry_bytes(size_t name_length) {
+    return sizeof(Dentry) + name_length + 1;
+}
+
+static Dentry *dentry_new(sfs_t *fs, int inode, int parent, const char *name, size_t len) {
+    Dentry *d = calloc(1, dentry_bytes(len));
+    if (!d) return NULL;
+    d->inode = inode;
+    d->parent = parent;
+    d->name_length = len;
+    memcpy(d->name, name, len);
+    d->used = fs->mcache.epoch;
+    if (lazy(fs)) mcache_account(fs, dentry_bytes(len));
+    return d;
+}
+
+static void dentry_free(sfs_t *fs, Dentry *d) {
+    if (lazy(fs)) mcache_account(fs, -(long)dentry_bytes(d->name_length));
+    free(d);
+}
+
+static Dentry *dentry_of(sfs_t *fs, int inode) {
+    if (inode == 0) return fs->index.root;
+    if (inode < 0 || inode >= fs->superblock.total_inodes) return NULL;
+    return fs->index.of_inode[inode];
+}
+
+// Вдвое больше корзин, когда записей стало вдвое больше корзин
+static void buckets_grow(sfs_t *fs) {
+    NameIndex *ix = &fs->index;
+    unsigned int buckets = (ix->bucket_mask + 1) * 2;
+    Dentry **table = calloc(buckets, sizeof(Dentry *));
+    if (!table) return;
+    unsigned int old_mask = ix->bucket_mask;
+    Dentry **old = ix->buckets;
+    ix->buckets = table;
+    ix->bucket_mask = buckets - 1;
+    for (unsigned int b = 0; b <= old_mask; b++) {
+        while (old[b]) {
+            Dentry *d = old[b];
+            old[b] = d->hash_next;
+            unsigned int h = name_hash(fs, d->parent, d->name, d->name_length);
+            d->hash_next = table[h];
+            table[h] = d;
+        }
+    }
+    free(old);
+}
+
+static Dentry *hash_find(sfs_t *fs, int parent_inode, const char *name, size_t len) {
+    for (Dentry *d = fs->index.buckets[name_hash(fs, parent_inode, name, len)]; d; d = d->hash_next) {
+        if (d->name_length == len && d->parent == parent_inode && memcmp(d->name, name, len) == 0) {
+            return d;
+        }
+    }
+    return NULL;
+}
+
+static void touch(sfs_t *fs, Dentry *d) {
+    if (__atomic_load_n(&d->used, __ATOMIC_RELAXED) != fs->mcache.epoch) {
+        __atomic_store_n(&d->used, fs->mcache.epoch, __ATOMIC_RELAXED);
+    }
+}
+
+// Запоминает отсутствие имени в директории p (формат 3)
+static void negative_add(sfs_t *fs, Dentry *p, const char *name, size_t len) {
+    NameIndex *ix = &fs->index;
+    Dentry *n = dentry_new(fs, NO_ENTRY, p->inode, name, len);
+    if (!n) return;
+    unsigned int h = name_hash(fs, p->inode, name, len);
+    n->hash_next = ix->buckets[h];
+    ix->buckets[h] = n;
+    n->next_sibling = p->negative;
+    if (p->negative) p->negative->prev_sibling = n;
+    p->negative = n;
+    n->next_loaded = ix->negatives;
+    if (ix->negatives) ix->negatives->prev_loaded = n;
+    ix->negatives = n;
+    if (++ix->count > (long)(ix->bucket_mask + 1) * 2) buckets_grow(fs);
+}
+
+static void negative_remove(sfs_t *fs, Dentry *p, Dentry *n) {
+    NameIndex *ix = &fs->index;
+    Dentry **link = &ix->buckets[name_hash(fs, n->parent, n->name, n->name_length)];
+    while (*link && *link != n) link = &(*link)->hash_next;
+    if (*link) *link = n->hash_next;
+    if (n->prev_sibling) {
+        n->prev_sibling->next_sibling = n->next_sibling;
+    } else {
+        p->negative = n->next_sibling;
+    }
+    if (n->next_sibling) n->next_sibling->prev_sibling = n->prev_sibling;
+    if (n->prev_loaded) {
+        n->prev_loaded->next_loaded = n->next_loaded;
+    } else {
+        ix->negatives = n->next_loaded;
+    }
+    if (n->next_loaded) n->next_loaded->prev_loaded = n->prev_loaded;
+    ix->count--;
+    dentry_free(fs, n);
+}
+
+static void negatives_drop(sfs_t *fs, Dentry *p) {
+    while (p->negative) negative_remove(fs, p, p->negative);
+}
+
+// Прочитанная директория в списке кандидатов на выбрасывание (формат 3)
+static void loaded_add(sfs_t *fs, Dentry *d) {
+    NameIndex *ix = &fs->index;
+    d->loaded = 1;
+    d->free_block = 0;
+    if (!lazy(fs)) return;
+    d->prev_loaded = NULL;
+    d->next_loaded = ix->loaded;
+    if (ix->loaded) ix->loaded->prev_loaded = d;
+    ix->loaded = d;
+    Dentry *p = dentry_of(fs, d->parent);
+    if (p && d != ix->root) p->loaded_dirs++;
+}
+
+static void loaded_remove(sfs_t *fs, Dentry *d) {
+    NameIndex *ix = &fs->index;
+    if (!d->loaded) return;
+    d->loaded = 0;
+    if (!lazy(fs)) return;
+    if (d->prev_loaded) {
+        d->prev_loaded->next_loaded = d->next_loaded;
+    } else {
+        ix->loaded = d->next_loaded;
+    }
+    if (d->next_loaded) d->next_loaded->prev_loaded = d->prev_loaded;
+    d->next_loaded = d->prev_loaded = NULL;
+    Dentry *p = dentry_of(fs, d->parent);
+    if (p && d != ix->root) p->loaded_dirs--;
+}
+
+static void child_link(Dentry *p, Dentry *d) {
+    d->prev_sibling = p->last_child;
+    d->next_sibling = NULL;
+    if (p->last_child) {
+        p->last_child->next_sibling = d;
+    } else {
+        p->first_child = d;
+    }
+    p->last_child = d;
+}
+
+static void child_unlink(Dentry *p, Dentry *d) {
+    if (d->prev_sibling) {
+        d->prev_sibling->next_sibling = d->next_sibling;
+    } else if (p->first_child == d) {
+        p->first_child = d->next_sibling;
+    }
+    if (d->next_sibling) {
+        d->next_sibling->prev_sibling = d->prev_sibling;
+    } else if (p->last_child == d) {
+        p->last_child = d->prev_sibling;
+    }
+    d->next_sibling = d->prev_sibling = NULL;
+}
+
+// Включает запись в хеш, в таблицу по inode и в список детей родителя,
+// если родитель прочитан; запомненное отсутствие того же имени снимается
+static void index_insert(sfs_t *fs, Dentry *d) {
+    NameIndex *ix = &fs->index;
+    Dentry *p = dentry_of(fs, d->parent);
+    if (p && p->negative) {
+        Dentry *n = hash_find(fs, d->parent, d->name, d->name_length);
+        if (n && n->inode == NO_ENTRY) negative_remove(fs, p, n);
+    }
+    unsigned int h = name_hash(fs, d->parent, d->name, d->name_length);
+    d->hash_next = ix->buckets[h];
+    ix->buckets[h] = d;
+    ix->of_inode[d->inode] = d;
+    if (p && p->loaded) child_link(p, d);
+    if (p && d->loaded && lazy(fs)) p->loaded_dirs++;
+    if (++ix->count > (long)(ix->bucket_mask + 1) * 2) buckets_grow(fs);
+}
+
+static void index_remove(sfs_t *fs, Dentry *d) {
+    NameIndex *ix = &fs->index;
+    Dentry **link = &ix->buckets[name_hash(fs, d->parent, d->name, d->name_length)];
+    while (*link && *link != d) link = &(*link)->hash_next;
+    if (*link) *link = d->hash_next;
+    d->hash_next = NULL;
+    if (ix->of_inode[d->inode] == d) ix->of_inode[d->inode] = NULL;
+    Dentry *p = dentry_of(fs, d->parent);
+    if (p && p->loaded) child_unlink(p, d);
+    if (p && d->loaded && lazy(fs)) p->loaded_dirs--;
+    ix->count--;
+}
+
+static void children_drop(sfs_t *fs, Dentry *d) {
+    while (d->first_child) {
+        Dentry *c = d->first_child;
+        negatives_drop(fs, c);
+        index_remove(fs, c);
+        dentry_free(fs, c);
+    }
+}
+
+// Выбрасывает записи детей прочитанной директории, у которой нет
+// прочитанных поддиректорий; сама директория остаётся в индексе
+static void dir_forget(sfs_t *fs, Dentry *d) {
+    children_drop(fs, d);
+    loaded_remove(fs, d);
+}
+
+void name_index_free(sfs_t *fs) {
+    NameIndex *ix = &fs->index;
+    for (unsigned int b = 0; ix->buckets && b <= ix->bucket_mask; b++) {
+        while (ix->buckets[b]) {
+            Dentry *d = ix->buckets[b];
+            ix->buckets[b] = d->hash_next;
+            dentry_free(fs, d);
+        }
+    }
+    if (ix->root) dentry_free(fs, ix->root);
+    free(ix->buckets);
+    free(ix->of_inode);
+    ix->root = NULL;
+    ix->buckets = NULL;
+    ix->of_inode = NULL;
+    ix->loaded = NULL;
+    ix->negatives = NULL;
+    ix->count = 0;
+}
+
+// Форматы 1 и 2 — весь индекс по directory[]; формат 3 — только корень,
+// записи которого читаются при первом обращении
+int name_index_build(sfs_t *fs) {
+    NameIndex *ix = &fs->index;
+    int inodes = fs->superblock.total_inodes;
+    unsigned int buckets = 1024;
+    while (!lazy(fs) && buckets < (unsigned int)inodes * 2) buckets <<= 1;
+
+    name_index_free(fs);
+    ix->bucket_mask = buckets - 1;
+    ix->buckets = calloc(buckets, sizeof(Dentry *));
+    ix->of_inode = calloc(inodes, sizeof(Dentry *));
+    ix->root = dentry_new(fs, 0, -1, "/", 1);
+    if (!ix->buckets || !ix->of_inode || !ix->root) {
+        name_index_free(fs);
+        return -1;
+    }
+    if (lazy(fs)) return 0;
+    ix->root->loaded = 1;
+
+    // Сначала записи, затем списки детей в порядке directory[]: родитель
+    // может стоять в таблице после своих детей
+    for (int i = 0; i < fs->layout.dirent_count; i++) {
+        int inode = fs->directory[i].inode_index;
+        if (inode <= 0 || inode >= inodes || ix->of_inode[inode]) continue;
+        Inode *node = inode_get(fs, inode);
+        Dentry *d = dentry_new(fs, inode, node ? node->directory_inode_index : -1, dirent_name(fs, i),
+                               fs->directory[i].name_length);
+        if (!d) {
+            name_index_free(fs);
+            return -1;
+        }
+        d->slot = i;
+        d->loaded = 1;
+        unsigned int h = name_hash(fs, d->parent, d->name, d->name_length);
+        d->hash_next = ix->buckets[h];
+        ix->buckets[h] = d;
+        ix->of_inode[inode] = d;
+        ix->count++;
+    }
+    for (int i = 0; i < fs->layout.dirent_count; i++) {
+        int inode = fs->directory[i].inode_index;
+        if (inode <= 0 || inode >= inodes || !ix->of_inode[inode] || ix->of_inode[inode]->slot != i) continue;
+        Dentry *p = dentry_of(fs, ix->of_inode[inode]->parent);
+        if (p) child_link(p, ix->of_inode[inode]);
+    }
+    return 0;
+}
+
+static Dentry *dir_load_locked(sfs_t *fs, int dir, int depth);
+
+// Запись inode, при необходимости с чтением директорий-предков; под index.lock на запись
+static Dentry *dentry_locked(sfs_t *fs, int inode, int depth) {
+    if (inode < 0 || inode >= fs->superblock.total_inodes) return NULL;
+    Dentry *d = dentry_of(fs, inode);
+    if (d || !lazy(fs) || depth > MAX_DIR_DEPTH) return d;
+    Inode *node = inode_get(fs, inode);
+    if (!node || !node->is_used || node->directory_inode_index == inode) return NULL;
+    if (!dir_load_locked(fs, node->directory_inode_index, depth + 1)) return NULL;
+    return dentry_of(fs, inode);
+}
+
+// Читает записи директории из её блоков; под index.lock на запись
+static Dentry *dir_load_locked(sfs_t *fs, int dir, int depth) {
+    Dentry *d = dentry_locked(fs, dir, depth);
+    if (!d || d->loaded) return d;
+    Inode *node = inode_get(fs, dir);
+    if (!node || !node->is_directory) return NULL;
+
+    ExtentList map;
+    if (inode_load_extents(fs, dir, &map) != 0) {
+        extent_list_free(&map);
+        return NULL;
+    }
+    // Пока директория читается, дети сразу попадают в её список
+    d->loaded = 1;
+    int ok = 1;
+    int logical = 0;
+    for (int j = 0; ok && j < map.count; j++) {
+        for (int k = 0; ok && k < map.items[j].length; k++, logical++) {
+            if (map.items[j].start == HOLE_BLOCK) continue;
+            int block = map.items[j].start + k;
+            const char *data = dirblock_get(fs, block, 0);
+            if (!data) {
+                ok = 0;
+                break;
+            }
+            for (int offset = 0; offset < fs->superblock.block_size; ) {
+                int inode;
+                const char *name;
+                size_t len;
+                int slots = dirblock_record(fs, data, offset, &inode, &name, &len);
+                if (slots == 0) {
+                    offset += DIRENT_V2_SLOT;
+                    continue;
+                }
+                if (!fs->index.of_inode[inode]) {
+                    Dentry *c = dentry_new(fs, inode, dir, name, len);
+                    if (!c) {
+                        ok = 0;
+                        break;
+                    }
+                    c->slot = offset;
+                    c->block = block;
+                    c->dir_block = logical;
+                    index_insert(fs, c);
+                }
+                offset += slots * DIRENT_V2_SLOT;
+            }
+        }
+    }
+    extent_list_free(&map);
+
+    if (!ok) {
+        children_drop(fs, d);
+        d->loaded = 0;
+        return NULL;
+    }
+    loaded_add(fs, d);
+    return d;
+}
+
+// Запись директории dir с прочитанными записями или NULL (не директория,
+// ошибка чтения); отмечает обращение к ней
+static Dentry *dir_loaded(sfs_t *fs, int dir) {
+    NameIndex *ix = &fs->index;
+    pthread_rwlock_rdlock(&ix->lock);
+    Dentry *d = dir >= 0 && dir < fs->superblock.total_inodes ? dentry_of(fs, dir) : NULL;
+    int ready = d && d->loaded;
+    pthread_rwlock_unlock(&ix->lock);
+    if (!ready) {
+        pthread_rwlock_wrlock(&ix->lock);
+        d = dir_load_locked(fs, dir, 0);
+        pthread_rwlock_unlock(&ix->lock);
+        if (!d) return NULL;
+    }
+    touch(fs, d);
+    return d;
+}
+
+// Номер inode с именем name в директории parent_inode или -1.
+// Длина имени хранится в записи, поэтому чужие имена той же корзины
+// обычно отсеиваются без сравнения самих имён. Запомненное отсутствие
+// имени отвечает без чтения директории.
+int name_index_lookup(sfs_t *fs, int parent_inode, const char *name) {
+    NameIndex *ix = &fs->index;
+    if (parent_inode < 0 || parent_inode >= fs->superblock.total_inodes) return -1;
+    size_t len = strnlen(name, MAX_FILENAME_LENGTH);
+    pthread_rwlock_rdlock(&ix->lock);
+    Dentry *p = dentry_of(fs, parent_inode);
+    Dentry *d = p ? hash_find(fs, parent_inode, name, len) : NULL;
+    int known = p && (p->loaded || d);
+    if (known && d) touch(fs, d);
+    int inode = d ? d->inode : -1;
+    pthread_rwlock_unlock(&ix->lock);
+    if (!known) {
+        pthread_rwlock_wrlock(&ix->lock);
+        p = dir_load_locked(fs, parent_inode, 0);
+        d = p ? hash_find(fs, parent_inode, name, len) : NULL;
+        if (p && !d && lazy(fs)) negative_add(fs, p, name, len);
+        inode = d ? d->inode : -1;
+        pthread_rwlock_unlock(&ix->lock);
+        if (!p) return -1;
+    }
+    touch(fs, p);
+    return inode;
+}
+
+// Имя inode в его директории или NULL, если записи нет. Строка живёт до
+// конца операции.
+const char *name_index_name(sfs_t *fs, int inode) {
+    NameIndex *ix = &fs->index;
+    if (inode < 0 || inode >= fs->superblock.total_inodes) return NULL;
+    pthread_rwlock_rdlock(&ix->lock);
+    Dentry *d = dentry_of(fs, inode);
+    pthread_rwlock_unlock(&ix->lock);
+    if (!d && lazy(fs)) {
+        pthread_rwlock_wrlock(&ix->lock);
+        d = dentry_locked(fs, inode, 0);
+        pthread_rwlock_unlock(&ix->lock);
+    }
+    return d ? d->name : NULL;
+}
+
+// Полный путь inode по цепочке родителей: O(глубины), без поиска по
+// директориям. Длинный путь обрезается по path_size. Возвращает SFS_OK
+// или SFS_ERR_NOENT, если у inode нет имени.
+int name_index_path(sfs_t *fs, int inode, char *path, size_t path_size) {
+    NameIndex *ix = &fs->index;
+    if (path_size == 0) return SFS_ERR_INVAL;
+    if (inode == 0) {
+        snprintf(path, path_size, "/");
+        return SFS_OK;
+    }
+    // Запись inode есть — есть и записи всех его предков
+    if (!name_index_name(fs, inode)) return SFS_ERR_NOENT;
+
+    Dentry *chain[MAX_DIR_DEPTH];
+    int depth = 0;
+    pthread_rwlock_rdlock(&ix->lock);
+    for (Dentry *d = dentry_of(fs, inode); d && d != ix->root; d = dentry_of(fs, d->parent)) {
+        if (depth == MAX_DIR_DEPTH) {
+            pthread_rwlock_unlock(&ix->lock);
+            return SFS_ERR_NOENT;
+        }
+        chain[depth++] = d;
+    }
+    pthread_rwlock_unlock(&ix->lock);
+
+    size_t pos = 0;
+    path[0] = '\0';
+    while (depth > 0 && pos + 1 < path_size) {
+        Dentry *d = chain[--depth];
+        path[pos++] = '/';
+        size_t n = d->name_length;
+        if (n > path_size - 1 - pos) n = path_size - 1 - pos;
+        memcpy(path + pos, d->name, n);
+        pos += n;
+    }
+    path[pos] = '\0';
+    return SFS_OK;
+}
+
+// Место под запись d в блоках директории p (формат 3). Блоки до
+// p->free_block заняты; подсказка сдвигается, когда в блоке не нашлось
+// места, и возвращается назад при удалении записи. Если места нет,
+// директория получает новый блок.
+static int dirblock_place(sfs_t *fs, Dentry *p, Dentry *d) {
+    int slots = dirent_slots(fs, d->name_length);
+    ExtentList map;
+    if (inode_load_extents(fs, p->inode, &map) != 0) {
+        extent_list_free(&map);
+        return SFS_ERR_IO;
+    }
+    int logical = 0;
+    int block = -1, offset = -1;
+    char *data = NULL;
+    for (int j = 0; offset < 0 && j < map.count; j++) {
+        for (int k = 0; k < map.items[j].length; k++, logical++) {
+            if (logical < p->free_block || map.items[j].start == HOLE_BLOCK) continue;
+            data = dirblock_get(fs, map.items[j].start + k, 0);
+            if (!data) {
+                extent_list_free(&map);
+                return SFS_ERR_IO;
+            }
+            offset = dirblock_find_free(fs, data, slots);
+            if (offset >= 0) {
+                block = map.items[j].start + k;
+                break;
+            }
+            p->free_block = logical + 1;
+        }
+    }
+
+    if (offset < 0) {
+        block = allocate_block(fs);
+        if (block == -1) {
+            extent_list_free(&map);
+            return SFS_ERR_NOSPC;
+        }
+        data = dirblock_get(fs, block, 1);
+        if (!data || extent_append(&map, block, 1) != 0 || inode_store_extents(fs, p->inode, &map) != 0) {
+            if (data) dirblock_release(fs, block);
+            free_block(fs, block);
+            extent_list_free(&map);
+            return data ? SFS_ERR_NOSPC : SFS_ERR_NOMEM;
+        }
+        offset = 0;
+        logical = inode_get(fs, p->inode)->block_count - 1;
+    }
+    extent_list_free(&map);
+
+    dirblock_set(fs, data, offset, d->inode, d->name, d->name_length);
+    dirblock_dirty(fs, block, offset, slots * DIRENT_V2_SLOT);
+    d->block = block;
+    d->slot = offset;
+    d->dir_block = logical;
+    return SFS_OK;
+}
+
+// Стирает запись d в образе; в формате 3 — в блоке её директории
+static void record_erase(sfs_t *fs, Dentry *d) {
+    if (!lazy(fs)) {
+        dirent_clear(fs, d->slot);
+        return;
+    }
+    char *data = dirblock_get(fs, d->block, 0);
+    if (data) {
+        int slots = dirblock_clear(fs, data, d->slot);
+        dirblock_dirty(fs, d->block, d->slot, slots * DIRENT_V2_SLOT);
+    }
+    Dentry *p = dentry_of(fs, d->parent);
+    if (p && d->dir_block < p->free_block) p->free_block = d->dir_block;
+}
+
+// Добавляет в директорию parent_inode запись inode с именем name; поля
+// inode уже заполнены. Под ns_lock на запись. Возвращает SFS_OK или код
+// ошибки: нет места под запись — SFS_ERR_NOINODE (directory[] заполнена)
+// или SFS_ERR_NOSPC (нет блока под директорию).
+int dir_link(sfs_t *fs, int parent_inode, int inode, const char *name) {
+    size_t len = strnlen(name, MAX_FILENAME_LENGTH - 1);
+    Dentry *p = dir_loaded(fs, parent_inode);
+    if (!p) return SFS_ERR_IO;
+    Dentry *d = dentry_new(fs, inode, parent_inode, name, len);
+    if (!d) return SFS_ERR_NOMEM;
+
+    if (!lazy(fs)) {
+        d->slot = find_free_dir_entry(fs, name);
+        if (d->slot == -1) {
+            dentry_free(fs, d);
+            return SFS_ERR_NOINODE;
+        }
+        dirent_set(fs, d->slot, inode, name);
+        d->loaded = 1;
+    } else {
+        int r = dirblock_place(fs, p, d);
+        if (r != SFS_OK) {
+            dentry_free(fs, d);
+            return r;
+        }
+    }
+    index_insert(fs, d);
+
+    // Новая директория пуста: читать её блоки незачем
+    Inode *node = inode_get(fs, inode);
+    if (lazy(fs) && node->is_directory && node->block_count == 0) loaded_add(fs, d);
+    return SFS_OK;
+}
+
+// Удаляет запись inode из его директории; у директории записей в ней уже нет
+void dir_unlink(sfs_t *fs, int inode) {
+    Dentry *d = dentry_of(fs, inode);
+    if (!d || d == fs->index.root) return;
+    record_erase(fs, d);
+    negatives_drop(fs, d);
+    if (d->loaded && lazy(fs)) {
+        dir_forget(fs, d);
+    }
+    index_remove(fs, d);
+    dentry_free(fs, d);
+}
+
+// Удаляет записи всех детей директории разом (рекурсивное удаление, дети
+// уже освобождены). В формате 3 записи в блоках не стираются: блоки уходят
+// вместе с директорией.
+void dir_unlink_children(sfs_t *fs, int dir_inode) {
+    Dentry *d = dentry_of(fs, dir_inode);
+    if (!d) return;
+    if (!lazy(fs)) {
+        for (Dentry *c = d->first_child; c; c = c->next_sibling) dirent_clear(fs, c->slot);
+    }
+    children_drop(fs, d);
+    loaded_remove(fs, d);
+}
+
+// Переносит запись inode с тем же именем в директорию new_parent
+int dir_relink(sfs_t *fs, int inode, int new_parent) {
+    Dentry *d = dentry_of(fs, inode);
+    Dentry *p = dir_loaded(fs, new_parent);
+    if (!d || d == fs->index.root) return SFS_ERR_NOENT;
+    if (!p) return SFS_ERR_IO;
+
+    if (lazy(fs)) {
+        // Сначала новая запись: если для неё нет места, старая остаётся
+        Dentry old = *d;
+        int r = dirblock_place(fs, p, d);
+        if (r != SFS_OK) return r;
+        record_erase(fs, &old);
+    }
+    index_remove(fs, d);
+    d->parent = new_parent;
+    index_insert(fs, d);
+
+    inode_get(fs, inode)->directory_inode_index = new_parent;
+    mark_inode_dirty(fs, inode);
+    return SFS_OK;
+}
+
+// Удаляемая директория отдаёт блоки (формат 3): кадры выбрасываются,
+// а старые записи блоков в журнале отменяются. Сами блоки освобождает
+// inode_free_blocks.
+void dir_release_blocks(sfs_t *fs, int dir_inode) {
+    if (!lazy(fs)) return;
+    ExtentList map;
+    if (inode_load_extents(fs, dir_inode, &map) == 0) {
+        for (int j = 0; j < map.count; j++) {
+            if (map.items[j].start == HOLE_BLOCK) continue;
+            for (int k = 0; k < map.items[j].length; k++) {
+                dirblock_release(fs, map.items[j].start + k);
+            }
+        }
+    }
+    extent_list_free(&map);
+}
+
+static int cmp_used(const void *a, const void *b) {
+    unsigned int x = (*(Dentry *const *)a)->used, y = (*(Dentry *const *)b)->used;
+    return (x > y) - (x < y);
+}
+
+// Выбрасывает прочитанные директории, не тронутые в завершившейся группе,
+// начиная с самых давних, пока кэш метаданных не станет меньше target.
+// Директория с прочитанными поддиректориями ждёт, пока не выбросят их.
+// Запомненные отсутствующие имена берегут от повторного чтения целой
+// директории и уходят последними.
+void name_index_trim(sfs_t *fs, long target) {
+    NameIndex *ix = &fs->index;
+    if (!lazy(fs)) return;
+    int progress = 1;
+    while (progress && fs->mcache.bytes > target) {
+        progress = 0;
+        long count = 0;
+        for (Dentry *d = ix->loaded; d; d = d->next_loaded) count++;
+        Dentry **victims = malloc(sizeof(Dentry *) * (count > 0 ? count : 1));
+        if (!victims) return;
+        count = 0;
+        for (Dentry *d = ix->loaded; d; d = d->next_loaded) {
+            if (d != ix->root && d->loaded_dirs == 0 && d->used != fs->mcache.epoch) victims[count++] = d;
+        }
+        qsort(victims, count, sizeof(Dentry *), cmp_used);
+        for (long i = 0; i < count && fs->mcache.bytes > target; i++) {
+            dir_forget(fs, victims[i]);
+            progress = 1;
+        }
+        free(victims);
+    }
+    if (fs->mcache.bytes <= target) return;
+
+    long count = 0;
+    for (Dentry *n = ix->negatives; n; n = n->next_loaded) count++;
+    Dentry **victims = malloc(sizeof(Dentry *) * (count > 0 ? count : 1));
+    if (!victims) return;
+    count = 0;
+    for (Dentry *n = ix->negatives; n; n = n->next_loaded) {
+        if (n->used != fs->mcache.epoch) victims[count++] = n;
+    }
+    qsort(victims, count, sizeof(Dentry *), cmp_used);
+    for (long i = 0; i < count && fs->mcache.bytes > target; i++) {
+        negative_remove(fs, dentry_of(fs, victims[i]->parent), victims[i]);
+    }
+    free(victims);
+}
+
+// Записи директории прочитаны; 0 — не директория или ошибка чтения
+int dir_ready(sfs_t *fs, int dir_inode) {
+    return dir_loaded(fs, dir_inode) != NULL;
+}
+
+// Обход детей директории: for (c = dir_first_child(d); c != -1; c = dir_next_child(c))
+int dir_first_child(sfs_t *fs, int dir_inode) {
+    Dentry *d = dir_loaded(fs, dir_inode);
+    return d && d->first_child ? d->first_child->inode : -1;
+}
+
+int dir_next_child(sfs_t *fs, int inode) {
+    Dentry *d = dentry_of(fs, inode);
+    return d && d->next_sibling ? d->next_sibling->inode : -1;
+}
@@ -0,0 +1,168 @@
+#define _GNU_SOURCE  // fallocate, FALLOC_FL_PUNCH_HOLE
+#include "sfs.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Доступ к образу. Все чтения и записи метаданных и блоков идут через
+// disk_read/disk_write по абсолютному смещению в образе.
+// IO_STDIO — pread/pwrite по дескриптору образа (запасной вариант): без общей
+// позиции файла, поэтому обращения из разных потоков не мешают друг другу.
+// IO_MMAP — образ целиком отображается в память, данные копируются прямо
+// из отображения без буферов stdio и системных вызовов на каждый блок;
+// устойчивость — msync только изменённого диапазона страниц.
+// IO_URING — одиночные обращения как у IO_STDIO, а пакеты (disk_*_batch)
+// уходят в кольцо io_uring одним системным вызовом на queue_depth запросов.
+// До io_attach и после io_detach всегда работает IO_STDIO.
+
+static long page_size() {
+    static long size = 0;
+    if (size == 0) size = sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+// Подключает выбранный механизм к открытому образу; вызывается после compute_layout.
+// Если механизм недоступен, остаётся IO_STDIO.
+int io_attach(sfs_t *fs, int requested, int queue_depth) {
+    IoState *io = &fs->io;
+    io_detach(fs);
+    if (requested == IO_URING) {
+        io->ring = uring_open(queue_depth > 0 ? queue_depth : DEFAULT_QUEUE_DEPTH);
+        if (!io->ring) return -1;
+        io->backend = IO_URING;
+        return 0;
+    }
+    if (requested != IO_MMAP) return 0;
+
+    int fd = io->fd;
+    size_t size = fs->layout.data_offset + (size_t)fs->superblock.total_blocks * fs->superblock.block_size;
+
+    // Блоки данных могли быть ещё не записаны: дотягиваем файл (без выделения места)
+    struct stat st;
+    if (fstat(fd, &st) != 0) return -1;
+    if ((size_t)st.st_size < size && ftruncate(fd, size) != 0) return -1;
+
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return -1;
+
+    io->map = p;
+    io->map_size = size;
+    io->dirty_lo = io->dirty_hi = 0;
+    io->backend = IO_MMAP;
+    return 0;
+}
+
+void io_detach(sfs_t *fs) {
+    IoState *io = &fs->io;
+    if (io->backend == IO_MMAP) {
+        disk_sync(fs);
+        munmap(io->map, io->map_size);
+        io->map = NULL;
+        io->map_size = 0;
+    }
+    uring_close(io->ring);
+    io->ring = NULL;
+    io->backend = IO_STDIO;
+}
+
+int disk_read(sfs_t *fs, void *buf, size_t len, long offset) {
+    IoState *io = &fs->io;
+    if (io->backend == IO_MMAP) {
+        if (offset < 0 || (size_t)offset + len > io->map_size) return -1;
+        memcpy(buf, io->map + offset, len);
+        return 0;
+    }
+    // Блоки данных за концом файла ещё не записывались и читаются как нули
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = pread(io->fd, (char *)buf + got, len - got, offset + got);
+        if (n < 0) return -1;
+        if (n == 0) {
+            memset((char *)buf + got, 0, len - got);
+            break;
+        }
+        got += n;
+    }
+    return 0;
+}
+
+int disk_write(sfs_t *fs, const void *buf, size_t len, long offset) {
+    IoState *io = &fs->io;
+    if (io->backend == IO_MMAP) {
+        if (offset < 0 || (size_t)offset + len > io->map_size) return -1;
+        memcpy(io->map + offset, buf, len);
+        pthread_mutex_lock(&io->dirty_lock);
+        if (io->dirty_hi == io->dirty_lo) {
+            io->dirty_lo = offset;
+            io->dirty_hi = offset + len;
+        } else {
+            if ((size_t)offset < io->dirty_lo) io->dirty_lo = offset;
+            if ((size_t)offset + len > io->dirty_hi) io->dirty_hi = offset + len;
+        }
+        pthread_mutex_unlock(&io->dirty_lock);
+        return 0;
+    }
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pwrite(io->fd, (const char *)buf + done, len - done, offset + done);
+        if (n <= 0) return -1;
+        done += n;
+    }
+    return 0;
+}
+
+// Пакет участков: для IO_URING — одним заходом в кольцо, иначе по одному
+int disk_read_batch(sfs_t *fs, DiskRequest *reqs, int count) {
+    if (fs->io.backend == IO_URING) return uring_submit_batch(fs, fs->io.ring, reqs, count, 0);
+    for (int i = 0; i < count; i++) {
+        if (disk_read(fs, reqs[i].buf, reqs[i].len, reqs[i].offset) != 0) return -1;
+    }
+    return 0;
+}
+
+int disk_write_batch(sfs_t *fs, DiskRequest *reqs, int count) {
+    if (fs->io.backend == IO_URING) return uring_submit_batch(fs, fs->io.ring, reqs, count, 1);
+    for (int i = 0; i < count; i++) {
+        if (disk_write(fs, reqs[i].buf, reqs[i].len, reqs[i].offset) != 0) return -1;
+    }
+    return 0;
+}
+
+// Отдаёт хосту место участка образа: участок становится дырой и читается
+// как нули, размер файла не меняется. -1, если хост дыр не поддерживает —
+// тогда участок просто остаётся как есть.
+int disk_discard(sfs_t *fs, long offset, size_t len) {
+    return fallocate(fs->io.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, len) == 0 ? 0 : -1;
+}
+
+static void msync_range(IoState *io, size_t lo, size_t hi) {
+    size_t start = lo / page_size() * page_size();
+    if (hi > start) msync(io->map + start, hi - start, MS_SYNC);
+}
+
+// Делает устойчивым участок образа (для stdio — весь файл)
+void disk_sync_range(sfs_t *fs, long offset, size_t len) {
+    if (fs->io.backend == IO_MMAP) {
+        msync_range(&fs->io, offset, offset + len);
+    } else {
+        fdatasync(fs->io.fd);
+    }
+    fs->meta.stats.syncs++;
+}
+
+// Делает устойчивыми все записи с прошлого disk_sync
+void disk_sync(sfs_t *fs) {
+    IoState *io = &fs->io;
+    if (io->backend == IO_MMAP) {
+        pthread_mutex_lock(&io->dirty_lock);
+        size_t lo = io->dirty_lo, hi = io->dirty_hi;
+        io->dirty_lo = io->dirty_hi = 0;
+        pthread_mutex_unlock(&io->dirty_lock);
+        if (hi > lo) msync_range(io, lo, hi);
+    } else {
+        fsync(io->fd);
+    }
+    fs->meta.stats.syncs++;
+}
@@ -0,0 +1,241 @@
+#include "sfs.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+// Журнал метаданных (redo). Область layout.journal_size байт между таблицей
+// directory[] и блоками данных. Каждая группа операций записывается
+// в хвост журнала одной транзакцией: заголовок + записи (смещение, длина,
+// данные), одна запись и один fsync. Транзакции идут подряд с номерами
+// seq, seq+1, ...; если группа не помещается в остаток журнала, то перед
+// её записью изменения прошлых групп, уже переписанные на место, делаются
+// устойчивыми (fsync) и журнал начинается сначала. Больше журнала группа
+// не бывает: операции коммитят её раньше (meta_group_full).
+// При монтировании применяются все целые транзакции с начала журнала.
+// Пустой журнал хранит в заголовке (magic = 0) следующий номер seq, чтобы
+// номера росли между монтированиями и старые транзакции не применялись.
+// Запись-отмена (участок с data == NULL) без данных говорит, что блок
+// освобождён: записи этого блока из более ранних транзакций не применяются,
+// ведь блок мог уже достаться файлу, данные которого пишутся мимо журнала.
+
+#define JOURNAL_MAGIC 0x4A534653  // "SFSJ"
+#define JOURNAL_REVOKE 1          // запись-отмена блока, данных за ней нет
+
+typedef struct {
+    uint32_t magic;
+    uint32_t checksum;   // по всей транзакции при checksum = 0
+    uint64_t seq;
+    uint32_t length;     // длина транзакции вместе с заголовком
+    uint32_t record_count;
+} JournalHeader;
+
+typedef struct {
+    int64_t offset;      // куда в образе относятся данные
+    uint32_t len;
+    uint32_t flags;      // JOURNAL_REVOKE
+} JournalRecord;
+
+int journal_init(sfs_t *fs) {
+    journal_free(fs);
+    fs->journal.seq = 1;
+    fs->journal.buf = malloc(fs->layout.journal_size);
+    return fs->journal.buf ? 0 : -1;
+}
+
+void journal_free(sfs_t *fs) {
+    free(fs->journal.buf);
+    fs->journal.buf = NULL;
+    fs->journal.tail = 0;
+}
+
+static uint32_t journal_checksum(const char *buf, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)buf[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Делает устойчивыми уже переписанные на место изменения и освобождает журнал
+static void journal_wrap(sfs_t *fs) {
+    disk_sync(fs);
+    fs->journal.tail = 0;
+}
+
+static void journal_write_txn(sfs_t *fs, size_t used, uint32_t record_count) {
+    JournalHeader *h = (JournalHeader *)fs->journal.buf;
+    h->magic = JOURNAL_MAGIC;
+    h->checksum = 0;
+    h->seq = fs->journal.seq++;
+    h->length = used;
+    h->record_count = record_count;
+    h->checksum = journal_checksum(fs->journal.buf, used);
+
+    disk_write(fs, fs->journal.buf, used, fs->layout.journal_offset + fs->journal.tail);
+    disk_sync_range(fs, fs->layout.journal_offset + fs->journal.tail, used);
+
+    fs->journal.tail += used;
+    fs->meta.stats.journal_bytes += used;
+    fs->meta.stats.journal_commits++;
+}
+
+// Размер группы, записанной одной транзакцией
+static size_t journal_group_size(const MetaRegion *regions, int count) {
+    size_t size = sizeof(JournalHeader);
+    for (int i = 0; i < count; i++) {
+        if (!regions[i].data) {
+            size += sizeof(JournalRecord);
+        } else if (regions[i].len > 0) {
+            size += sizeof(JournalRecord) + regions[i].len;
+        }
+    }
+    return size;
+}
+
+// Записывает участки группы одной транзакцией. Группу больше журнала
+// записать атомарно нельзя — тогда SFS_ERR_NOSPC и журнал не тронут.
+int journal_commit(sfs_t *fs, const MetaRegion *regions, int count) {
+    size_t need = journal_group_size(regions, count);
+    if (need == sizeof(JournalHeader)) return SFS_OK;
+    if (need > (size_t)fs->layout.journal_size) return SFS_ERR_NOSPC;
+    if (need > (size_t)(fs->layout.journal_size - fs->journal.tail)) journal_wrap(fs);
+
+    size_t used = sizeof(JournalHeader);
+    uint32_t records = 0;
+    for (int i = 0; i < count; i++) {
+        int revoke = regions[i].data == NULL;
+        size_t len = revoke ? 0 : regions[i].len;
+        if (!revoke && len == 0) continue;
+
+        JournalRecord r = {regions[i].offset, regions[i].len, revoke ? JOURNAL_REVOKE : 0};
+        memcpy(fs->journal.buf + used, &r, sizeof(r));
+        if (len > 0) memcpy(fs->journal.buf + used + sizeof(r), regions[i].data, len);
+        used += sizeof(r) + len;
+        records++;
+    }
+    journal_write_txn(fs, used, records);
+    return SFS_OK;
+}
+
+typedef struct {
+    long block;
+    uint64_t seq;
+} Revoke;
+
+static int cmp_revoke(const void *a, const void *b) {
+    const Revoke *x = a, *y = b;
+    if (x->block != y->block) return (x->block > y->block) - (x->block < y->block);
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+// Блок тома, к которому относится смещение, или -1 вне области данных
+static long record_block(sfs_t *fs, long offset) {
+    if (offset < fs->layout.data_offset) return -1;
+    return (offset - fs->layout.data_offset) / fs->superblock.block_size;
+}
+
+// Отменена ли запись блока block из транзакции seq более поздней отменой
+static int revoked_after(const Revoke *revokes, int count, long block, uint64_t seq) {
+    int lo = 0, hi = count;
+    while (lo < hi) {  // первая отмена с блоком больше block
+        int mid = (lo + hi) / 2;
+        if (revokes[mid].block <= block) lo = mid + 1; else hi = mid;
+    }
+    return lo > 0 && revokes[lo - 1].block == block && revokes[lo - 1].seq > seq;
+}
+
+// Применяет целые транзакции журнала к образу; возвращает их число или
+// SFS_ERR_NOMEM — тогда журнал не тронут и монтировать образ нельзя.
+// Первый проход проверяет транзакции, читая их в буфер журнала на свои
+// места, и собирает отмены; второй применяет записи, которые не отменены.
+int journal_replay(sfs_t *fs) {
+    long base = fs->layout.journal_offset;
+    long pos = 0;
+    uint64_t expected_seq = 0;
+    int applied = 0;
+    Revoke *revokes = NULL;
+    int revoke_count = 0, revoke_capacity = 0;
+
+    while (pos + (long)sizeof(JournalHeader) <= fs->layout.journal_size) {
+        JournalHeader h;
+        if (disk_read(fs, &h, sizeof(h), base + pos) != 0) break;
+        if (pos == 0 && h.magic == 0 && h.seq > fs->journal.seq) {
+            fs->journal.seq = h.seq;  // журнал пуст, продолжаем нумерацию
+        }
+        if (h.magic != JOURNAL_MAGIC || h.length < sizeof(h) || pos + h.length > fs->layout.journal_size) break;
+        if (applied > 0 && h.seq != expected_seq) break;
+
+        char *txn = fs->journal.buf + pos;
+        if (disk_read(fs, txn, h.length, base + pos) != 0) break;
+        uint32_t checksum = h.checksum;
+        ((JournalHeader *)txn)->checksum = 0;
+        if (journal_checksum(txn, h.length) != checksum) break;
+
+        size_t p = sizeof(JournalHeader);
+        for (uint32_t i = 0; i < h.record_count; i++) {
+            JournalRecord r;
+            memcpy(&r, txn + p, sizeof(r));
+            if (r.flags & JOURNAL_REVOKE) {
+                if (revoke_count == revoke_capacity) {
+                    int capacity = revoke_capacity ? revoke_capacity * 2 : 64;
+                    Revoke *grown = realloc(revokes, sizeof(Revoke) * capacity);
+                    if (!grown) {
+                        // Без всех отмен применять журнал нельзя: старые
+                        // записи затёрли бы данные в переиспользованных блоках
+                        free(revokes);
+                        return SFS_ERR_NOMEM;
+                    }
+                    revokes = grown;
+                    revoke_capacity = capacity;
+                }
+                revokes[revoke_count].block = record_block(fs, r.offset);
+                revokes[revoke_count].seq = h.seq;
+                revoke_count++;
+                p += sizeof(r);
+            } else {
+                p += sizeof(r) + r.len;
+            }
+        }
+
+        expected_seq = h.seq + 1;
+        if (expected_seq > fs->journal.seq) fs->journal.seq = expected_seq;
+        pos += h.length;
+        applied++;
+    }
+    if (revoke_count > 0) qsort(revokes, revoke_count, sizeof(Revoke), cmp_revoke);
+
+    pos = 0;
+    for (int t = 0; t < applied; t++) {
+        JournalHeader h;
+        memcpy(&h, fs->journal.buf + pos, sizeof(h));
+        size_t p = pos + sizeof(JournalHeader);
+        for (uint32_t i = 0; i < h.record_count; i++) {
+            JournalRecord r;
+            memcpy(&r, fs->journal.buf + p, sizeof(r));
+            p += sizeof(r);
+            if (r.flags & JOURNAL_REVOKE) continue;
+            if (!revoked_after(revokes, revoke_count, record_block(fs, r.offset), h.seq)) {
+                disk_write(fs, fs->journal.buf + p, r.len, r.offset);
+            }
+            p += r.len;
+        }
+        pos += h.length;
+    }
+    free(revokes);
+
+    journal_clear(fs);
+    return applied;
+}
+
+// Помечает журнал пустым; вызывается, когда все изменения уже на месте.
+// Сначала они делаются устойчивыми: иначе пустой заголовок мог бы попасть
+// на диск раньше метаданных, которые журнал ещё защищает.
+void journal_clear(sfs_t *fs) {
+    disk_sync(fs);
+    JournalHeader empty;
+    memset(&empty, 0, sizeof(empty));
+    empty.seq = fs->journal.seq;
+    disk_write(fs, &empty, sizeof(empty), fs->layout.journal_offset);
+    disk_sync(fs);
+    fs->journal.tail = 0;
+}
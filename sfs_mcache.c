@@ -0,0 +1,412 @@
+#include "sfs.h"
+#include <stdlib.h>
+
+// Кэш метаданных. Таблица inode читается страницами по INODE_PAGE inode
+// при первом обращении к любому из них; блоки директорий формата 3 — по
+// блоку. Монтирование поэтому не читает таблиц, а память растёт с рабочим
+// набором, а не с размером образа.
+//
+// Страница хранит inode в памяти и их копию в формате образа, в которую
+// изменённые inode кодируются при коммите группы и откуда участками уходят
+// в журнал. Записи директорий меняются прямо в кадре блока, изменённый
+// диапазон кадра — тоже участок группы.
+//
+// Предел памяти мягкий: лишнее выбрасывается в конце коммита группы
+// (mcache_trim), когда ns_lock взят на запись, ни одна операция не держит
+// указателей на inode или кадры, а изменённого в кэше не осталось.
+// Выбрасывается давно не нужное: сначала кадры блоков, записи которых уже
+// в индексе имён, затем страницы inode, затем прочитанные директории.
+// Загрузка идёт и под ns_lock на чтение, поэтому указатель страницы
+// публикуется атомарно, а загрузки и таблица кадров — под mcache.lock.
+
+struct InodePage {
+    unsigned int used;              // эпоха последнего обращения
+    Inode inodes[INODE_PAGE];
+    char raw[];                     // те же inode в формате образа
+};
+
+struct MetaBlock {
+    int block;
+    int dirty_lo, dirty_hi;         // изменённые байты; пусто — кадр чистый
+    unsigned int used;
+    MetaBlock *hash_next;
+    MetaBlock *dirty_next;
+    char data[];
+};
+
+static size_t page_bytes(sfs_t *fs) {
+    return sizeof(InodePage) + (size_t)fs->layout.inode_size * INODE_PAGE;
+}
+
+static size_t frame_bytes(sfs_t *fs) {
+    return sizeof(MetaBlock) + fs->superblock.block_size;
+}
+
+void mcache_account(sfs_t *fs, long bytes) {
+    __atomic_add_fetch(&fs->mcache.bytes, bytes, __ATOMIC_RELAXED);
+}
+
+void mcache_free(sfs_t *fs) {
+    MetaCache *mc = &fs->mcache;
+    for (int p = 0; mc->pages && p < mc->page_count; p++) {
+        free(mc->pages[p]);
+    }
+    for (unsigned int b = 0; mc->buckets && b <= mc->bucket_mask; b++) {
+        while (mc->buckets[b]) {
+            MetaBlock *f = mc->buckets[b];
+            mc->buckets[b] = f->hash_next;
+            free(f);
+        }
+    }
+    free(mc->pages);
+    free(mc->buckets);
+    mc->pages = NULL;
+    mc->buckets = NULL;
+    mc->page_count = 0;
+    mc->block_count = 0;
+    mc->dirty = NULL;
+    mc->dirty_bytes = 0;
+    mc->bytes = 0;
+}
+
+// Таблица страниц — по указателю на страницу; сами страницы не выделяются
+int mcache_init(sfs_t *fs, int limit_kb) {
+    MetaCache *mc = &fs->mcache;
+    mcache_free(fs);
+    mc->page_count = (fs->superblock.total_inodes + INODE_PAGE - 1) / INODE_PAGE;
+    mc->pages = calloc(mc->page_count, sizeof(InodePage *));
+    mc->bucket_mask = 255;
+    mc->buckets = calloc(mc->bucket_mask + 1, sizeof(MetaBlock *));
+    mc->limit = (long)(limit_kb > 0 ? limit_kb : DEFAULT_META_CACHE_KB) * 1024;
+    mc->high = mc->limit;
+    if (!mc->pages || !mc->buckets) {
+        mcache_free(fs);
+        return -1;
+    }
+    return 0;
+}
+
+// Читает страницу page таблицы inode, если её ещё никто не прочитал
+static InodePage *page_load(sfs_t *fs, int page) {
+    MetaCache *mc = &fs->mcache;
+    const Layout *l = &fs->layout;
+    pthread_mutex_lock(&mc->lock);
+    InodePage *p = mc->pages[page];
+    if (!p) {
+        int first = page * INODE_PAGE;
+        int count = fs->superblock.total_inodes - first < INODE_PAGE ? fs->superblock.total_inodes - first : INODE_PAGE;
+        p = calloc(1, page_bytes(fs));
+        if (p && disk_read(fs, p->raw, (size_t)l->inode_size * count, inode_offset(fs, first)) != 0) {
+            free(p);
+            p = NULL;
+        }
+        if (p) {
+            for (int i = 0; i < count; i++) {
+                inode_decode(l, p->raw + (long)l->inode_size * i, &p->inodes[i]);
+            }
+            p->used = mc->epoch;
+            mcache_account(fs, page_bytes(fs));
+            __atomic_store_n(&mc->pages[page], p, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&mc->lock);
+    return p;
+}
+
+// Inode по номеру; NULL — номер вне таблицы или страницу не прочитать.
+// Указатель действителен до конца операции: страницы выбрасываются только
+// при коммите группы.
+Inode *inode_get(sfs_t *fs, int inode) {
+    MetaCache *mc = &fs->mcache;
+    if (inode < 0 || inode >= fs->superblock.total_inodes) return NULL;
+    InodePage *p = __atomic_load_n(&mc->pages[inode / INODE_PAGE], __ATOMIC_ACQUIRE);
+    if (!p) {
+        p = page_load(fs, inode / INODE_PAGE);
+        if (!p) return NULL;
+    }
+    // Эпоха меняется только под ns_lock на запись; отметку пишем, лишь когда она устарела
+    if (__atomic_load_n(&p->used, __ATOMIC_RELAXED) != mc->epoch) {
+        __atomic_store_n(&p->used, mc->epoch, __ATOMIC_RELAXED);
+    }
+    return &p->inodes[inode % INODE_PAGE];
+}
+
+// Первый свободный inode страницы page с позиции from в ней или -1.
+// Страницу не из кэша просматриваем во временном буфере, не загружая:
+// поиск свободного inode не должен вытеснять рабочий набор.
+int inode_page_find_free(sfs_t *fs, int page, int from) {
+    const Layout *l = &fs->layout;
+    int first = page * INODE_PAGE;
+    int count = fs->superblock.total_inodes - first < INODE_PAGE ? fs->superblock.total_inodes - first : INODE_PAGE;
+    InodePage *p = __atomic_load_n(&fs->mcache.pages[page], __ATOMIC_ACQUIRE);
+    if (p) {
+        for (int i = from; i < count; i++) {
+            if (!p->inodes[i].is_used) return first + i;
+        }
+        return -1;
+    }
+
+    char raw[INODE_PAGE * sizeof(InodeV1)];
+    if (disk_read(fs, raw, (size_t)l->inode_size * count, inode_offset(fs, first)) != 0) return -1;
+    for (int i = from; i < count; i++) {
+        Inode inode;
+        inode_decode(l, raw + (long)l->inode_size * i, &inode);
+        if (!inode.is_used) return first + i;
+    }
+    return -1;
+}
+
+static int cmp_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Кодирует изменённые inode в копии их страниц и добавляет участки
+// в группу, склеивая соседние inode одной страницы
+void inode_collect_dirty(sfs_t *fs, int *list, int count) {
+    const Layout *l = &fs->layout;
+    qsort(list, count, sizeof(int), cmp_int);
+    for (int i = 0; i < count; ) {
+        int page = list[i] / INODE_PAGE;
+        InodePage *p = fs->mcache.pages[page];
+        int j = i;
+        do {
+            if (p) inode_encode(l, &p->inodes[list[j] % INODE_PAGE], p->raw + (long)l->inode_size * (list[j] % INODE_PAGE));
+            j++;
+        } while (j < count && list[j] == list[j - 1] + 1 && list[j] / INODE_PAGE == page);
+        // Изменённый inode всегда в памяти: страницы выбрасываются после коммита
+        if (p) {
+            meta_add_region(fs, inode_offset(fs, list[i]), p->raw + (long)l->inode_size * (list[i] % INODE_PAGE),
+                            (size_t)l->inode_size * (j - i));
+        }
+        i = j;
+    }
+}
+
+// Кадры блоков директорий (формат 3)
+
+static unsigned int block_hash(MetaCache *mc, int block) {
+    return ((unsigned int)block * 2654435761u) & mc->bucket_mask;
+}
+
+static MetaBlock *frame_find(MetaCache *mc, int block) {
+    for (MetaBlock *f = mc->buckets[block_hash(mc, block)]; f; f = f->hash_next) {
+        if (f->block == block) return f;
+    }
+    return NULL;
+}
+
+// Вдвое больше корзин, когда кадров стало вдвое больше корзин
+static void frames_grow(MetaCache *mc) {
+    unsigned int buckets = (mc->bucket_mask + 1) * 2;
+    MetaBlock **table = calloc(buckets, sizeof(MetaBlock *));
+    if (!table) return;
+    unsigned int old_mask = mc->bucket_mask;
+    MetaBlock **old = mc->buckets;
+    mc->buckets = table;
+    mc->bucket_mask = buckets - 1;
+    for (unsigned int b = 0; b <= old_mask; b++) {
+        while (old[b]) {
+            MetaBlock *f = old[b];
+            old[b] = f->hash_next;
+            unsigned int h = block_hash(mc, f->block);
+            f->hash_next = table[h];
+            table[h] = f;
+        }
+    }
+    free(old);
+}
+
+// op_end читает dirty_bytes без mcache.lock
+static void dirty_account(MetaCache *mc, long delta) {
+    __atomic_add_fetch(&mc->dirty_bytes, delta, __ATOMIC_RELAXED);
+}
+
+static void frame_mark_dirty(MetaCache *mc, MetaBlock *f, int offset, int len) {
+    if (f->dirty_lo >= f->dirty_hi) {
+        f->dirty_lo = offset;
+        f->dirty_hi = offset + len;
+        f->dirty_next = mc->dirty;
+        mc->dirty = f;
+        dirty_account(mc, len);
+        return;
+    }
+    int span = f->dirty_hi - f->dirty_lo;
+    if (offset < f->dirty_lo) f->dirty_lo = offset;
+    if (offset + len > f->dirty_hi) f->dirty_hi = offset + len;
+    dirty_account(mc, f->dirty_hi - f->dirty_lo - span);
+}
+
+// Кадр блока директории block; при fresh — новый блок, который читать не
+// нужно: кадр обнуляется и целиком попадает в группу. NULL — ошибка чтения
+// или памяти. Данные кадра действительны до конца операции.
+char *dirblock_get(sfs_t *fs, int block, int fresh) {
+    MetaCache *mc = &fs->mcache;
+    int bs = fs->superblock.block_size;
+    if (block < 0 || block >= fs->superblock.total_blocks) return NULL;
+
+    pthread_mutex_lock(&mc->lock);
+    MetaBlock *f = frame_find(mc, block);
+    if (!f) {
+        f = calloc(1, frame_bytes(fs));
+        if (f && !fresh && disk_read(fs, f->data, bs, get_block_offset(fs, block)) != 0) {
+            free(f);
+            f = NULL;
+        }
+        if (f) {
+            unsigned int h = block_hash(mc, block);
+            f->block = block;
+            f->hash_next = mc->buckets[h];
+            mc->buckets[h] = f;
+            mc->block_count++;
+            mcache_account(fs, frame_bytes(fs));
+            if ((unsigned int)mc->block_count > (mc->bucket_mask + 1) * 2) frames_grow(mc);
+        }
+    } else if (fresh) {
+        memset(f->data, 0, bs);
+    }
+    if (f) {
+        f->used = mc->epoch;
+        if (fresh) frame_mark_dirty(mc, f, 0, bs);
+    }
+    pthread_mutex_unlock(&mc->lock);
+    return f ? f->data : NULL;
+}
+
+// Байты [offset, offset + len) кадра block изменены
+void dirblock_dirty(sfs_t *fs, int block, int offset, int len) {
+    MetaCache *mc = &fs->mcache;
+    pthread_mutex_lock(&mc->lock);
+    MetaBlock *f = frame_find(mc, block);
+    if (f) frame_mark_dirty(mc, f, offset, len);
+    pthread_mutex_unlock(&mc->lock);
+}
+
+static void frame_remove(sfs_t *fs, MetaBlock *f) {
+    MetaCache *mc = &fs->mcache;
+    MetaBlock **link = &mc->buckets[block_hash(mc, f->block)];
+    while (*link != f) link = &(*link)->hash_next;
+    *link = f->hash_next;
+    mc->block_count--;
+    mcache_account(fs, -(long)frame_bytes(fs));
+    free(f);
+}
+
+// Блок директории освобождается: кадр, даже изменённый, больше не нужен,
+// а прежние записи блока в журнале отменяются — после повторного выделения
+// под данные восстановление не должно затереть их старым содержимым
+void dirblock_release(sfs_t *fs, int block) {
+    MetaCache *mc = &fs->mcache;
+    pthread_mutex_lock(&mc->lock);
+    MetaBlock *f = frame_find(mc, block);
+    if (f) {
+        if (f->dirty_lo < f->dirty_hi) {
+            MetaBlock **link = &mc->dirty;
+            while (*link != f) link = &(*link)->dirty_next;
+            *link = f->dirty_next;
+            dirty_account(mc, -(long)(f->dirty_hi - f->dirty_lo));
+        }
+        frame_remove(fs, f);
+    }
+    pthread_mutex_unlock(&mc->lock);
+    mark_block_revoked(fs, block);
+}
+
+void dirblock_collect_dirty(sfs_t *fs) {
+    for (MetaBlock *f = fs->mcache.dirty; f; f = f->dirty_next) {
+        meta_add_region(fs, get_block_offset(fs, f->block) + f->dirty_lo, f->data + f->dirty_lo,
+                        f->dirty_hi - f->dirty_lo);
+    }
+}
+
+void dirblock_reset_dirty(sfs_t *fs) {
+    MetaCache *mc = &fs->mcache;
+    for (MetaBlock *f = mc->dirty; f; f = f->dirty_next) {
+        f->dirty_lo = f->dirty_hi = 0;
+    }
+    mc->dirty = NULL;
+    __atomic_store_n(&mc->dirty_bytes, 0, __ATOMIC_RELAXED);
+}
+
+// Байт изменённых кадров в текущей группе
+long dirblock_dirty_bytes(sfs_t *fs) {
+    return __atomic_load_n(&fs->mcache.dirty_bytes, __ATOMIC_RELAXED);
+}
+
+// Пора ли коммитить группу ради памяти кэша
+int mcache_over_limit(sfs_t *fs) {
+    return __atomic_load_n(&fs->mcache.bytes, __ATOMIC_RELAXED) >
+           __atomic_load_n(&fs->mcache.high, __ATOMIC_RELAXED);
+}
+
+typedef struct {
+    unsigned int used;
+    int index;
+} Victim;
+
+static int cmp_victim(const void *a, const void *b) {
+    const Victim *x = a, *y = b;
+    return (x->used > y->used) - (x->used < y->used);
+}
+
+// Кандидаты — не тронутые в завершившейся группе, самые давние первыми
+static void trim_frames(sfs_t *fs, long target) {
+    MetaCache *mc = &fs->mcache;
+    if (mc->block_count == 0) return;
+    MetaBlock **frames = malloc(sizeof(MetaBlock *) * mc->block_count);
+    Victim *victims = malloc(sizeof(Victim) * mc->block_count);
+    int count = 0;
+    for (unsigned int b = 0; frames && victims && b <= mc->bucket_mask; b++) {
+        for (MetaBlock *f = mc->buckets[b]; f; f = f->hash_next) {
+            if (f->used == mc->epoch) continue;
+            frames[count] = f;
+            victims[count].used = f->used;
+            victims[count].index = count;
+            count++;
+        }
+    }
+    qsort(victims, count, sizeof(Victim), cmp_victim);
+    for (int i = 0; i < count && mc->bytes > target; i++) {
+        frame_remove(fs, frames[victims[i].index]);
+    }
+    free(frames);
+    free(victims);
+}
+
+static void trim_pages(sfs_t *fs, long target) {
+    MetaCache *mc = &fs->mcache;
+    Victim *victims = malloc(sizeof(Victim) * mc->page_count);
+    if (!victims) return;
+    int count = 0;
+    for (int p = 0; p < mc->page_count; p++) {
+        if (mc->pages[p] && mc->pages[p]->used != mc->epoch) {
+            victims[count].used = mc->pages[p]->used;
+            victims[count].index = p;
+            count++;
+        }
+    }
+    qsort(victims, count, sizeof(Victim), cmp_victim);
+    for (int i = 0; i < count && mc->bytes > target; i++) {
+        free(mc->pages[victims[i].index]);
+        __atomic_store_n(&mc->pages[victims[i].index], NULL, __ATOMIC_RELEASE);
+        mcache_account(fs, -(long)page_bytes(fs));
+    }
+    free(victims);
+}
+
+// Конец коммита группы (ns_lock взят на запись, изменённого в кэше нет):
+// при превышении предела выбрасывает давно не нужное до 3/4 предела.
+// Если рабочий набор сам больше предела, следующий внеочередной коммит
+// ради памяти откладывается, пока кэш не вырастет ещё на четверть предела.
+void mcache_trim(sfs_t *fs) {
+    MetaCache *mc = &fs->mcache;
+    if (mc->bytes > mc->limit) {
+        long target = mc->limit / 4 * 3;
+        trim_frames(fs, target);
+        if (mc->bytes > target) trim_pages(fs, target);
+        if (mc->bytes > target) name_index_trim(fs, target);
+    }
+    __atomic_store_n(&mc->high, mc->bytes > mc->limit ? mc->bytes + mc->limit / 4 : mc->limit,
+                     __ATOMIC_RELAXED);
+    mc->epoch++;
+}
@@ -0,0 +1,414 @@
+#include "sfs.h"
+#include <stdlib.h>
+
+// Отслеживание изменённых метаданных и их инкрементальный сброс на диск.
+// Операции помечают изменённые inode, записи directory[] и участки битовой
+// карты (изменённые блоки директорий формата 3 помечает кэш метаданных)
+// и завершаются вызовом meta_commit(). Изменения нескольких операций
+// подряд объединяются в группу; sfs_flush() коммитит группу через журнал
+// и переписывает на место только изменённые участки.
+// Отметки ставятся под meta_lock из любых потоков; коммит берёт ns_lock
+// на запись и поэтому видит только завершённые операции.
+// Освобождённые блоки копятся в очереди и после коммита группы, когда их
+// освобождение уже устойчиво, превращаются в дыры образа на хосте.
+// Освобождённые блоки директорий отмечаются в журнале отменой, чтобы
+// восстановление не записало старые записи поверх новых данных блока.
+
+#define BITMAP_CHUNK 64  // гранулярность грязных участков битовой карты, байт
+#define RECORD_BYTES 16  // заголовок записи журнала (JournalRecord)
+
+long inode_offset(sfs_t *fs, int inode) {
+    return fs->layout.inode_table_offset + (long)fs->layout.inode_size * inode;
+}
+
+long dirent_offset(sfs_t *fs, int dir_entry_index) {
+    return fs->layout.directory_offset + (long)fs->layout.dirent_size * dir_entry_index;
+}
+
+void meta_free(sfs_t *fs) {
+    MetaState *m = &fs->meta;
+    free(m->inode_dirty);
+    free(m->dirty_inodes);
+    free(m->dirent_dirty);
+    free(m->dirty_dirents);
+    free(m->bitmap_dirty);
+    free(m->dirty_chunks);
+    free(m->regions);
+    free(m->requests);
+    free(m->revoked);
+    free(m->discard_queued);
+    free(m->discard_queue);
+    m->discard_queued = NULL;
+    m->discard_queue = NULL;
+    m->discard_count = 0;
+    m->inode_dirty = m->dirent_dirty = m->bitmap_dirty = NULL;
+    m->dirty_inodes = m->dirty_dirents = m->dirty_chunks = NULL;
+    m->regions = NULL;
+    m->requests = NULL;
+    m->revoked = NULL;
+    m->region_count = m->region_capacity = 0;
+    m->revoked_count = m->revoked_capacity = 0;
+    m->superblock_dirty = 0;
+    m->dirty_inode_count = m->dirty_dirent_count = m->dirty_chunk_count = 0;
+}
+
+// Выделяет структуры отслеживания под геометрию текущего суперблока
+int meta_init(sfs_t *fs) {
+    MetaState *m = &fs->meta;
+    meta_free(fs);
+    int inodes = fs->superblock.total_inodes;
+    int entries = fs->layout.dirent_count;
+    m->bitmap_chunks = (fs->layout.bitmap_size + BITMAP_CHUNK - 1) / BITMAP_CHUNK;
+    m->pending_ops = 0;
+    m->group_commit_ops = 1;
+
+    m->inode_dirty = calloc(inodes, 1);
+    m->dirty_inodes = malloc(sizeof(int) * inodes);
+    m->dirent_dirty = calloc(entries + 1, 1);
+    m->dirty_dirents = malloc(sizeof(int) * (entries + 1));
+    m->bitmap_dirty = calloc(m->bitmap_chunks, 1);
+    m->dirty_chunks = malloc(sizeof(int) * m->bitmap_chunks);
+    // Участков группы заранее не знаем (блоки директорий формата 3 — сколько
+    // угодно), массивы растут в meta_add_region
+    m->region_capacity = 1 + m->bitmap_chunks + 64;
+    m->regions = malloc(sizeof(MetaRegion) * m->region_capacity);
+    m->requests = malloc(sizeof(DiskRequest) * m->region_capacity);
+    m->discard_queued = calloc(fs->layout.bitmap_size, 1);
+    m->discard_queue = malloc(sizeof(int) * fs->superblock.total_blocks);
+
+    if (!m->inode_dirty || !m->dirty_inodes || !m->dirent_dirty || !m->dirty_dirents ||
+        !m->bitmap_dirty || !m->dirty_chunks || !m->regions || !m->requests ||
+        !m->discard_queued || !m->discard_queue) {
+        meta_free(fs);
+        return -1;
+    }
+    return 0;
+}
+
+void mark_superblock_dirty(sfs_t *fs) {
+    pthread_mutex_lock(&fs->meta_lock);
+    fs->meta.superblock_dirty = 1;
+    pthread_mutex_unlock(&fs->meta_lock);
+}
+
+void mark_inode_dirty(sfs_t *fs, int inode) {
+    MetaState *m = &fs->meta;
+    if (inode < 0 || inode >= fs->superblock.total_inodes) return;
+    pthread_mutex_lock(&fs->meta_lock);
+    if (!m->inode_dirty[inode]) {
+        m->inode_dirty[inode] = 1;
+        m->dirty_inodes[m->dirty_inode_count++] = inode;
+    }
+    pthread_mutex_unlock(&fs->meta_lock);
+}
+
+void mark_dirent_dirty(sfs_t *fs, int dir_entry_index) {
+    MetaState *m = &fs->meta;
+    if (dir_entry_index < 0 || dir_entry_index >= fs->layout.dirent_count) return;
+    pthread_mutex_lock(&fs->meta_lock);
+    if (!m->dirent_dirty[dir_entry_index]) {
+        m->dirent_dirty[dir_entry_index] = 1;
+        m->dirty_dirents[m->dirty_dirent_count++] = dir_entry_index;
+    }
+    pthread_mutex_unlock(&fs->meta_lock);
+}
+
+// Вызывается под alloc_lock
+void mark_bitmap_dirty(sfs_t *fs, int block_index) {
+    MetaState *m = &fs->meta;
+    int chunk = block_index / 8 / BITMAP_CHUNK;
+    if (chunk < 0 || chunk >= m->bitmap_chunks) return;
+    pthread_mutex_lock(&fs->meta_lock);
+    if (!m->bitmap_dirty[chunk]) {
+        m->bitmap_dirty[chunk] = 1;
+        m->dirty_chunks[m->dirty_chunk_count++] = chunk;
+    }
+    m->superblock_dirty = 1;  // вместе с битовой картой меняется free_blocks
+    pthread_mutex_unlock(&fs->meta_lock);
+}
+
+// Участки битовой карты с блоками [start, start + count) — под одной блокировкой
+void mark_bitmap_range_dirty(sfs_t *fs, int start, int count) {
+    MetaState *m = &fs->meta;
+    if (count <= 0) return;
+    int first = start / 8 / BITMAP_CHUNK, last = (start + count - 1) / 8 / BITMAP_CHUNK;
+    if (first < 0) first = 0;
+    if (last >= m->bitmap_chunks) last = m->bitmap_chunks - 1;
+    pthread_mutex_lock(&fs->meta_lock);
+    for (int chunk = first; chunk <= last; chunk++) {
+        if (!m->bitmap_dirty[chunk]) {
+            m->bitmap_dirty[chunk] = 1;
+            m->dirty_chunks[m->dirty_chunk_count++] = chunk;
+        }
+    }
+    m->superblock_dirty = 1;
+    pthread_mutex_unlock(&fs->meta_lock);
+}
+
+// Блок директории освобождён: его прежние записи в журнале больше не применять
+void mark_block_revoked(sfs_t *fs, int block_index) {
+    MetaState *m = &fs->meta;
+    pthread_mutex_lock(&fs->meta_lock);
+    if (m->revoked_count == m->revoked_capacity) {
+        int capacity = m->revoked_capacity ? m->revoked_capacity * 2 : 64;
+        int *revoked = realloc(m->revoked, sizeof(int) * capacity);
+        if (revoked) {
+            m->revoked = revoked;
+            m->revoked_capacity = capacity;
+        }
+    }
+    if (m->revoked_count < m->revoked_capacity) m->revoked[m->revoked_count++] = block_index;
+    pthread_mutex_unlock(&fs->meta_lock);
+}
+
+// Сбрасывает отметки только у помеченных элементов, не проходя по таблицам
+void meta_reset_dirty(sfs_t *fs) {
+    MetaState *m = &fs->meta;
+    m->superblock_dirty = 0;
+    for (int i = 0; i < m->dirty_inode_count; i++) m->inode_dirty[m->dirty_inodes[i]] = 0;
+    for (int i = 0; i < m->dirty_dirent_count; i++) m->dirent_dirty[m->dirty_dirents[i]] = 0;
+    for (int i = 0; i < m->dirty_chunk_count; i++) m->bitmap_dirty[m->dirty_chunks[i]] = 0;
+    m->dirty_inode_count = m->dirty_dirent_count = m->dirty_chunk_count = 0;
+    m->revoked_count = 0;
+    dirblock_reset_dirty(fs);
+}
+
+// Добавляет участок в группу; data == NULL — отмена блока в журнале
+int meta_add_region(sfs_t *fs, long offset, const void *data, size_t len) {
+    MetaState *m = &fs->meta;
+    if (m->region_count == m->region_capacity) {
+        int capacity = m->region_capacity * 2;
+        MetaRegion *regions = realloc(m->regions, sizeof(MetaRegion) * capacity);
+        if (!regions) return -1;
+        m->regions = regions;
+        DiskRequest *requests = realloc(m->requests, sizeof(DiskRequest) * capacity);
+        if (!requests) return -1;
+        m->requests = requests;
+        m->region_capacity = capacity;
+    }
+    m->regions[m->region_count].offset = offset;
+    m->regions[m->region_count].data = data;
+    m->regions[m->region_count].len = len;
+    m->region_count++;
+    return 0;
+}
+
+static int cmp_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+// Добавляет отсортированный список элементов таблицы, склеивая соседние в один участок
+static void collect_runs(sfs_t *fs, int *list, int count, long (*offset_of)(sfs_t *, int),
+                         const char *table, size_t item_size) {
+    qsort(list, count, sizeof(int), cmp_int);
+    for (int i = 0; i < count; ) {
+        int j = i + 1;
+        while (j < count && list[j] == list[j - 1] + 1) j++;
+        meta_add_region(fs, offset_of(fs, list[i]), table + item_size * list[i], item_size * (j - i));
+        i = j;
+    }
+}
+
+static long bitmap_chunk_offset(sfs_t *fs, int chunk) {
+    return fs->layout.bitmap_offset + (long)chunk * BITMAP_CHUNK;
+}
+
+static void collect_dirty(sfs_t *fs) {
+    MetaState *m = &fs->meta;
+    m->region_count = 0;
+
+    // Отмены идут первыми: записи блока, снова занятого под директорию
+    // в этой же группе, должны примениться после них
+    for (int i = 0; i < m->revoked_count; i++) {
+        meta_add_region(fs, get_block_offset(fs, m->revoked[i]), NULL, fs->superblock.block_size);
+    }
+
+    if (m->superblock_dirty) {
+        meta_add_region(fs, 0, &fs->superblock, sizeof(Superblock));
+    }
+
+    qsort(m->dirty_chunks, m->dirty_chunk_count, sizeof(int), cmp_int);
+    for (int i = 0; i < m->dirty_chunk_count; ) {
+        int j = i + 1;
+        while (j < m->dirty_chunk_count && m->dirty_chunks[j] == m->dirty_chunks[j - 1] + 1) j++;
+        long start = (long)m->dirty_chunks[i] * BITMAP_CHUNK;
+        long end = (long)m->dirty_chunks[j - 1] * BITMAP_CHUNK + BITMAP_CHUNK;
+        if (end > fs->layout.bitmap_size) end = fs->layout.bitmap_size;
+        meta_add_region(fs, bitmap_chunk_offset(fs, m->dirty_chunks[i]), fs->block_bitmap + start, end - start);
+        i = j;
+    }
+
+    // В образ идут таблицы в его формате; записи директорий там уже актуальны
+    inode_collect_dirty(fs, m->dirty_inodes, m->dirty_inode_count);
+    collect_runs(fs, m->dirty_dirents, m->dirty_dirent_count, dirent_offset,
+                 fs->dirent_area, fs->layout.dirent_size);
+    dirblock_collect_dirty(fs);
+}
+
+void sfs_set_group_commit(sfs_t *fs, int ops) {
+    pthread_mutex_lock(&fs->meta_lock);
+    fs->meta.group_commit_ops = ops > 0 ? ops : 1;
+    pthread_mutex_unlock(&fs->meta_lock);
+}
+
+// Конец изменяющей операции: изменения копятся, пока группа не наберётся;
+// сам коммит делает op_end, когда операция отпустит ns_lock
+void meta_commit(sfs_t *fs) {
+    pthread_mutex_lock(&fs->meta_lock);
+    fs->meta.pending_ops++;
+    pthread_mutex_unlock(&fs->meta_lock);
+}
+
+// Начало операции библиотеки: exclusive — для изменений пространства имён
+void op_begin(sfs_t *fs, int exclusive) {
+    if (exclusive) {
+        pthread_rwlock_wrlock(&fs->ns_lock);
+    } else {
+        pthread_rwlock_rdlock(&fs->ns_lock);
+    }
+}
+
+// Ставит освобождённый блок в очередь на возврат места хосту (под alloc_lock)
+void queue_discard(sfs_t *fs, int block) {
+    MetaState *m = &fs->meta;
+    if (m->discard_queued[block / 8] & (1 << (block % 8))) return;
+    m->discard_queued[block / 8] |= 1 << (block % 8);
+    m->discard_queue[m->discard_count++] = block;
+}
+
+static int cmp_block(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// После коммита группы возвращает её освобождённые блоки аллокатору и
+// пробивает дыры на их месте; соседние блоки объединяются в один вызов.
+static void discard_queued(sfs_t *fs) {
+    MetaState *m = &fs->meta;
+    pthread_mutex_lock(&fs->alloc_lock);
+    qsort(m->discard_queue, m->discard_count, sizeof(int), cmp_block);
+    int count = 0;
+    for (int i = 0; i < m->discard_count; i++) {
+        int b = m->discard_queue[i];
+        m->discard_queued[b / 8] &= ~(1 << (b % 8));
+        if (!(fs->block_bitmap[b / 8] & (1 << (b % 8)))) m->discard_queue[count++] = b;
+    }
+    m->discard_count = 0;
+    pthread_mutex_unlock(&fs->alloc_lock);
+
+    int bs = fs->superblock.block_size;
+    for (int i = 0; i < count;) {
+        int start = m->discard_queue[i];
+        int length = 1;
+        while (i + length < count && m->discard_queue[i + length] == start + length) length++;
+        if (disk_discard(fs, get_block_offset(fs, start), (size_t)length * bs) == 0) {
+            m->stats.discarded_blocks += length;
+            m->stats.discards++;
+        }
+        i += length;
+    }
+}
+
+static void flush_locked(sfs_t *fs, int force);
+
+// Оценка сверху байт журнала под накопленную группу (под meta_lock):
+// каждый изменённый объект считается отдельной записью
+static long group_bytes_locked(sfs_t *fs) {
+    MetaState *m = &fs->meta;
+    long bytes = (long)m->revoked_count * RECORD_BYTES;
+    if (m->superblock_dirty) bytes += sizeof(Superblock) + RECORD_BYTES;
+    bytes += (long)m->dirty_chunk_count * (BITMAP_CHUNK + RECORD_BYTES);
+    bytes += (long)m->dirty_inode_count * (fs->layout.inode_size + RECORD_BYTES);
+    bytes += (long)m->dirty_dirent_count * (fs->layout.dirent_size + RECORD_BYTES);
+    return bytes + dirblock_dirty_bytes(fs);
+}
+
+// Набрала ли группа половину журнала. Запас нужен, чтобы она легла в него
+// одной транзакцией, даже если кадры директорий изменены мелко: больше
+// журнала группа быть не может.
+int meta_group_full(sfs_t *fs) {
+    pthread_mutex_lock(&fs->meta_lock);
+    int full = group_bytes_locked(fs) > fs->layout.journal_size / 2;
+    pthread_mutex_unlock(&fs->meta_lock);
+    return full;
+}
+
+void op_end(sfs_t *fs) {
+    pthread_rwlock_unlock(&fs->ns_lock);
+    pthread_mutex_lock(&fs->meta_lock);
+    int full = fs->meta.pending_ops >= fs->meta.group_commit_ops;
+    pthread_mutex_unlock(&fs->meta_lock);
+    // Освобождённые в группе блоки выделять нельзя до её коммита
+    if (full || meta_group_full(fs) || delay_over_limit(fs) || mcache_over_limit(fs) ||
+        alloc_frees_pending(fs)) {
+        pthread_rwlock_wrlock(&fs->ns_lock);
+        flush_locked(fs, 0);
+        pthread_rwlock_unlock(&fs->ns_lock);
+    }
+}
+
+// Записывает накопленную группу: данные уже в образе, метаданные — в журнал
+// одной транзакцией и затем на свои места
+static void commit_group(sfs_t *fs) {
+    MetaState *m = &fs->meta;
+    pthread_mutex_lock(&fs->meta_lock);
+    m->pending_ops = 0;
+    pthread_mutex_unlock(&fs->meta_lock);
+
+    // Упорядоченный режим: данные группы попадают в образ раньше метаданных
+    cache_flush(fs);
+
+    collect_dirty(fs);
+    if (m->region_count == 0) return;
+    // msync журнала касается только его области: данные в отображении
+    // нужно сделать устойчивыми отдельно, до метаданных, что на них ссылаются
+    if (fs->io.backend == IO_MMAP) disk_sync(fs);
+    if (journal_commit(fs, m->regions, m->region_count) != 0) {
+        // Группа больше журнала: в образе остаётся прошлое состояние,
+        // изменения — только в памяти, и размонтирование вернёт ошибку
+        m->commit_failed = 1;
+        return;
+    }
+
+    // Участки на местах пишутся одним пакетом; отмены есть только в журнале
+    int count = 0;
+    for (int i = 0; i < m->region_count; i++) {
+        if (!m->regions[i].data) continue;
+        m->requests[count].buf = (char *)m->regions[i].data;
+        m->requests[count].len = m->regions[i].len;
+        m->requests[count].offset = m->regions[i].offset;
+        m->stats.bytes_written += m->regions[i].len;
+        m->stats.writes++;
+        count++;
+    }
+    disk_write_batch(fs, m->requests, count);
+    meta_reset_dirty(fs);
+
+    // Освобождение блоков уже в журнале — их место можно отдать
+    if (m->discard_count > 0) discard_queued(fs);
+}
+
+// Коммит посреди операции, которая держит ns_lock на запись и довела
+// образ до согласованного состояния. Кэш метаданных не сокращается:
+// операция ещё пользуется прочитанными директориями.
+void meta_commit_now(sfs_t *fs) {
+    commit_group(fs);
+}
+
+// Коммит группы при остановленных операциях (ns_lock взят на запись).
+// force — записать и все отложенные хвосты файлов, а не только устаревшие.
+static void flush_locked(sfs_t *fs, int force) {
+    delay_flush(fs, force);
+    commit_group(fs);
+
+    // Изменённого в кэше метаданных не осталось — лишнее можно выбросить
+    if (!fs->meta.commit_failed) mcache_trim(fs);
+}
+
+// Принудительный коммит группы: одна запись в журнал и один fsync,
+// после чего участки переписываются на свои места в образе
+void sfs_flush(sfs_t *fs) {
+    pthread_rwlock_wrlock(&fs->ns_lock);
+    flush_locked(fs, 1);
+    pthread_rwlock_unlock(&fs->ns_lock);
+}
@@ -0,0 +1,63 @@
+#ifndef SFS_PROTO_H
+#define SFS_PROTO_H
+
+// Протокол сервера libsfs поверх Unix-сокета (sfs_server.c, sfs_client.c).
+// Сокет локальный, поэтому числа передаются в порядке байт хоста.
+// Запрос: ProtoRequest и length байт данных (пути — строки с завершающим
+// нулём, для PWRITE/APPEND — записываемые байты). Ответ: ProtoResponse и
+// length байт данных. Ответы приходят в порядке запросов, поэтому клиент
+// может отправить несколько запросов подряд, не дожидаясь ответов.
+
+#include <stdint.h>
+
+#define PROTO_MAX_DATA (1024 * 1024)                     // данных в одном PREAD/PWRITE
+#define PROTO_MAX_PAYLOAD (PROTO_MAX_DATA + 2 * MAX_FILENAME_LENGTH * 2)
+
+enum {
+    OP_LOOKUP = 1,      // путь -> inode
+    OP_STAT,            // inode -> ProtoStat
+    OP_CREATE,          // путь -> inode
+    OP_MKDIR,           // путь -> inode
+    OP_DELETE,          // путь
+    OP_RMDIR,           // путь
+    OP_RMTREE,          // путь
+    OP_MOVE,            // путь файла, путь директории
+    OP_LIST,            // путь ("" — текущая директория) -> ProtoStat + имя, ...
+    OP_PREAD,           // inode, offset, count -> данные
+    OP_PWRITE,          // inode, offset, данные
+    OP_APPEND,          // inode, данные
+    OP_TRUNCATE,        // inode, offset — новый размер
+    OP_FLUSH,
+    OP_STATS,           // -> SfsStats
+};
+
+typedef struct {
+    uint32_t length;    // байт данных после заголовка
+    uint32_t id;        // повторяется в ответе
+    uint8_t op;
+    uint8_t pad[3];
+    uint32_t count;     // байт для PREAD
+    int32_t inode;
+    int32_t pad2;
+    int64_t offset;
+} ProtoRequest;
+
+typedef struct {
+    uint32_t length;    // байт данных после заголовка
+    uint32_t id;
+    int64_t result;     // >= 0 — успех, иначе SFS_ERR_*
+} ProtoResponse;
+
+// Элемент ответа STAT и LIST; в LIST за ним следуют name_length байт имени
+typedef struct {
+    int64_t size;
+    int32_t inode;
+    int32_t parent;
+    int32_t blocks;
+    uint8_t is_directory;
+    uint8_t name_length;
+    uint8_t is_inline;
+    uint8_t pad;
+} ProtoStat;
+
+#endif
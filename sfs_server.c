@@ -0,0 +1,307 @@
+#include "sfs.h"
+#include "sfs_proto.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Сервер: один смонтированный образ, поток на каждого клиента. Поток читает
+// из сокета сколько есть, выполняет все целые запросы из буфера и копит
+// ответы; отправляет их, только когда входящие запросы кончились, поэтому
+// конвейер из многих запросов обходится немногими системными вызовами.
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Buffer;
+
+typedef struct Connection {
+    int fd;
+    sfs_t *fs;
+    pthread_t thread;
+    int finished;
+    Buffer in;
+    Buffer out;
+    struct Connection *next;
+} Connection;
+
+static int buffer_reserve(Buffer *b, size_t extra) {
+    if (b->len + extra <= b->cap) return 0;
+    size_t cap = b->cap ? b->cap : 65536;
+    while (cap < b->len + extra) cap *= 2;
+    char *data = realloc(b->data, cap);
+    if (!data) return -1;
+    b->data = data;
+    b->cap = cap;
+    return 0;
+}
+
+static int buffer_append(Buffer *b, const void *data, size_t len) {
+    if (buffer_reserve(b, len) != 0) return -1;
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    return 0;
+}
+
+static int send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void stat_to_wire(const SfsStat *st, ProtoStat *w, size_t name_length) {
+    memset(w, 0, sizeof(*w));
+    w->size = st->size;
+    w->inode = st->inode;
+    w->parent = st->parent;
+    w->blocks = st->blocks;
+    w->is_directory = st->is_directory;
+    w->is_inline = st->is_inline;
+    w->name_length = name_length;
+}
+
+static int list_entry(void *ctx, const char *name, const SfsStat *st) {
+    Buffer *out = ctx;
+    size_t name_length = strlen(name);
+    ProtoStat w;
+    stat_to_wire(st, &w, name_length);
+    if (buffer_append(out, &w, sizeof(w)) != 0 || buffer_append(out, name, name_length) != 0) {
+        return 1;
+    }
+    return 0;
+}
+
+// Строка из данных запроса; NULL, если она не завершена нулём в пределах len
+static const char *payload_string(const char *payload, size_t len, size_t *used) {
+    const char *end = memchr(payload, '\0', len);
+    if (!end) return NULL;
+    *used = end - payload + 1;
+    return payload;
+}
+
+// Выполняет запрос и дописывает ответ в conn->out; -1 — нехватка памяти
+static int handle(Connection *conn, const ProtoRequest *req, const char *payload) {
+    sfs_t *fs = conn->fs;
+    Buffer *out = &conn->out;
+    size_t head = out->len;
+    ProtoResponse resp = {0, req->id, 0};
+    if (buffer_append(out, &resp, sizeof(resp)) != 0) return -1;
+
+    size_t used = 0;  // байт payload под путём; дальше идут аргументы OP_MOVE
+    const char *path = NULL;
+    if (req->op == OP_LOOKUP || req->op == OP_CREATE || req->op == OP_MKDIR || req->op == OP_DELETE ||
+        req->op == OP_RMDIR || req->op == OP_RMTREE || req->op == OP_MOVE || req->op == OP_LIST) {
+        path = payload_string(payload, req->length, &used);
+        if (!path) {
+            resp.result = SFS_ERR_INVAL;
+            memcpy(out->data + head, &resp, sizeof(resp));
+            return 0;
+        }
+    }
+
+    long r;
+    switch (req->op) {
+        case OP_LOOKUP: r = sfs_lookup(fs, path); break;
+        case OP_CREATE: r = sfs_create(fs, path); break;
+        case OP_MKDIR: r = sfs_create_dir(fs, path); break;
+        case OP_DELETE: r = sfs_delete(fs, path); break;
+        case OP_RMDIR: r = sfs_delete_dir(fs, path); break;
+        case OP_RMTREE: r = sfs_delete_dir_recursive(fs, path); break;
+        case OP_MOVE: {
+            size_t dir_used;
+            const char *dir = payload_string(payload + used, req->length - used, &dir_used);
+            r = dir ? sfs_move_to_dir(fs, path, dir) : SFS_ERR_INVAL;
+            break;
+        }
+        case OP_LIST:
+            r = sfs_list_dir(fs, path[0] ? path : NULL, list_entry, out);
+            break;
+        case OP_STAT: {
+            SfsStat st;
+            r = sfs_stat(fs, req->inode, &st);
+            if (r == SFS_OK) {
+                ProtoStat w;
+                stat_to_wire(&st, &w, 0);
+                if (buffer_append(out, &w, sizeof(w)) != 0) return -1;
+            }
+            break;
+        }
+        case OP_PREAD:
+            if (req->count > PROTO_MAX_DATA) {
+                r = SFS_ERR_INVAL;
+                break;
+            }
+            // Читаем прямо в буфер ответа
+            if (buffer_reserve(out, req->count) != 0) return -1;
+            r = sfs_pread(fs, req->inode, out->data + out->len, req->count, req->offset);
+            if (r > 0) out->len += r;
+            break;
+        case OP_PWRITE: r = sfs_pwrite(fs, req->inode, payload, req->length, req->offset); break;
+        case OP_APPEND: r = sfs_append(fs, req->inode, payload, req->length); break;
+        case OP_TRUNCATE: r = sfs_truncate(fs, req->inode, req->offset); break;
+        case OP_FLUSH:
+            sfs_flush(fs);
+            r = SFS_OK;
+            break;
+        case OP_STATS: {
+            SfsStats st;
+            sfs_get_stats(fs, &st);
+            if (buffer_append(out, &st, sizeof(st)) != 0) return -1;
+            r = SFS_OK;
+            break;
+        }
+        default: r = SFS_ERR_INVAL; break;
+    }
+
+    // Ошибка не несёт данных, даже если часть их уже в буфере
+    if (r < 0) out->len = head + sizeof(resp);
+    resp.result = r;
+    resp.length = out->len - head - sizeof(resp);
+    memcpy(out->data + head, &resp, sizeof(resp));
+    return 0;
+}
+
+static void *serve_connection(void *arg) {
+    Connection *conn = arg;
+    size_t done = 0;  // разобранная часть conn->in
+
+    for (;;) {
+        // Выполняем все целые запросы из буфера
+        while (conn->in.len - done >= sizeof(ProtoRequest)) {
+            ProtoRequest req;
+            memcpy(&req, conn->in.data + done, sizeof(req));
+            if (req.length > PROTO_MAX_PAYLOAD) goto disconnect;
+            if (conn->in.len - done < sizeof(req) + req.length) break;
+            if (handle(conn, &req, conn->in.data + done + sizeof(req)) != 0) goto disconnect;
+            done += sizeof(req) + req.length;
+            // Длинный конвейер чтений не должен копить ответы без предела;
+            // клиент вычитывает ответы, пока отправляет запросы
+            if (conn->out.len >= PROTO_MAX_DATA) {
+                if (send_all(conn->fd, conn->out.data, conn->out.len) != 0) goto disconnect;
+                conn->out.len = 0;
+            }
+        }
+        if (done > 0) {
+            memmove(conn->in.data, conn->in.data + done, conn->in.len - done);
+            conn->in.len -= done;
+            done = 0;
+        }
+
+        // Входящие кончились — отправляем накопленные ответы
+        if (conn->out.len > 0) {
+            if (send_all(conn->fd, conn->out.data, conn->out.len) != 0) goto disconnect;
+            conn->out.len = 0;
+        }
+
+        if (buffer_reserve(&conn->in, 65536) != 0) goto disconnect;
+        ssize_t n = recv(conn->fd, conn->in.data + conn->in.len, conn->in.cap - conn->in.len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) goto disconnect;
+        conn->in.len += n;
+    }
+
+disconnect:
+    shutdown(conn->fd, SHUT_RDWR);
+    __atomic_store_n(&conn->finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void connection_free(Connection *conn) {
+    pthread_join(conn->thread, NULL);
+    close(conn->fd);
+    free(conn->in.data);
+    free(conn->out.data);
+    free(conn);
+}
+
+// Открывает слушающий сокет. Файл сокета, оставшийся от упавшего сервера,
+// удаляется; если по нему отвечают, сокет занят. Другие файлы не трогаем.
+static int listen_on(const char *socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) return SFS_ERR_NAMETOOLONG;
+    strcpy(addr.sun_path, socket_path);
+
+    struct stat st;
+    if (lstat(socket_path, &st) == 0 && !S_ISSOCK(st.st_mode)) return SFS_ERR_EXIST;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return SFS_ERR_IO;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        close(fd);
+        return SFS_ERR_LOCKED;
+    }
+    close(fd);
+    unlink(socket_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return SFS_ERR_IO;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        return SFS_ERR_IO;
+    }
+    return fd;
+}
+
+// Обслуживает клиентов sfs_client.h, пока *stop не станет ненулевым
+// (флаг можно выставить из обработчика сигнала или из другого потока).
+// Перед возвратом закрывает все соединения и удаляет файл сокета.
+int sfs_serve(sfs_t *fs, const char *socket_path, volatile sig_atomic_t *stop) {
+    int listen_fd = listen_on(socket_path);
+    if (listen_fd < 0) return listen_fd;
+
+    Connection *connections = NULL;
+    while (!__atomic_load_n(stop, __ATOMIC_ACQUIRE)) {
+        // Ожидание с таймаутом: флаг остановки проверяется и без сигнала
+        struct pollfd p = {listen_fd, POLLIN, 0};
+        if (poll(&p, 1, 200) <= 0) continue;
+
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        Connection *conn = calloc(1, sizeof(Connection));
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->fs = fs;
+        if (pthread_create(&conn->thread, NULL, serve_connection, conn) != 0) {
+            close(fd);
+            free(conn);
+            continue;
+        }
+        conn->next = connections;
+        connections = conn;
+
+        // Отключившихся клиентов убираем из списка
+        for (Connection **link = &connections; *link;) {
+            Connection *c = *link;
+            if (__atomic_load_n(&c->finished, __ATOMIC_ACQUIRE)) {
+                *link = c->next;
+                connection_free(c);
+            } else {
+                link = &c->next;
+            }
+        }
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    while (connections) {
+        Connection *c = connections;
+        connections = c->next;
+        shutdown(c->fd, SHUT_RDWR);
+        connection_free(c);
+    }
+    return SFS_OK;
+}
@@ -0,0 +1,198 @@
+#include "sfs.h"
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Механизм IO_URING: пакет участков образа отправляется в кольцо io_uring
+// целиком, в полёте держится до queue_depth запросов, а освободившиеся места
+// сразу занимают следующие. Кольцо настраивается прямыми системными вызовами,
+// без liburing. Одиночные обращения идут через pread/pwrite: для одного
+// запроса кольцо ничего не выигрывает. Пакеты разных потоков проходят через
+// кольцо по очереди. Если io_uring_enter отказал насовсем, кольцо
+// дожидается уже принятых запросов и выключается: пакет и все следующие
+// выполняются через pread/pwrite.
+
+struct IoRing {
+    int fd;
+    unsigned depth;
+    int dead;                       // кольцо отказало, пакеты идут мимо него
+    pthread_mutex_t lock;
+
+    void *sq_ptr;
+    size_t sq_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    void *cq_ptr;
+    size_t cq_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+};
+
+static int ring_setup(unsigned entries, struct io_uring_params *p) {
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int ring_enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+
+void uring_close(IoRing *ring) {
+    if (!ring) return;
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+    if (ring->sq_ptr) munmap(ring->sq_ptr, ring->sq_size);
+    if (ring->fd >= 0) close(ring->fd);
+    pthread_mutex_destroy(&ring->lock);
+    free(ring);
+}
+
+// Создаёт кольцо на depth запросов; NULL, если io_uring недоступен
+IoRing *uring_open(unsigned depth) {
+    IoRing *ring = calloc(1, sizeof(IoRing));
+    if (!ring) return NULL;
+    pthread_mutex_init(&ring->lock, NULL);
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring->fd = ring_setup(depth, &p);
+    if (ring->fd < 0) {
+        uring_close(ring);
+        return NULL;
+    }
+    ring->depth = p.sq_entries;
+
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sq_ptr == MAP_FAILED || ring->cq_ptr == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        if (ring->sq_ptr == MAP_FAILED) ring->sq_ptr = NULL;
+        if (ring->cq_ptr == MAP_FAILED) ring->cq_ptr = NULL;
+        if (ring->sqes == MAP_FAILED) ring->sqes = NULL;
+        uring_close(ring);
+        return NULL;
+    }
+
+    char *sq = ring->sq_ptr;
+    ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    char *cq = ring->cq_ptr;
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return ring;
+}
+
+unsigned uring_depth(IoRing *ring) {
+    return ring->depth;
+}
+
+static void queue_sqe(IoRing *ring, int fd, const DiskRequest *req, int write, unsigned index) {
+    unsigned tail = *ring->sq_tail;
+    unsigned slot = tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[slot];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long)req->buf;
+    sqe->len = req->len;
+    sqe->off = req->offset;
+    sqe->user_data = index;
+    ring->sq_array[slot] = slot;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+// Разбирает завершённые запросы; недочитанный или недописанный остаток
+// запроса (конец файла, короткая запись) доделывается синхронно
+static void reap(sfs_t *fs, IoRing *ring, DiskRequest *reqs, int write, unsigned *inflight, int *err) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+        DiskRequest *req = &reqs[cqe->user_data];
+        long res = cqe->res;
+        if (res < 0) {
+            *err = -1;
+        } else if ((size_t)res < req->len) {
+            int rest = write ? disk_write(fs, req->buf + res, req->len - res, req->offset + res)
+                             : disk_read(fs, req->buf + res, req->len - res, req->offset + res);
+            if (rest != 0) *err = -1;
+        }
+        (*inflight)--;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static int fatal_errno(void) {
+    return errno != EINTR && errno != EAGAIN && errno != EBUSY;
+}
+
+// Выполняет пакет через кольцо. При отказе кольца не принятые ядром
+// запросы снимаются с очереди, принятые дожидаются завершения — их буферы
+// ядро может трогать до конца, — а остаток пакета пишется синхронно.
+int uring_submit_batch(sfs_t *fs, IoRing *ring, DiskRequest *reqs, int count, int write) {
+    int err = 0;
+    unsigned inflight = 0;          // поставлено в кольцо и ещё не завершено
+    unsigned unsubmitted = 0;       // поставлено, но ещё не принято ядром
+    int next = 0;
+
+    pthread_mutex_lock(&ring->lock);
+    while (!ring->dead && (next < count || inflight > 0)) {
+        while (next < count && inflight < ring->depth) {
+            queue_sqe(ring, fs->io.fd, &reqs[next], write, next);
+            next++;
+            inflight++;
+            unsubmitted++;
+        }
+        int r = ring_enter(ring->fd, unsubmitted, 1, IORING_ENTER_GETEVENTS);
+        if (r >= 0) {
+            unsubmitted -= r;
+        } else if (fatal_errno()) {
+            // Запросы, которые ядро не взяло, остались бы в кольце
+            // со ссылками на этот пакет — убираем их из очереди
+            unsigned accepted = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+            unsigned left = *ring->sq_tail - accepted;
+            __atomic_store_n(ring->sq_tail, accepted, __ATOMIC_RELEASE);
+            next -= left;
+            inflight -= left;
+            ring->dead = 1;
+        }
+        reap(fs, ring, reqs, write, &inflight, &err);
+    }
+
+    // Выключенное кольцо: ждём принятые ядром запросы и досылаем остальное
+    while (inflight > 0) {
+        if (ring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && fatal_errno()) {
+            // Дождаться нельзя — буферы пакета могут оставаться в работе
+            err = -1;
+            break;
+        }
+        reap(fs, ring, reqs, write, &inflight, &err);
+    }
+    pthread_mutex_unlock(&ring->lock);
+
+    for (; next < count; next++) {
+        int r = write ? disk_write(fs, reqs[next].buf, reqs[next].len, reqs[next].offset)
+                      : disk_read(fs, reqs[next].buf, reqs[next].len, reqs[next].offset);
+        if (r != 0) err = -1;
+    }
+    return err;
+}
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sfs_client.h"
+
+// Клиент сервера libsfs: одна команда за запуск. Образ обслуживает
+// процесс, запущенный как sfs -S сокет образ.
+
+static sfsc_t *conn = NULL;
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Использование: %s [-S сокет] команда [аргументы]\n", prog);
+    fprintf(stderr, "По умолчанию сокет — %s. Команды:\n", SFS_DEFAULT_SOCKET);
+    fprintf(stderr, "  create <путь>         - создание файла\n");
+    fprintf(stderr, "  mkdir <путь>          - создание директории\n");
+    fprintf(stderr, "  rm <путь>             - удаление файла\n");
+    fprintf(stderr, "  rmdir <путь>          - удаление пустой директории\n");
+    fprintf(stderr, "  rmtree <путь>         - рекурсивное удаление директории\n");
+    fprintf(stderr, "  mv <путь> <директория> - перемещение файла\n");
+    fprintf(stderr, "  ls [путь]             - содержимое директории\n");
+    fprintf(stderr, "  stat <путь>           - сведения о файле\n");
+    fprintf(stderr, "  cat <путь>            - вывод файла на стандартный вывод\n");
+    fprintf(stderr, "  write <путь>          - замена содержимого файла стандартным вводом\n");
+    fprintf(stderr, "  append <путь>         - дописывание стандартного ввода в конец файла\n");
+    fprintf(stderr, "  stats                 - статистика сервера\n");
+    fprintf(stderr, "  flush                 - сброс изменений на диск\n");
+}
+
+// Сообщает об ошибке операции над path; возвращает 1, если ошибка была
+static int failed(long err, const char *path) {
+    if (err >= 0) return 0;
+    fprintf(stderr, "Ошибка: '%s': %s.\n", path, sfs_strerror(err));
+    return 1;
+}
+
+static int print_entry(void *ctx, const char *name, const SfsStat *st) {
+    (void)ctx;
+    printf("- %s", name);
+    if (st->is_directory) {
+        printf(" (директория)");
+    } else {
+        printf(" (файл, размер: %ld)", st->size);
+    }
+    printf("\n");
+    return 0;
+}
+
+// Номер inode обычного файла по пути или код ошибки
+static int open_regular_file(const char *path, SfsStat *st) {
+    int inode = sfsc_lookup(conn, path);
+    if (inode < 0) return inode;
+    int r = sfsc_stat(conn, inode, st);
+    if (r < 0) return r;
+    return st->is_directory ? SFS_ERR_ISDIR : inode;
+}
+
+static int cat(const char *path) {
+    SfsStat st;
+    int inode = open_regular_file(path, &st);
+    if (failed(inode, path)) return 1;
+    char buf[65536];
+    for (long pos = 0; pos < st.size; ) {
+        long got = sfsc_pread(conn, inode, buf, sizeof(buf), pos);
+        if (failed(got, path)) return 1;
+        if (got == 0) break;
+        fwrite(buf, 1, got, stdout);
+        pos += got;
+    }
+    return 0;
+}
+
+static int write_stdin(const char *path, int append) {
+    SfsStat st;
+    int inode = open_regular_file(path, &st);
+    if (failed(inode, path)) return 1;
+    if (!append && failed(sfsc_truncate(conn, inode, 0), path)) return 1;
+
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0) {
+        long w = sfsc_append(conn, inode, buf, n);
+        if (failed(w, path)) return 1;
+        if ((size_t)w != n) {
+            fprintf(stderr, "Ошибка: '%s': %s.\n", path, sfs_strerror(SFS_ERR_NOSPC));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int print_stats(void) {
+    SfsStats st;
+    if (failed(sfsc_get_stats(conn, &st), "stats")) return 1;
+    unsigned long lookups = st.cache.hits + st.cache.misses;
+    printf("Блоки: свободно %d из %d по %d байт, inode: свободно %d из %d\n",
+           st.free_blocks, st.total_blocks, st.block_size, st.free_inodes, st.total_inodes);
+    printf("Формат образа %d: таблицы inode и директорий %ld байт, в кэше метаданных %ld байт\n",
+           st.format, st.table_bytes, st.meta_cache_bytes);
+    printf("Кэш блоков: попаданий %lu, промахов %lu (%.1f%%), вытеснено %lu, записано %lu\n",
+           st.cache.hits, st.cache.misses,
+           lookups ? 100.0 * st.cache.hits / lookups : 0.0,
+           st.cache.evictions, st.cache.writebacks);
+    printf("Упреждающее чтение: блоков %lu, пригодилось %lu (%.1f%%), вытеснено без обращений %lu\n",
+           st.cache.readahead, st.cache.readahead_hits,
+           st.cache.readahead ? 100.0 * st.cache.readahead_hits / st.cache.readahead : 0.0,
+           st.cache.readahead_wasted);
+    printf("Метаданные: записано %lu байт за %lu операций, журнал %lu байт в %lu коммитах, fsync %lu\n",
+           st.meta.bytes_written, st.meta.writes,
+           st.meta.journal_bytes, st.meta.journal_commits, st.meta.syncs);
+    printf("Освобождено на хосте: блоков %lu за %lu вызовов\n",
+           st.meta.discarded_blocks, st.meta.discards);
+    return 0;
+}
+
+static int execute(const char *cmd, int argc, char **argv) {
+    const char *arg = argc > 0 ? argv[0] : NULL;
+
+    if (strcmp(cmd, "ls") == 0) {
+        return failed(sfsc_list_dir(conn, arg, print_entry, NULL), arg ? arg : "текущий путь");
+    } else if (strcmp(cmd, "stats") == 0) {
+        return print_stats();
+    } else if (strcmp(cmd, "flush") == 0) {
+        return failed(sfsc_flush(conn), "flush");
+    }
+
+    if (arg == NULL) return -1;
+    if (strcmp(cmd, "create") == 0) {
+        return failed(sfsc_create(conn, arg), arg);
+    } else if (strcmp(cmd, "mkdir") == 0) {
+        return failed(sfsc_create_dir(conn, arg), arg);
+    } else if (strcmp(cmd, "rm") == 0) {
+        return failed(sfsc_delete(conn, arg), arg);
+    } else if (strcmp(cmd, "rmdir") == 0) {
+        return failed(sfsc_delete_dir(conn, arg), arg);
+    } else if (strcmp(cmd, "rmtree") == 0) {
+        return failed(sfsc_delete_dir_recursive(conn, arg), arg);
+    } else if (strcmp(cmd, "mv") == 0) {
+        if (argc < 2) return -1;
+        return failed(sfsc_move_to_dir(conn, arg, argv[1]), arg);
+    } else if (strcmp(cmd, "stat") == 0) {
+        SfsStat st;
+        int inode = sfsc_lookup(conn, arg);
+        if (failed(inode, arg) || failed(sfsc_stat(conn, inode, &st), arg)) return 1;
+        SfsStats geometry;
+        if (failed(sfsc_get_stats(conn, &geometry), arg)) return 1;
+        long allocated = (long)st.blocks * geometry.block_size;
+        printf("inode %d, %s, размер %ld, блоков %d (%ld байт)%s, родитель %d\n", st.inode,
+               st.is_directory ? "директория" : "файл", st.size, st.blocks, allocated,
+               st.is_inline ? ", в inode" : !st.is_directory && allocated < st.size ? ", разреженный" : "",
+               st.parent);
+        return 0;
+    } else if (strcmp(cmd, "cat") == 0) {
+        return cat(arg);
+    } else if (strcmp(cmd, "write") == 0) {
+        return write_stdin(arg, 0);
+    } else if (strcmp(cmd, "append") == 0) {
+        return write_stdin(arg, 1);
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *socket_path = SFS_DEFAULT_SOCKET;
+    int opt;
+    while ((opt = getopt(argc, argv, "S:h")) != -1) {
+        switch (opt) {
+            case 'S': socket_path = optarg; break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int err;
+    conn = sfsc_connect(socket_path, &err);
+    if (!conn) {
+        fprintf(stderr, "Не удалось подключиться к серверу '%s': %s.\n", socket_path, sfs_strerror(err));
+        return 1;
+    }
+
+    int r = execute(argv[optind], argc - optind - 1, argv + optind + 1);
+    sfsc_close(conn);
+    if (r < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    return r;
+}